@@ -0,0 +1,366 @@
+/** @file   main.c
+ *  @brief  main program for the "bench" user application (latency of syscalls, context switches, and locks in processor cycles).
+ *
+ *  Build with `make USERAPP=bench` for the default KERNEL_PROTECT run and with `make USERAPP=bench USERARG=thread` for THREAD_PROTECT (add `nopix` to skip the neopixel test, e.g. on QEMU where there is no PWM).
+ *  Every test takes BENCH_SAMPLES samples and prints one line over RTT:
+ *      bench mode=<kernel|thread> name=<test> n=<samples> min=<cycles> avg=<cycles> p99=<cycles> max=<cycles>
+ *  Other lines start with '#' so a parser can keep only the lines starting with "bench".
+ *  Samples come from the cycle_count syscall so the cost of one back-to-back cycle_count pair (the first line) is subtracted from every interval that is bracketed by two readings.
+ *  Samples that a SysTick interrupt lands in are kept (they show up in max and sometimes p99).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "userutil.h"
+#include "usyscall.h"
+
+/// Number of samples per test
+#define BENCH_SAMPLES 256
+
+/// Contended lock handoffs measured per period of the suite (each one spends a little of the server budget)
+#define CONTENDED_BURST 32
+
+/// Terminal writes measured per period of the suite (a write waits for the debugger whenever the up buffer is full)
+#define WRITE_BURST 32
+
+/// Bytes per terminal write (one line so that the output stays readable)
+#define WRITE_BYTES 32
+
+/// Neopixel updates measured per period of the suite (a neopixel_load starts a PWM sequence of the whole strip)
+#define PIX_BURST 4
+
+/// Scheduler frequency (one timeslot per millisecond)
+#define TIMESLOT_HZ 1000
+
+/// Period shared by every thread (in timeslots)
+#define PERIOD 10
+
+/// Budget of the suite thread (in timeslots)
+#define SUITE_C 4
+
+/// Stack size of the suite thread (formats text with printf and sorts with qsort)
+#define SUITE_STACK_BYTES 2048
+
+/// Stack size of the threads that only make syscalls
+#define SMALL_STACK_BYTES 512
+
+/// Server that takes the contended lock (ID 0 so it has the highest priority of the threads that share the period)
+#define CONTENDER_ID 0
+
+/// Event bit that the suite signals to the contender
+#define CONTENDER_EVENT 0x1
+
+/// Lock that the suite holds while the contender tries to take it (its highest locker is the contender)
+lock_t* contended_lock;
+
+/// Lock only used by the suite (no other thread takes it)
+lock_t* uncontended_lock;
+
+/// Samples of the test that the suite is running
+uint32_t samples[BENCH_SAMPLES];
+
+/// Samples of the PendSV switch that the pong thread takes alongside the yield handoff
+uint32_t switch_samples[BENCH_SAMPLES];
+
+/// Number of valid entries in samples (written by whichever thread takes the samples of the running test)
+volatile uint32_t num_samples = 0;
+
+/// Number of valid entries in switch_samples
+volatile uint32_t num_switch_samples = 0;
+
+/// Nonzero while the ping and pong threads take yield handoff samples
+volatile uint32_t yield_test_running = 0;
+
+/// Cycle count that the ping thread read right before it yielded
+volatile uint32_t ping_start = 0;
+
+/// Cycle count that the suite read right before it unlocked contended_lock
+volatile uint32_t handoff_start = 0;
+
+/// Cycles between two back-to-back cycle_count syscalls (subtracted from every bracketed interval)
+uint32_t overhead = 0;
+
+/// Name of the protection mode printed with every result
+const char* mode_name = "kernel";
+
+/// Nonzero if the neopixel test is skipped
+uint32_t skip_pix = 0;
+
+/**
+ * Returns the cycles from `start` to `end` minus the cost of the cycle_count pair that brackets them (0 if the interval was shorter than that).
+ */
+uint32_t bench_elapsed(uint32_t start, uint32_t end) {
+    uint32_t elapsed = end - start;
+    return (elapsed > overhead) ? (elapsed - overhead) : 0;
+}
+
+/**
+ * Orders samples for qsort.
+ */
+int sample_compare(const void* a, const void* b) {
+    uint32_t left = *(const uint32_t*)a;
+    uint32_t right = *(const uint32_t*)b;
+    return (left > right) - (left < right);
+}
+
+/**
+ * Sorts the first `count` entries of `values` and prints their summary line for the test `name`.
+ */
+void bench_report(const char* name, uint32_t* values, uint32_t count) {
+    if (count == 0) {
+        printf("# %s: no samples\n", name);
+        return;
+    }
+    qsort(values, count, sizeof(uint32_t), sample_compare);
+
+    uint64_t sum = 0;
+    for (uint32_t sample = 0; sample < count; sample++) {
+        sum += values[sample];
+    }
+    printf("bench mode=%s name=%s n=%lu min=%lu avg=%lu p99=%lu max=%lu\n",
+           mode_name, name, count, values[0], (uint32_t)(sum / count), values[(count * 99) / 100], values[count - 1]);
+}
+
+/**
+ * Contender server: takes contended_lock each time the suite signals it (the suite still holds it so the lock blocks until the suite unlocks).
+ * Records the cycles from the unlock in the suite to the moment the lock returns here.
+ */
+void contender_server(UNUSED void* vargp) {
+    while (1) {
+        server_wait(CONTENDER_EVENT);
+        lock(contended_lock);
+        uint32_t end = cycle_count();
+        if (num_samples < BENCH_SAMPLES) {
+            samples[num_samples++] = bench_elapsed(handoff_start, end);
+        }
+        unlock(contended_lock);
+    }
+}
+
+/**
+ * Ping thread: reads the cycle counter and yields to the pong thread once per period while the yield test runs.
+ */
+void ping_thread(UNUSED void* vargp) {
+    while (1) {
+        if (yield_test_running) {
+            ping_start = cycle_count();
+        }
+        thread_yield();
+    }
+}
+
+/**
+ * Pong thread: records the handoff from the ping thread and the cycles that the kernel spent switching to this thread.
+ */
+void pong_thread(UNUSED void* vargp) {
+    while (1) {
+        if (yield_test_running) {
+            uint32_t end = cycle_count();
+            uint32_t switched = switch_cycles();
+            if (num_samples < BENCH_SAMPLES) {
+                samples[num_samples++] = bench_elapsed(ping_start, end);
+                switch_samples[num_switch_samples++] = switched;
+            }
+        }
+        thread_yield();
+    }
+}
+
+/**
+ * Times BENCH_SAMPLES back-to-back cycle_count pairs and keeps the cheapest one as the overhead of a bracketed interval.
+ */
+void bench_overhead() {
+    for (uint32_t sample = 0; sample < BENCH_SAMPLES; sample++) {
+        uint32_t start = cycle_count();
+        uint32_t end = cycle_count();
+        samples[sample] = end - start;
+    }
+    bench_report("cycle_count", samples, BENCH_SAMPLES);
+    overhead = samples[0];
+}
+
+/**
+ * Times the syscall round trip of thread_id and get_time (the two cheapest syscalls).
+ */
+void bench_svc() {
+    for (uint32_t sample = 0; sample < BENCH_SAMPLES; sample++) {
+        uint32_t start = cycle_count();
+        thread_id();
+        samples[sample] = bench_elapsed(start, cycle_count());
+    }
+    bench_report("svc_thread_id", samples, BENCH_SAMPLES);
+    thread_yield();
+
+    for (uint32_t sample = 0; sample < BENCH_SAMPLES; sample++) {
+        uint32_t start = cycle_count();
+        get_time();
+        samples[sample] = bench_elapsed(start, cycle_count());
+    }
+    bench_report("svc_get_time", samples, BENCH_SAMPLES);
+    thread_yield();
+}
+
+/**
+ * Times lock and unlock of a lock that no other thread takes (both stay in user space since no other lock is held).
+ */
+void bench_lock_uncontended() {
+    static uint32_t unlock_samples[BENCH_SAMPLES];
+    for (uint32_t sample = 0; sample < BENCH_SAMPLES; sample++) {
+        uint32_t start = cycle_count();
+        lock(uncontended_lock);
+        uint32_t locked = cycle_count();
+        unlock(uncontended_lock);
+        uint32_t end = cycle_count();
+        samples[sample] = bench_elapsed(start, locked);
+        unlock_samples[sample] = bench_elapsed(locked, end);
+    }
+    bench_report("lock_uncontended", samples, BENCH_SAMPLES);
+    bench_report("unlock_uncontended", unlock_samples, BENCH_SAMPLES);
+    thread_yield();
+}
+
+/**
+ * Times the handoff of a contended lock: the contender blocks on the lock that the suite holds and the sample runs from the unlock in the suite until the lock returns in the contender.
+ * The suite runs at the priority of the contender while it holds the lock so nothing else runs in between.
+ */
+void bench_lock_contended() {
+    num_samples = 0;
+    while (num_samples < BENCH_SAMPLES) {
+        for (uint32_t handoff = 0; (handoff < CONTENDED_BURST) && (num_samples < BENCH_SAMPLES); handoff++) {
+            lock(contended_lock);
+            server_notify(CONTENDER_ID, CONTENDER_EVENT); // Contender preempts the suite and blocks on the lock
+            handoff_start = cycle_count();
+            unlock(contended_lock); // Contender takes the lock and records the sample before the suite runs again
+        }
+        thread_yield();
+    }
+    bench_report("lock_contended_handoff", samples, num_samples);
+}
+
+/**
+ * Times terminal writes and reports the cycles per byte (the kernel copies the bytes into the RTT up buffer like printk does).
+ */
+void bench_write() {
+    char line[WRITE_BYTES + 1];
+    memset(line, '.', WRITE_BYTES);
+    line[0] = '#';
+    line[1] = ' ';
+    line[WRITE_BYTES - 1] = '\n';
+    line[WRITE_BYTES] = '\0';
+
+    for (uint32_t sample = 0; sample < BENCH_SAMPLES; sample++) {
+        uint32_t start = cycle_count();
+        write(1, line, WRITE_BYTES);
+        samples[sample] = bench_elapsed(start, cycle_count()) / WRITE_BYTES;
+        if ((sample % WRITE_BURST) == (WRITE_BURST - 1)) {
+            thread_yield();
+        }
+    }
+    bench_report("write_per_byte", samples, BENCH_SAMPLES);
+    thread_yield();
+}
+
+/**
+ * Times setting one neopixel and loading the strip.
+ */
+void bench_pix() {
+    for (uint32_t sample = 0; sample < BENCH_SAMPLES; sample++) {
+        uint32_t start = cycle_count();
+        neopixel_set(sample & 0x0F, 0, (sample >> 4) & 0x0F, 0);
+        neopixel_load();
+        samples[sample] = bench_elapsed(start, cycle_count());
+        if ((sample % PIX_BURST) == (PIX_BURST - 1)) {
+            thread_yield();
+        }
+    }
+    neopixel_set(0, 0, 0, 0);
+    neopixel_load();
+    bench_report("neopixel_set_load", samples, BENCH_SAMPLES);
+    thread_yield();
+}
+
+/**
+ * Lets the ping and pong threads take one yield handoff (and PendSV switch) sample per period.
+ */
+void bench_yield() {
+    num_samples = 0;
+    num_switch_samples = 0;
+    yield_test_running = 1;
+    while (num_samples < BENCH_SAMPLES) {
+        thread_yield();
+    }
+    yield_test_running = 0;
+    bench_report("yield_handoff", samples, num_samples);
+    bench_report("pendsv_switch", switch_samples, num_switch_samples);
+}
+
+/**
+ * Suite thread: runs every test in turn (each test yields between bursts so that it stays inside the budget of the suite) and exits.
+ */
+void suite_thread(UNUSED void* vargp) {
+    printf("# bench mode=%s samples=%d\n", mode_name, BENCH_SAMPLES);
+    thread_yield();
+
+    bench_overhead();
+    thread_yield();
+    bench_svc();
+    bench_lock_uncontended();
+    bench_lock_contended();
+    bench_yield();
+    bench_write();
+    if (!skip_pix) {
+        bench_pix();
+    }
+
+    puts("# bench done");
+    exit(0);
+}
+
+/**
+ * Reads the options, defines the threads (all with the same period so only their IDs order them), and starts the scheduler.
+ */
+int main(int argc, char *argv[]) {
+    mpu_mode protection = KERNEL_PROTECT;
+
+    // The last arguement is always added by the build (every USERARG word in front of it is an option)
+    for (int arg = 1; arg < argc - 1; arg++) {
+        if (strcmp(argv[arg], "thread") == 0) {
+            protection = THREAD_PROTECT;
+            mode_name = "thread";
+        } else if (strcmp(argv[arg], "nopix") == 0) {
+            skip_pix = 1;
+        } else {
+            printf("unknown option %s (expected thread or nopix)\n", argv[arg]);
+            exit(1);
+        }
+    }
+
+    if (multitask_request(4, SMALL_STACK_BYTES, NULL, protection, 2, RATE_MONOTONIC) < 0) {
+        puts("multitask_request failed");
+        exit(1);
+    }
+
+    contended_lock = lock_init(CONTENDER_ID, 1);
+    uncontended_lock = lock_init(3, 1);
+    if ((contended_lock == NULL) || (uncontended_lock == NULL)) {
+        puts("failed to correctly initialize locks");
+        exit(1);
+    }
+
+    if ((server_define(CONTENDER_ID, &contender_server, NULL, 1, PERIOD, SMALL_STACK_BYTES) < 0) ||
+        (thread_define(1, &ping_thread, NULL, 1, PERIOD, SMALL_STACK_BYTES) < 0) ||
+        (thread_define(2, &pong_thread, NULL, 1, PERIOD, SMALL_STACK_BYTES) < 0) ||
+        (thread_define(3, &suite_thread, NULL, SUITE_C, PERIOD, SUITE_STACK_BYTES) < 0)) {
+        puts("thread_define failed");
+        exit(1);
+    }
+
+    if (multitask_start(TIMESLOT_HZ, PERIODIC_TICK) < 0) {
+        puts("multitask_start failed");
+        exit(1);
+    }
+
+    // Should never reach here
+    return -1;
+}
@@ -46,9 +46,6 @@
 /// The current angle (in degrees) that the stepper motor is facing (should only be updated by the stepper_thread but will be read by other threads)
 static volatile unsigned int current_angle = 0;
 
-/// The last measurement obtained from the ultrasonic sensor (updated by sensor thread but read-only in other threads)
-static volatile unsigned int last_ultrasonic_measurement = 0;
-
 /// The current range (in cm) that the radar is making detections at 
 static volatile unsigned int current_range = DEFAULT_RANGE_CM;
 
@@ -77,16 +74,23 @@ static size_t command_index = 0;
  * Array of string representation (in lower case) of supported commands. 
  * This is treated as the ultimate source of truth when determining what the user command is.
  */
-static char* supported_commands[] = {"calibrate", "start", "stop", "speed", "range", "reset", "help", "exit"};
+static char* supported_commands[] = {"calibrate", "start", "stop", "speed", "range", "reset", "help", "exit", "timing"};
+
+/// Number of threads defined by main (thread IDs are 0 through NUM_RADAR_THREADS-1)
+#define NUM_RADAR_THREADS 4
+
+/// Number of measurements that the ring between the sensor and indicator threads holds (the indicator normally takes each one in the period it was made)
+#define MEASUREMENT_RING_SLOTS 4
 
 /**
- * Guards metadata within the system that has well understood timing gurantees.
- * Only global variables that have concrete access patterns are guarded by locks to ensure synchronization.
- * Global variables that are updated sporadically / require polling rely on ownership model.
+ * One period of the sensor thread as handed to the indicator thread (written in place in a slot of the measurement ring).
+ * Global variables that are updated sporadically / require polling still rely on the ownership model.
  */
 typedef struct {
-    lock_t* measurement_lock;
-} non_polled_system_locks;
+    unsigned int distance; ///< Range reported by the ultrasonic sensor in cm (only meaningful if the radar was active)
+    unsigned int angle; ///< Angle (in degrees) that the radar faced when the measurement started
+    unsigned char active; ///< Set if the radar was active during this period
+} radar_measurement_t;
 
 /**
  * Prints the supported commands.
@@ -101,10 +105,11 @@ void display_commands() {
             "%s <cm>: Change radar range to the specified centimeters (subject to rejection)\n"
             "%s: Reset range and speed to default values\n"
             "%s: Show list of commands again\n"
-            "%s: Terminate the application\n\n",
+            "%s: Terminate the application\n"
+            "%s: Show deadline misses, budget overruns, and worst lateness of every thread\n\n",
             supported_commands[0], supported_commands[1], supported_commands[2], 
             supported_commands[3], supported_commands[4], supported_commands[5], 
-            supported_commands[6], supported_commands[7]);
+            supported_commands[6], supported_commands[7], supported_commands[8]);
 }
 
 /**
@@ -198,6 +203,15 @@ void handle_user_command(char* cmd) {
         }
         neopixel_load();
         exit(0);
+    } else if (strcmp(cmd_word, supported_commands[8]) == 0) {
+        // Timing
+        // Report the deadline counters kept by the scheduler (a growing miss count on the stepper thread shows up here long before the motor stutters)
+        for (unsigned int id = 0; id < NUM_RADAR_THREADS; id++) {
+            deadline_stats_t stats;
+            if (thread_deadline_stats(id, &stats) == 0) {
+                printf("Thread %u: %u deadline misses, %u budget overruns, worst lateness %u periods\n", id, stats.deadline_misses, stats.overruns, stats.max_lateness);
+            }
+        }
     } else {
         printf("Unknown command received: %s\n", cmd);
     }
@@ -244,7 +258,7 @@ void process_user_input() {
 
 /**
  * This thread is responsible for monitoring for user input and processing actions as they come in.
- * It follows a polling model rather than have a bounded worst case execution period / computation time (since user input is a sporadic event).
+ * It runs as a deferrable server rather than a periodic thread (since user input is a sporadic event): it sleeps in server_wait until the kernel sees input on stdin and only then spends its budget.
  * The overall control of the application is dictated by this thread.
  * Other threads merely maintain the last state configured by commands received by this thread.
  */
@@ -252,10 +266,10 @@ void user_thread(UNUSED void* arg) {
     display_commands();
     
     // Want user input thread to be somewhat responsive but do not want it to take priority over threads controlling hardware
-    // Only have it perform one call to process_user_input per iteration (variable amount of work depending on how much user input needs to be processed)
+    // Only have it perform one call to process_user_input per wake up (variable amount of work depending on how much user input needs to be processed)
     while (1) {
+        server_wait(SERVER_EVENT_STDIN);
         process_user_input();
-        thread_yield();
     }
 }
 
@@ -319,25 +333,21 @@ void stepper_thread(UNUSED void* arg) {
 
 
 /**
- * This thread is responsible for taking sensor measurements and updating the range of the `current_range` global variable.
- * Only this thread is responsible for updating the value of the last_ultrasonic_measurement variable (although other threads are allowed to reference it).
- * Both the sensor thread and indicator thread can be reliably profiled (instead of polling model), so updates to the measurement are made under a mutex.
+ * This thread is responsible for taking sensor measurements and handing them to the indicator thread.
+ * Every period it fills the next slot of the measurement ring in place and commits it, which needs no syscall unless the indicator thread is blocked waiting for it.
+ * If the indicator thread has fallen a whole ring behind, the period is skipped rather than delaying the sensor.
  */
 void sensor_thread(void* arg) {
-    // Set up lock for synchronizing with the indicator thread
-    non_polled_system_locks* locks = (non_polled_system_locks *)arg;
-    unsigned int new_measurement = 0;
+    ring_t* measurements = (ring_t *)arg;
 
     while (1) {
-        // Take ultrasonic measurement if the radar is active
-        if (radar_active) {
-            // Don't hold the lock while polling (use local variable)
-            new_measurement = ultrasonic_read();
-
-            // Update measusmrent global variable behind lock
-            lock(locks->measurement_lock);
-            last_ultrasonic_measurement = new_measurement;
-            unlock(locks->measurement_lock);
+        radar_measurement_t* measurement = ring_reserve(measurements);
+        if (measurement != NULL) {
+            // Take ultrasonic measurement if the radar is active (straight into the slot)
+            measurement->active = radar_active;
+            measurement->angle = current_angle;
+            measurement->distance = measurement->active ? ultrasonic_read() : 0;
+            ring_commit(measurements);
         }
 
         // If radar is not active or measurement finished early, repeatedly yield to next cycle (prevents corruption of echo from trigger and keeps measurement periodic)
@@ -347,41 +357,52 @@ void sensor_thread(void* arg) {
 
 /**
  * This thread is responsible for showing indications that a "radar" (ultrasonic) detection has been made at the current angle.
- * The ring LED will be activated to show that the current angle has an object closer than the defined threshold.
- * Reads from the last measurement are protected by the measurement lock (synchronizing with the sensor thread).
+ * The ring LED will be activated to show that the angle of a measurement has an object closer than the defined threshold.
+ * While the sensor thread waits for the echo this thread is blocked on the measurement ring (using none of its budget) instead of showing the measurement of the previous period.
+ * Measurements are read in place from the ring and released once shown (every queued one is shown if this thread fell behind).
  */
 void indicator_thread(void* arg) {
-    // Set up lock for synchronizing with the sensor thread
-    non_polled_system_locks* locks = (non_polled_system_locks *)arg;
+    ring_t* measurements = (ring_t *)arg;
 
-    // If the radar is active update the LED currently faced by the radar to a new value
+    // If the radar is active update the LED that the radar faced to a new value
     // The same LED can be repeatedly updated depending on the speed of the radar (i.e. if an object move quickly into range while still facing the same LED)
-    size_t led_index = 0; // Currently active LED based on current angle
+    size_t led_index = 0; // Currently active LED based on the angle of the measurement
     size_t last_led_index = 0; // Index of the last active LED
 
     // Sweep through the LEDs in the 180 degree arc and latch an LED if at an point a sensor measurement is within the range threshold (i.e. make measurements sticky)
     // An LED will stay high until this LED is measured again and no detections are made during its turn
     while (1) {
-        if (radar_active) {
-            // Calculate which LED corresponds to this angle (0-180 maps to 12 LEDs)
-            // LED index wraps from zero_degrees_led
-            led_index = (zero_degrees_led + current_angle / DEGREES_PER_LED) % NUM_RING_LEDS;
-            
-            // Check if this light should be lit based on if the last ultrasonic_measurement was less than the range threshold
-            // Make the update with a gurantee that the most recent measurement is up to date
-            lock(locks->measurement_lock);
-            if (last_ultrasonic_measurement < current_range) {
-                // Object detected within range so make this LED red
-                neopixel_set(255, 0, 0, led_index);
-            } else if (led_index != last_led_index) {
-                // No object (turn off the LED - may already be off but just ensure that is true)
-                // The LED is only turned off once when the light is first serviced (sticky detections - any detection after this will keep the light on)
-                neopixel_set(0, 0, 0, led_index);
+        // Wait for the measurement of this period
+        const radar_measurement_t* measurement;
+        while ((measurement = ring_peek(measurements)) == NULL) {
+            ring_wait(measurements, RING_WAIT_DATA);
+        }
+
+        unsigned char active = 0;
+        do {
+            active = measurement->active;
+            if (active) {
+                // Calculate which LED corresponds to this angle (0-180 maps to 12 LEDs)
+                // LED index wraps from zero_degrees_led
+                led_index = (zero_degrees_led + measurement->angle / DEGREES_PER_LED) % NUM_RING_LEDS;
+
+                // Check if this light should be lit based on if the measurement was less than the range threshold
+                if (measurement->distance < current_range) {
+                    // Object detected within range so make this LED red
+                    neopixel_set(255, 0, 0, led_index);
+                } else if (led_index != last_led_index) {
+                    // No object (turn off the LED - may already be off but just ensure that is true)
+                    // The LED is only turned off once when the light is first serviced (sticky detections - any detection after this will keep the light on)
+                    neopixel_set(0, 0, 0, led_index);
+                }
+
+                // Update last LED index to the led_index that was just served
+                last_led_index = led_index;
             }
-            unlock(locks->measurement_lock);
+            ring_release(measurements);
+        } while ((measurement = ring_peek(measurements)) != NULL);
 
-            // Update last LED index to the led_index that was just served and load sequence
-            last_led_index = led_index;
+        if (active) {
             neopixel_load();
         } else if (!calibration_mode) {
             // Neither active or in calibration mode
@@ -393,7 +414,6 @@ void indicator_thread(void* arg) {
         }
         
         // Yield until the next cycle to avoid loading neopixel sequence too often (causing strange behavior)
-        // Update last LED index to the led_index that was just served
         thread_yield();
     }
 }
@@ -406,40 +426,39 @@ int main(UNUSED int argc, UNUSED char *argv[]) {
     int ret;
 
     // Profiling justifications:
-    // user_thread: Want the system to be responsive to user input (but not more responsive than the stepper motor) - 30 ms seems like a reasonable polling time for user input and 4 ms computational time seems like enough to perform any command (most of the time it will just yield anyway).
+    // user_thread: Want the system to be responsive to user input (but not more responsive than the stepper motor) - 30 ms seems like a reasonable latency for user input and 4 ms computational time seems like enough to perform any command. It is defined as a server so it only uses this budget when there is input (the kernel checks stdin for it at every period instead of it polling).
     // stepper_thread: At max speed, the stepper motor go through 6 steps in 6 * (60 * 1000 / 2048 / 10) ~ 18 ms. I set the polling frequency to slightly longer than this since there is other work to do (and I do not want it to completely monopolize the system).
-    // sensor_thread: Set period equal to 80 ms (little more leeway from what the sensor recommonds) - The sensor which recommends a sensing period of 60 ms to avoid corrupting the echo line) - High execution time allows the system to idly poll the measurement while waiting for 36 ms in the worst case of timeout (should normally not need this entire time).
-    // indicator_thread: Same period as the sensor_thread with the idea being that they will pass the measurement lock back and forth (both yielding for each measurement made) - Make sensor thread the higher priority in the event of a tie (want updated data before showing indication).
-    uint32_t num_threads = 4, stack_size = 2048, num_mutexes = 1;
+    // sensor_thread: Set period equal to 80 ms (little more leeway from what the sensor recommonds) - The sensor which recommends a sensing period of 60 ms to avoid corrupting the echo line) - The thread is blocked while the kernel waits up to 36 ms for the echo (other threads run in the meantime), but the high execution time is kept as headroom for the measurement handling.
+    // indicator_thread: Same period as the sensor_thread with the idea being that every measurement goes straight through the measurement ring (the indicator sleeps on the ring until the sensor commits the measurement for the period) - Make sensor thread the higher priority in the event of a tie (want updated data before showing indication).
+    // Stacks: user_thread formats and parses text so it gets the deepest stack, stepper_thread only drives GPIO, and the idle thread uses the default stack_size.
+    uint32_t num_threads = NUM_RADAR_THREADS, stack_size = 1024, num_mutexes = 0;
     uint32_t C[4] = {20, 5, 80, 360};
+    uint32_t S[4] = {4096, 1024, 2048, 2048};
     uint32_t T[4] = {300, 40, 800, 800};
     void *threads[4] = {&user_thread, &stepper_thread, &sensor_thread, &indicator_thread};
 
     // Set up memory protection and request space for the threads
-    ret = multitask_request(num_threads, stack_size, NULL, THREAD_PROTECT, num_mutexes);
+    ret = multitask_request(num_threads, stack_size, NULL, THREAD_PROTECT, num_mutexes, RATE_MONOTONIC);
     if(ret < 0) {
         puts("multitask_request failed");
         exit(1);
     }
 
-    // Allocate locks struct
-    non_polled_system_locks* locks = malloc(sizeof(non_polled_system_locks));
-    if(locks == NULL) {
-        puts("failed to malloc space for lock struct");
+    // The sensor_thread is the only producer and the indicator_thread the only consumer of the measurement ring (the kernel takes it from the heap)
+    ring_t* measurements = ring_init(sizeof(radar_measurement_t), MEASUREMENT_RING_SLOTS);
+    if(measurements == NULL) {
+        puts("failed to initialize the measurement ring");
         exit(1);
     }
 
-    // Highest priority thread is sensor_thread (id of 2 - higher priority than indicator_thread with tie break)
-    // This lock has timing gurantees that it will not yield / exit while being held
-    locks->measurement_lock = lock_init(2); 
-    if(locks->measurement_lock == NULL) {
-        puts("failed to correctly initialize locks");
-        exit(1);
-    }
-
-    // Define threads with the above profiling and IDs equal to the index (also passing in the locks arg for threads that need it)
+    // Define threads with the above profiling and stack sizes and IDs equal to the index (also passing in the measurement ring for threads that need it)
+    // user_thread (index 0) is the server for user input and all other threads are periodic
     for(uint32_t index = 0; index < num_threads; index++) {
-        ret = thread_define(index, threads[index], (void *)locks, C[index], T[index]);
+        if (index == 0) {
+            ret = server_define(index, threads[index], (void *)measurements, C[index], T[index], S[index]);
+        } else {
+            ret = thread_define(index, threads[index], (void *)measurements, C[index], T[index], S[index]);
+        }
         if(ret < 0) {
             printf("thread_define failed for thread %lu\n", index);
             exit(1);
@@ -448,7 +467,8 @@ int main(UNUSED int argc, UNUSED char *argv[]) {
 
     // Start preemptive scheduler at 10000 Hz
     // This is faster than most traditional scheduler and will incur a bit more overhead (however this keeps polling results responsive - especially the motor)
-    ret = multitask_start(10000);
+    // Run tickless so that the overhead is only paid at releases and budget exhaustion (the threads mostly sit idle between periods)
+    ret = multitask_start(10000, TICKLESS);
     if(ret < 0) {
         puts("multitask_start failed");
         exit(1);
@@ -0,0 +1,140 @@
+/** @file   main.c
+ *  @brief  main program for the "scale" user application (measures how scheduling and locking costs change with the number of threads).
+ *
+ *  Build with `make USERAPP=scale USERARG=<workers>` (default 63 workers plus the reporter thread, i.e. the 64 thread maximum) and compare the reports for different worker counts.
+ *  Every worker takes a shared lock, bumps a counter, and yields once per period, so each worker job costs one release and one context switch in and out.
+ *  The reporter prints the average lock/unlock round trip (cycles charged to the reporter over a burst of uncontended pairs) and the kernel cycles (scheduler and interrupt handlers) per worker job and per timeslot.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "userutil.h"
+#include "usyscall.h"
+
+/// Largest number of worker threads (the reporter takes the last of the 64 threads that the kernel supports)
+#define MAX_WORKERS 63
+
+/// Number of lock/unlock pairs averaged for a single lock measurement
+#define LOCK_PAIRS 100
+
+/// Number of reports printed before the application exits
+#define NUM_REPORTS 10
+
+/// Stack size of every worker (workers only make syscalls)
+#define WORKER_STACK_BYTES 256
+
+/// Stack size of the reporter (formats text with printf)
+#define REPORTER_STACK_BYTES 2048
+
+/// Scheduler frequency (one timeslot per millisecond)
+#define TIMESLOT_HZ 1000
+
+/// Lock shared by all of the workers (its highest locker is the first worker)
+lock_t* work_lock;
+
+/// Lock only used by the reporter to time uncontended lock/unlock pairs
+lock_t* bench_lock;
+
+/// Number of worker jobs completed (incremented under work_lock)
+volatile uint32_t worker_jobs = 0;
+
+/// Number of worker threads defined by main
+uint32_t num_workers = MAX_WORKERS;
+
+/**
+ * Worker thread: one short critical section per period.
+ */
+void worker_thread(UNUSED void* vargp) {
+    while (1) {
+        lock(work_lock);
+        worker_jobs++;
+        unlock(work_lock);
+        thread_yield();
+    }
+}
+
+/**
+ * Reporter thread (ID 0): measures the lock round trip and the kernel cycles spent per worker job since its previous period.
+ */
+void reporter_thread(UNUSED void* vargp) {
+    cycle_counters_t before, after;
+    thread_cycles(0, &before);
+    uint32_t last_jobs = worker_jobs;
+    uint32_t last_time = get_time();
+    uint64_t last_kernel = before.kernel;
+
+    for (uint32_t report = 0; report < NUM_REPORTS; report++) {
+        thread_yield();
+
+        // Time a burst of uncontended pairs (cycles charged to this thread include the syscalls it makes)
+        thread_cycles(0, &before);
+        for (uint32_t pair = 0; pair < LOCK_PAIRS; pair++) {
+            lock(bench_lock);
+            unlock(bench_lock);
+        }
+        thread_cycles(0, &after);
+        uint32_t lock_cycles = (uint32_t)((after.thread - before.thread) / LOCK_PAIRS);
+
+        // Kernel cycles since the last report split over the worker jobs and the timeslots in between
+        uint32_t jobs = worker_jobs - last_jobs;
+        uint32_t timeslots = get_time() - last_time;
+        uint64_t kernel = after.kernel - last_kernel;
+        printf("threads=%lu lock+unlock=%lu cycles kernel/job=%lu cycles kernel/timeslot=%lu cycles\n",
+               num_workers + 1, lock_cycles, (uint32_t)(kernel / (jobs ? jobs : 1)), (uint32_t)(kernel / (timeslots ? timeslots : 1)));
+
+        last_jobs = worker_jobs;
+        last_time = get_time();
+        last_kernel = after.kernel;
+    }
+    exit(0);
+}
+
+/**
+ * Defines the reporter and the requested number of workers (all with the same period so the response time analysis admits every one of them) and starts the scheduler.
+ */
+int main(int argc, char *argv[]) {
+    // The last arguement is always added by the build (only a USERARG in front of it sets the worker count)
+    if (argc > 2) {
+        num_workers = (uint32_t)atoi(argv[1]);
+        if ((num_workers == 0) || (num_workers > MAX_WORKERS)) {
+            printf("worker count must be between 1 and %d\n", MAX_WORKERS);
+            exit(1);
+        }
+    }
+
+    // Every thread shares one period long enough for all of them (workers use one timeslot each and the reporter a few more)
+    uint32_t reporter_c = 5;
+    uint32_t period = 4 * (num_workers + reporter_c);
+
+    if (multitask_request(num_workers + 1, WORKER_STACK_BYTES, NULL, KERNEL_PROTECT, 2, RATE_MONOTONIC) < 0) {
+        puts("multitask_request failed");
+        exit(1);
+    }
+
+    work_lock = lock_init(1, 1);
+    bench_lock = lock_init(0, 1);
+    if ((work_lock == NULL) || (bench_lock == NULL)) {
+        puts("failed to correctly initialize locks");
+        exit(1);
+    }
+
+    // Reporter has ID 0 so it wins the tie with the workers (same period)
+    if (thread_define(0, &reporter_thread, NULL, reporter_c, period, REPORTER_STACK_BYTES) < 0) {
+        puts("thread_define failed for the reporter");
+        exit(1);
+    }
+    for (uint32_t id = 1; id <= num_workers; id++) {
+        if (thread_define(id, &worker_thread, NULL, 1, period, WORKER_STACK_BYTES) < 0) {
+            printf("thread_define failed for worker %lu\n", id);
+            exit(1);
+        }
+    }
+
+    if (multitask_start(TIMESLOT_HZ, PERIODIC_TICK) < 0) {
+        puts("multitask_start failed");
+        exit(1);
+    }
+
+    // Should never reach here
+    return -1;
+}
@@ -0,0 +1,79 @@
+/** @file   host.h
+ *  @brief  Interface of the simulated machine that runs the kernel core as a native process (make host).
+ *
+ *  Only plain C types are used so that both the kernel side (built against kernel/include) and the host side (built against libc) can include this header.
+**/
+
+#ifndef _HOST_H_
+#define _HOST_H_
+
+/// Default simulated processor frequency (the SysTick and DWT clock of the target)
+#define HOST_CPU_HZ (64000000)
+
+/**
+ * Maps zero filled register files at the peripheral, GPIO, and private peripheral bus addresses of the target so that MMIO accesses from the kernel land in ordinary memory.
+ * Exits the process if an address range is already taken (the host binary must be linked without PIE so that nothing else is placed there).
+ */
+void host_mmio_map(void);
+
+/**
+ * Returns a monotonic wall clock reading in nanoseconds (used to time the benchmarks).
+ */
+unsigned long long host_time_ns(void);
+
+/**
+ * Writes `len` bytes from `bytes` to the standard output of the host process.
+ */
+void host_console_write(const char* bytes, unsigned int len);
+
+/**
+ * Stops the simulation with the reason on the standard error of the host process.
+ */
+void host_halt(const char* reason);
+
+/**
+ * Maps the register files, initializes RTT and the cycle counter, and resets the simulated machine so that the main thread runs on the user process stack.
+ */
+void host_machine_init(void);
+
+/**
+ * Forgets the previous multitask_request so that a benchmark can define a new set of threads (only valid once multitask_start returned to the main thread).
+ */
+void host_kernel_reset(void);
+
+/**
+ * Advances the simulated clock by `cycles` processor cycles and delivers any SysTick interrupts (and the PendSV they request) that fall in that time.
+ */
+void host_clock_advance(unsigned int cycles);
+
+/**
+ * What the wfi in the idle thread does on the simulated machine: advances the clock to the next SysTick interrupt and delivers it.
+ */
+void host_wait_for_interrupt(void);
+
+/**
+ * Makes the running thread execute `svc svc_num` with arguements `r0` to `r3` and delivers the PendSV that the syscall requested.
+ * `arg5` and `arg6` are stacked above the frame like the 5th and 6th arguements of a call (only the main thread has room for them above its frame).
+ * Returns the value that the syscall placed in r0 of the calling thread.
+ * If the syscall blocked the calling thread, host_svc_blocked is set and the thread must issue the same syscall again once it runs (as the rewound svc would on the target).
+ */
+unsigned int host_svc(unsigned int svc_num, unsigned int r0, unsigned int r1, unsigned int r2, unsigned int r3, unsigned int arg5, unsigned int arg6);
+
+/// Set by host_svc when the syscall blocked the calling thread (cleared by the next host_svc)
+extern unsigned int host_svc_blocked;
+
+/// Number of times PendSV_C_Handler ran on the simulated machine
+extern unsigned long long host_pendsv_count;
+
+/**
+ * Forwards everything written to the terminal up buffer since the last call to the standard output of the host process (what the debugger does on the target).
+ */
+void host_console_flush(void);
+
+/**
+ * Discards everything written to the terminal up buffer since the last call (used while timing printk so that the host output is not part of the measurement).
+ * Returns the number of bytes discarded.
+ */
+unsigned int host_console_discard(void);
+
+#endif
@@ -0,0 +1,79 @@
+/** @file   host_intrinsics.h
+ *  @brief  Simulated versions of the intrinsics in arm.h that execute Arm instructions (included by arm.h in a host build only).
+**/
+
+#ifndef _HOST_INTRINSICS_H_
+#define _HOST_INTRINSICS_H_
+
+/// Simulated PRIMASK (nonzero while interrupts are disabled - the simulated clock holds SysTick pending until it is clear)
+extern volatile uint32_t host_primask;
+
+/// Simulated PSP (address of the frame stacked by hardware for the running thread)
+extern uint32_t host_psp;
+
+/// Simulated IPSR (number of the exception that the simulated machine is handling or 0 in thread mode)
+extern uint32_t host_ipsr;
+
+/// Stops the simulation with the kernel's state left for inspection (what a breakpoint or a wfi with interrupts disabled means on the target)
+void host_halt(const char* reason);
+
+/// Stops the simulation at a breakpoint
+intrinsic void breakpoint() { host_halt("breakpoint"); }
+
+/// Nothing can wake the simulated machine once interrupts are disabled (the syscall_exit failsafe) and otherwise the simulated clock delivers interrupts between host steps
+intrinsic void wait_for_interrupt() {
+    if (host_primask) {
+        host_halt("wait for interrupt with interrupts disabled");
+    }
+}
+
+/// Clears the simulated PRIMASK
+intrinsic void enable_interrupts() { host_primask = 0; }
+
+/// Sets the simulated PRIMASK
+intrinsic void disable_interrupts() { host_primask = 1; }
+
+/// Compiler barrier (the simulated machine has a single core so ordering against the compiler is all that is needed)
+intrinsic void data_mem_barrier() { asm volatile("" ::: "memory"); }
+
+/// Compiler barrier (see data_mem_barrier)
+intrinsic void data_sync_barrier() { asm volatile("" ::: "memory"); }
+
+/// Compiler barrier (see data_mem_barrier)
+intrinsic void inst_sync_barrier() { asm volatile("" ::: "memory"); }
+
+/// Events only wake a core that is waiting on another one so there is nothing to wait for
+intrinsic void wait_for_event() { }
+
+/// See wait_for_event
+intrinsic void send_event() { }
+
+/// Portable count leading zeros (returns 32 when `n` is 0 like the clz instruction)
+intrinsic uint32_t count_leading_zeros(uint32_t n) {
+    return (n == 0) ? 32 : (uint32_t)__builtin_clz(n);
+}
+
+/// The kernel only reads the stack pointer to find the unused part of the kernel stack, so the simulated machine reports an empty kernel stack (the host runs the kernel on its own stack)
+intrinsic uint32_t stack_pointer() {
+    extern uint32_t __kernel_main_stack_base;
+    return (uint32_t)&__kernel_main_stack_base;
+}
+
+/// Returns the simulated PSP
+intrinsic uint32_t process_stack_pointer() { return host_psp; }
+
+/// Returns the simulated IPSR
+intrinsic uint32_t active_exception() { return host_ipsr; }
+
+/// Exclusive store that always succeeds (nothing can run between the load and the store on the simulated machine)
+intrinsic uint32_t store_exclusive(uint32_t *addr, uint32_t value) {
+    *addr = value;
+    return 0;
+}
+
+/// Exclusive load (see store_exclusive)
+intrinsic uint32_t load_exclusive(uint32_t *addr) {
+    return *addr;
+}
+
+#endif
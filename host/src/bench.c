@@ -0,0 +1,675 @@
+/** @file   bench.c
+ *  @brief  Microbenchmarks of the kernel core on the simulated machine (entry point of the host build - `make host` builds and runs them).
+ *
+ *  Every figure is host wall clock time, so it compares revisions of the kernel on the same host rather than predicting cycles on the target.
+ *  The simulated clock only moves when a benchmark advances it, so the scheduler sees the same sequence of ticks on every run.
+**/
+
+#include "host.h"
+#include "arm.h"
+#include "svc_num.h"
+#include "multitask.h"
+#include "sync.h"
+#include "ring.h"
+#include "printk.h"
+#include "rtt.h"
+#include "pix.h"
+#include "mpu.h"
+
+/// Simulated processor cycles of work that a thread does before it yields (well inside its one timeslot budget)
+#define BENCH_WORK_CYCLES (1000)
+
+/// Scheduler frequency of the benchmarks (one timeslot per millisecond like most applications)
+#define BENCH_TIMESLOT_HZ (1000)
+
+/// Stack size of the simulated threads (they never run code so only their frames live there)
+#define BENCH_STACK_BYTES (256)
+
+/// Number of yields timed for every thread count
+#define BENCH_YIELDS (200000)
+
+/// Number of scheduling decisions timed for every thread count and every way of picking the next thread
+#define BENCH_PICKS (10000000)
+
+/// Number of MPU stack region switches timed for every way of switching the region
+#define BENCH_REGION_SWITCHES (10000000)
+
+/// Number of lock/unlock pairs that a thread makes per job in the lock benchmark
+#define BENCH_LOCK_BURST (100)
+
+/// Number of lock/unlock pairs timed
+#define BENCH_LOCK_PAIRS (1000000)
+
+/// Number of contended lock handoffs timed for every waiter count
+#define BENCH_HANDOFFS (200000)
+
+/// Event that the lock holder signals to a waiting server to make it take the lock
+#define BENCH_EVENT_LOCK (0x1)
+
+/// Event that the lock holder signals to a waiting server to make it end
+#define BENCH_EVENT_QUIT (0x2)
+
+/// Number of wakeups timed for every kind of synchronization object
+#define BENCH_SYNC_HANDOFFS (200000)
+
+/// Number of printk calls timed
+#define BENCH_PRINTK_CALLS (200000)
+
+/// Number of rtt_write calls timed
+#define BENCH_RTT_WRITES (200000)
+
+/// Bytes per rtt_write call (a quarter of the terminal up buffer)
+#define BENCH_RTT_CHUNK (64)
+
+/// Number of pix_color_set calls timed
+#define BENCH_PIX_CALLS (2000000)
+
+/**
+ * What a simulated thread does each time it is the active thread (`index` is its index in user_threads).
+ */
+typedef void (*bench_program)(uint8_t index);
+
+/// Operations completed by the threads of the running benchmark
+static uint32_t bench_ops = 0;
+
+/// Operations after which the threads of the running benchmark end themselves
+static uint32_t bench_target = 0;
+
+/// Wall clock nanoseconds spent in the timed part of the running benchmark
+static unsigned long long bench_ns = 0;
+
+/// Memory protection that bench_threads_define asks multitask_request for
+static mpu_mode bench_protection = KERNEL_PROTECT;
+
+/// Lock shared by the threads of the lock benchmarks (address returned by the last lock_init)
+static uint32_t bench_mutex = 0;
+
+/// First lock defined by the lock benchmarks (held around the bursts of the nested lock benchmark)
+static uint32_t bench_outer = 0;
+
+/// Number of servers that queue on the lock in the contended lock benchmark (the lock holder is the thread after them)
+static uint32_t bench_waiters = 0;
+
+/// Step of every simulated thread in the contended lock benchmark (threads are resumed in the middle of their job after a switch)
+static uint8_t bench_step[MAX_NUM_THREADS];
+
+/// Number of servers that the lock holder has signalled in the current round of the contended lock benchmark
+static uint32_t bench_signalled = 0;
+
+/// Number of PendSV exceptions taken while the lock of the contended lock benchmark is handed down the wait queue
+static unsigned long long bench_switches = 0;
+
+/// Value of host_pendsv_count when the holder released the lock in the current round
+static unsigned long long bench_drain_start = 0;
+
+/// Kinds of synchronization objects timed by the sync benchmark
+typedef enum {
+    BenchSyncSemaphore, ///< The waiter takes a semaphore that the signaller posts
+    BenchSyncEvent, ///< The waiter waits for an event flag that the signaller sets
+    BenchSyncCond, ///< The waiter waits on a condition variable that the signaller signals while holding its lock
+    BenchSyncRing ///< The waiter waits for a slot of a ring that the signaller commits (notifying only because the waiter is blocked)
+} bench_sync_kind;
+
+/// Kind of synchronization object of the running sync benchmark
+static bench_sync_kind bench_sync = BenchSyncSemaphore;
+
+/// Semaphore, event group, condition variable, or ring of the running sync benchmark (address returned by its init syscall)
+static uint32_t bench_sync_object = 0;
+
+/// Wall clock time at which the signaller made its last signalling syscall in the sync benchmark
+static unsigned long long bench_signal_start = 0;
+
+/// Wakeups in the sync benchmark where the waiter did not get what it waited for (the flag it waited for or the lock of the condition variable)
+static uint32_t bench_sync_errors = 0;
+
+/// Sum of the thread indices picked by the pick benchmark (read afterwards so the timed calls cannot be dropped)
+static volatile uint32_t bench_pick_sink = 0;
+
+/**
+ * Prints through printk and forwards the line to the host stdout.
+ */
+#define bench_report(...) do { printk(__VA_ARGS__); host_console_flush(); } while (0)
+
+/**
+ * Returns `total` divided by `count` (0 if nothing was counted).
+ */
+static uint32_t bench_per(unsigned long long total, unsigned long long count) {
+    return (count == 0) ? 0 : (uint32_t)(total / count);
+}
+
+/**
+ * Function of every simulated thread (only stacked as its entry point since the benchmark acts for the thread).
+ */
+static void bench_thread() {
+    host_halt("simulated thread executed");
+}
+
+/**
+ * Defines `num_threads` threads that all share a period long enough for every one of them to run once (IDs in index order).
+ * Returns 0 on success and the failing syscall's error code otherwise.
+ */
+static int bench_threads_define(uint32_t num_threads, uint32_t num_locks) {
+    host_kernel_reset();
+    int rv = (int)host_svc(SVC_MULTITASK_REQUEST, num_threads, BENCH_STACK_BYTES, 0, bench_protection, num_locks, RATE_MONOTONIC);
+    if (rv < 0) return rv;
+
+    // The benchmarks use the first and the last lock (the others only make the kernel keep track of more locks)
+    for (uint32_t lock_index = 0; lock_index < num_locks; lock_index++) {
+        bench_mutex = host_svc(SVC_LOCK_INIT, 0, 0, 0, 0, 0, 0);
+        if (bench_mutex == 0) return -1;
+        if (lock_index == 0) bench_outer = bench_mutex;
+    }
+
+    for (uint32_t id = 0; id < num_threads; id++) {
+        rv = (int)host_svc(SVC_THREAD_DEFINE, id, (uint32_t)bench_thread, 0, 1, 2*num_threads, 0);
+        if (rv < 0) return rv;
+    }
+    return 0;
+}
+
+/**
+ * Starts the scheduler and acts for the active thread until `bench_target` operations are done and every thread has ended (the main thread is switched back in).
+ * The idle thread sleeps until the next SysTick interrupt.
+ */
+static int bench_threads_run(bench_program program, uint32_t target) {
+    bench_ops = 0;
+    bench_target = target;
+    bench_ns = 0;
+    host_pendsv_count = 0;
+
+    int rv = (int)host_svc(SVC_MULTITASK_START, BENCH_TIMESLOT_HZ, PERIODIC_TICK, 0, 0, 0, 0);
+    if (rv < 0) return rv;
+
+    while (active_thread_index != num_user_threads+1) {
+        if (active_thread_index == num_user_threads) {
+            host_wait_for_interrupt();
+        } else if (bench_ops >= bench_target) {
+            host_svc(SVC_THREAD_END, 0, 0, 0, 0, 0, 0);
+        } else {
+            program(active_thread_index);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Does a little work and yields (one job per period).
+ */
+static void bench_yield_program(uint8_t index) {
+    unsigned long long start = host_time_ns();
+    host_clock_advance(BENCH_WORK_CYCLES);
+
+    // A tick during the work may have switched to another thread
+    if (active_thread_index == index) {
+        host_svc(SVC_THREAD_YIELD, 0, 0, 0, 0, 0, 0);
+        bench_ops++;
+    }
+    bench_ns += host_time_ns() - start;
+}
+
+/**
+ * Makes a burst of uncontended lock/unlock pairs and yields.
+ */
+static void bench_lock_program(__attribute__((unused)) uint8_t index) {
+    unsigned long long start = host_time_ns();
+    for (uint32_t pair = 0; pair < BENCH_LOCK_BURST; pair++) {
+        host_svc(SVC_LOCK, bench_mutex, 0, 0, 0, 0, 0);
+        host_svc(SVC_UNLOCK, bench_mutex, 0, 0, 0, 0, 0);
+    }
+    bench_ns += host_time_ns() - start;
+    bench_ops += BENCH_LOCK_BURST;
+    host_svc(SVC_THREAD_YIELD, 0, 0, 0, 0, 0, 0);
+}
+
+/**
+ * Takes bench_outer, makes a burst of lock/unlock pairs of bench_mutex inside it (each one pushed onto and popped off the ceiling stack above bench_outer), releases bench_outer, and yields.
+ */
+static void bench_lock_nested_program(__attribute__((unused)) uint8_t index) {
+    host_svc(SVC_LOCK, bench_outer, 0, 0, 0, 0, 0);
+    unsigned long long start = host_time_ns();
+    for (uint32_t pair = 0; pair < BENCH_LOCK_BURST; pair++) {
+        host_svc(SVC_LOCK, bench_mutex, 0, 0, 0, 0, 0);
+        host_svc(SVC_UNLOCK, bench_mutex, 0, 0, 0, 0, 0);
+    }
+    bench_ns += host_time_ns() - start;
+    bench_ops += BENCH_LOCK_BURST;
+    host_svc(SVC_UNLOCK, bench_outer, 0, 0, 0, 0, 0);
+    host_svc(SVC_THREAD_YIELD, 0, 0, 0, 0, 0, 0);
+}
+
+/**
+ * Makes a burst of lock/unlock pairs the way lock() and unlock() in user/src/lock.c do (the lock words are only written by the thread, so the kernel accounts them at the yield) and yields.
+ */
+static void bench_lock_fast_program(__attribute__((unused)) uint8_t index) {
+    unsigned long long start = host_time_ns();
+    uint32_t bit = 1u << (((mutex_t*)bench_mutex) - user_locks);
+    for (uint32_t pair = 0; pair < BENCH_LOCK_BURST; pair++) {
+        if (lock_shared.held == 0) {
+            lock_shared.held = bit;
+        } else {
+            host_svc(SVC_LOCK, bench_mutex, 0, 0, 0, 0, 0);
+        }
+        if ((lock_shared.held & bit) && !(lock_shared.contended & bit)) {
+            lock_shared.held &= ~bit;
+        } else {
+            host_svc(SVC_UNLOCK, bench_mutex, 0, 0, 0, 0, 0);
+        }
+    }
+    bench_ns += host_time_ns() - start;
+    bench_ops += BENCH_LOCK_BURST;
+    host_svc(SVC_THREAD_YIELD, 0, 0, 0, 0, 0, 0);
+}
+
+/**
+ * Times an unlock of bench_mutex that hands it to a waiter (including the PendSV that switches to the waiter).
+ */
+static void bench_handoff() {
+    unsigned long long start = host_time_ns();
+    host_svc(SVC_UNLOCK, bench_mutex, 0, 0, 0, 0, 0);
+    bench_ns += host_time_ns() - start;
+    bench_ops++;
+}
+
+/**
+ * Contended lock benchmark: the last thread takes the lock and signals every server in turn (each server preempts it and blocks on the lock), then unlocks.
+ * The lock then travels down the wait queue (every server unlocks as soon as it holds it), so each round is one handoff per waiter.
+ * Once enough handoffs are done the holder tells the servers to end and ends itself.
+ */
+static void bench_contended_program(uint8_t index) {
+    uint32_t id = user_threads[index].id;
+    if (id < bench_waiters) {
+        if (bench_step[id] == 0) {
+            uint32_t events = host_svc(SVC_SERVER_WAIT, BENCH_EVENT_LOCK | BENCH_EVENT_QUIT, 0, 0, 0, 0, 0);
+            if (host_svc_blocked) {
+                return;
+            }
+            if (events & BENCH_EVENT_QUIT) {
+                host_svc(SVC_THREAD_END, 0, 0, 0, 0, 0, 0);
+                return;
+            }
+            bench_step[id] = 1; // Holds the lock once it runs again (the holder still has it so this blocks)
+            host_svc(SVC_LOCK, bench_mutex, 0, 0, 0, 0, 0);
+        } else if (id + 1 < bench_waiters) {
+            bench_step[id] = 0;
+            bench_handoff();
+        } else {
+            bench_switches += host_pendsv_count - bench_drain_start; // Last waiter has nobody to hand the lock to
+            bench_step[id] = 0;
+            host_svc(SVC_UNLOCK, bench_mutex, 0, 0, 0, 0, 0);
+        }
+        return;
+    }
+
+    if (bench_step[id] == 0) {
+        bench_signalled = 0;
+        bench_step[id] = (bench_ops >= BENCH_HANDOFFS) ? 3 : 1;
+        if (bench_step[id] == 1) {
+            host_svc(SVC_LOCK, bench_mutex, 0, 0, 0, 0, 0);
+        }
+    } else if ((bench_step[id] == 1) && (bench_signalled < bench_waiters)) {
+        host_svc(SVC_SERVER_NOTIFY, bench_signalled++, BENCH_EVENT_LOCK, 0, 0, 0, 0);
+    } else if (bench_step[id] == 1) {
+        bench_step[id] = 2;
+        bench_drain_start = host_pendsv_count;
+        bench_handoff();
+    } else if (bench_step[id] == 2) {
+        bench_step[id] = 0;
+        host_svc(SVC_THREAD_YIELD, 0, 0, 0, 0, 0, 0);
+    } else if (bench_signalled < bench_waiters) {
+        host_svc(SVC_SERVER_NOTIFY, bench_signalled++, BENCH_EVENT_QUIT, 0, 0, 0, 0);
+    } else {
+        host_svc(SVC_THREAD_END, 0, 0, 0, 0, 0, 0);
+    }
+}
+
+/**
+ * Sync benchmark: the higher priority thread blocks on bench_sync_object and the other thread signals it, so every signal wakes the waiter and switches to it (and its next wait switches back).
+ * The wakeup is timed from the signalling syscall until the waiter runs again, and the waiter checks that it got the flag it waited for or holds the lock of the condition variable.
+ */
+static void bench_sync_program(uint8_t index) {
+    if (user_threads[index].id == 0) {
+        if (bench_step[0] == 0) {
+            // A condition variable is only waited on while holding its lock
+            bench_step[0] = 1;
+            if (bench_sync == BenchSyncCond) {
+                host_svc(SVC_LOCK, bench_mutex, 0, 0, 0, 0, 0);
+                return;
+            }
+        } else if (bench_step[0] == 2) {
+            bench_ns += host_time_ns() - bench_signal_start;
+            bench_ops++;
+            if ((bench_sync == BenchSyncEvent) && (thread_stack_frame(index)->r0 != BENCH_EVENT_LOCK)) {
+                bench_sync_errors++;
+            }
+            if ((bench_sync == BenchSyncCond) && (((mutex_t*)bench_mutex)->current_locker != &user_threads[index])) {
+                bench_sync_errors++;
+            }
+            if (bench_sync == BenchSyncRing) {
+                // Releases the committed slot like ring_release (the producer is never blocked so there is nobody to notify)
+                ring_shared_t* ring = (ring_shared_t*)bench_sync_object;
+                if (ring->head == ring->tail) {
+                    bench_sync_errors++;
+                }
+                ring->tail = ring->tail + 1;
+            }
+            if (bench_ops >= bench_target) {
+                return; // Ended by bench_threads_run instead of blocking again
+            }
+        }
+
+        bench_step[0] = 2;
+        if (bench_sync == BenchSyncSemaphore) {
+            host_svc(SVC_SEM_WAIT, bench_sync_object, 0, 0, 0, 0, 0);
+        } else if (bench_sync == BenchSyncEvent) {
+            host_svc(SVC_EVENT_WAIT, bench_sync_object, BENCH_EVENT_LOCK, EVENT_WAIT_CLEAR, 0, 0, 0);
+        } else if (bench_sync == BenchSyncRing) {
+            host_svc(SVC_RING_WAIT, bench_sync_object, RING_WAIT_DATA, 0, 0, 0, 0);
+        } else {
+            host_svc(SVC_COND_WAIT, bench_sync_object, bench_mutex, 0, 0, 0, 0);
+        }
+        return;
+    }
+
+    // The waiter takes the lock of the condition variable back once the signaller unlocks it
+    bench_signal_start = host_time_ns();
+    if (bench_sync == BenchSyncSemaphore) {
+        host_svc(SVC_SEM_POST, bench_sync_object, 0, 0, 0, 0, 0);
+    } else if (bench_sync == BenchSyncEvent) {
+        host_svc(SVC_EVENT_SET, bench_sync_object, BENCH_EVENT_LOCK, 0, 0, 0, 0);
+    } else if (bench_sync == BenchSyncRing) {
+        // Commits a slot like ring_commit
+        ring_shared_t* ring = (ring_shared_t*)bench_sync_object;
+        ring->head = ring->head + 1;
+        if (ring->waiting & RING_WAIT_DATA) {
+            host_svc(SVC_RING_NOTIFY, bench_sync_object, 0, 0, 0, 0, 0);
+        }
+    } else {
+        host_svc(SVC_LOCK, bench_mutex, 0, 0, 0, 0, 0);
+        host_svc(SVC_COND_SIGNAL, bench_sync_object, 0, 0, 0, 0, 0);
+        host_svc(SVC_UNLOCK, bench_mutex, 0, 0, 0, 0, 0);
+    }
+}
+
+/**
+ * Defines the waiter and the signaller of the sync benchmark and the object of the `kind` they share (with a lock for the condition variable).
+ * Returns 0 on success and the failing syscall's error code otherwise.
+ */
+static int bench_sync_define(bench_sync_kind kind) {
+    host_kernel_reset();
+    bench_sync = kind;
+    bench_sync_errors = 0;
+    bench_step[0] = 0;
+    int rv = (int)host_svc(SVC_MULTITASK_REQUEST, 2, BENCH_STACK_BYTES, 0, KERNEL_PROTECT, 1, RATE_MONOTONIC);
+    if (rv < 0) return rv;
+
+    bench_mutex = host_svc(SVC_LOCK_INIT, 0, 0, 0, 0, 0, 0);
+    if (kind == BenchSyncSemaphore) {
+        bench_sync_object = host_svc(SVC_SEM_INIT, 0, 0, 0, 0, 0, 0);
+    } else if (kind == BenchSyncEvent) {
+        bench_sync_object = host_svc(SVC_EVENT_GROUP_INIT, 0, 0, 0, 0, 0, 0);
+    } else if (kind == BenchSyncRing) {
+        bench_sync_object = host_svc(SVC_RING_INIT, sizeof(uint32_t), 4, 0, 0, 0, 0);
+    } else {
+        bench_sync_object = host_svc(SVC_COND_INIT, 0, 0, 0, 0, 0, 0);
+    }
+    if ((bench_mutex == 0) || (bench_sync_object == 0)) return -1;
+
+    for (uint32_t id = 0; id < 2; id++) {
+        rv = (int)host_svc(SVC_THREAD_DEFINE, id, (uint32_t)bench_thread, 0, 1, 4, 0);
+        if (rv < 0) return rv;
+    }
+    return 0;
+}
+
+/**
+ * Defines `waiters` servers and the lock holder after them (all with one timeslot per period, and a period long enough that the servers are admitted with the holder blocking them).
+ * Returns 0 on success and the failing syscall's error code otherwise.
+ */
+static int bench_contended_define(uint32_t waiters) {
+    host_kernel_reset();
+    bench_waiters = waiters;
+    bench_switches = 0;
+    for (uint32_t id = 0; id <= waiters; id++) {
+        bench_step[id] = 0;
+    }
+
+    uint32_t period = 4 * (waiters + 1);
+    int rv = (int)host_svc(SVC_MULTITASK_REQUEST, waiters + 1, BENCH_STACK_BYTES, 0, KERNEL_PROTECT, 1, RATE_MONOTONIC);
+    if (rv < 0) return rv;
+
+    bench_mutex = host_svc(SVC_LOCK_INIT, 0, 0, 0, 0, 0, 0);
+    if (bench_mutex == 0) return -1;
+
+    for (uint32_t id = 0; id < waiters; id++) {
+        rv = (int)host_svc(SVC_SERVER_DEFINE, id, (uint32_t)bench_thread, 0, 1, period, 0);
+        if (rv < 0) return rv;
+    }
+    rv = (int)host_svc(SVC_THREAD_DEFINE, waiters, (uint32_t)bench_thread, 0, 1, period, 0);
+    return (rv < 0) ? rv : 0;
+}
+
+/**
+ * Times the scheduler for a growing number of threads that each do a little work and yield once per period.
+ */
+static void bench_schedule() {
+    const uint32_t thread_counts[] = {4, 16, MAX_NUM_THREADS};
+    for (uint32_t count = 0; count < sizeof(thread_counts) / sizeof(thread_counts[0]); count++) {
+        uint32_t num_threads = thread_counts[count];
+        if ((bench_threads_define(num_threads, 0) < 0) || (bench_threads_run(bench_yield_program, BENCH_YIELDS) < 0)) {
+            bench_report("schedule: setup failed for %d threads\n", num_threads);
+            continue;
+        }
+        bench_report("schedule: threads=%d yields=%d pendsv=%u ns/yield=%u\n", num_threads, bench_ops, (uint32_t)host_pendsv_count, bench_per(bench_ns, bench_ops));
+    }
+}
+
+/**
+ * Selection loop that schedule_rms ran before the ready bitmap (a scan of every TCB for the ready thread with the highest dynamic priority), kept as the baseline of the pick benchmark.
+ * The release bookkeeping that used to share the loop is left out, so only the selection itself is compared.
+ */
+static uint32_t bench_schedule_scan() {
+    uint32_t highest_priority = 0xFFFFFFFF;
+    uint32_t next_index = num_user_threads;
+    if (num_active_threads == 0) {
+        return num_user_threads+1;
+    }
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if (user_threads[index].state == ThreadDefunct) continue;
+        if ((user_threads[index].state == ThreadReady) && (user_threads[index].dynamic_priority < highest_priority)) {
+            highest_priority = user_threads[index].dynamic_priority;
+            next_index = index;
+        }
+    }
+    return next_index;
+}
+
+/**
+ * Times the scheduling decision alone for 4, 8 and 14 threads: the scan of every TCB against the CLZ pick from the ready bitmap (schedule_rms).
+ * Only the lowest priority thread is left ready, and both ways have to pick it (the scan looks at every TCB wherever the ready thread is).
+ */
+static void bench_schedule_pick() {
+    const uint32_t thread_counts[] = {4, 8, 14};
+    for (uint32_t count = 0; count < sizeof(thread_counts) / sizeof(thread_counts[0]); count++) {
+        uint32_t num_threads = thread_counts[count];
+        if (bench_threads_define(num_threads, 0) < 0) {
+            bench_report("schedule pick: setup failed for %d threads\n", num_threads);
+            continue;
+        }
+        for (uint8_t index = 0; index < num_threads - 1; index++) {
+            thread_set_state(&user_threads[index], ThreadWaiting);
+        }
+        uint32_t expected = num_threads - 1;
+
+        unsigned long long start = host_time_ns();
+        for (uint32_t pick = 0; pick < BENCH_PICKS; pick++) {
+            bench_pick_sink += bench_schedule_scan();
+        }
+        unsigned long long scan_ns = host_time_ns() - start;
+        uint32_t errors = (bench_schedule_scan() != expected);
+
+        start = host_time_ns();
+        for (uint32_t pick = 0; pick < BENCH_PICKS; pick++) {
+            bench_pick_sink += schedule_rms();
+        }
+        unsigned long long bitmap_ns = host_time_ns() - start;
+        errors += (schedule_rms() != expected);
+
+        bench_report("schedule pick: threads=%d picks=%d scan ps/pick=%u bitmap ps/pick=%u errors=%d\n", num_threads, BENCH_PICKS,
+                     bench_per(scan_ns * 1000, BENCH_PICKS), bench_per(bitmap_ns * 1000, BENCH_PICKS), errors);
+    }
+}
+
+/**
+ * Times the cost that THREAD_PROTECT adds to a context switch.
+ * The same yields as the schedule benchmark are timed under KERNEL_PROTECT and THREAD_PROTECT, which only differ in the stack region loaded by PendSV_C_Handler.
+ * The region switch itself is then timed alone, both by working out the region on the switch (what PendSV_C_Handler did before the regions were precomputed) and by loading the region precomputed in the TCB.
+ */
+static void bench_switch_protect() {
+    const mpu_mode modes[] = {KERNEL_PROTECT, THREAD_PROTECT};
+    const char* names[] = {"kernel", "thread"};
+    for (uint32_t mode = 0; mode < sizeof(modes) / sizeof(modes[0]); mode++) {
+        bench_protection = modes[mode];
+        if ((bench_threads_define(4, 0) < 0) || (bench_threads_run(bench_yield_program, BENCH_YIELDS) < 0)) {
+            bench_report("switch protect: setup failed for %s protection\n", names[mode]);
+            continue;
+        }
+        bench_report("switch protect: mode=%s threads=4 yields=%d pendsv=%u ns/yield=%u\n", names[mode], bench_ops, (uint32_t)host_pendsv_count, bench_per(bench_ns, bench_ops));
+    }
+    bench_protection = KERNEL_PROTECT;
+
+    // The stacks of the last run are still allocated so the regions of its threads are real ones
+    unsigned long long start = host_time_ns();
+    for (uint32_t region_switch = 0; region_switch < BENCH_REGION_SWITCHES; region_switch++) {
+        tcb_t* thread = &user_threads[region_switch & 3];
+        mpu_region_t region;
+        mpu_thread_region_disable();
+        mpu_subregion_encode(&region, MPU_THREAD_STACK_REGION, thread->limit_process_stack, (uint32_t)thread->base_process_stack - (uint32_t)thread->limit_process_stack, 0, 1);
+        mpu_stack_region_load(&region);
+    }
+    unsigned long long encode_ns = host_time_ns() - start;
+
+    start = host_time_ns();
+    for (uint32_t region_switch = 0; region_switch < BENCH_REGION_SWITCHES; region_switch++) {
+        mpu_stack_region_load(&user_threads[region_switch & 3].stack_region);
+    }
+    unsigned long long load_ns = host_time_ns() - start;
+    bench_report("switch protect: region switches=%d encoded ps/switch=%u precomputed ps/switch=%u\n", BENCH_REGION_SWITCHES,
+                 bench_per(encode_ns * 1000, BENCH_REGION_SWITCHES), bench_per(load_ns * 1000, BENCH_REGION_SWITCHES));
+}
+
+/**
+ * Times uncontended lock/unlock pairs through the syscalls (each pair is two syscalls and a PendSV after the unlock), through the user-space fast path, and nested inside another lock for a growing number of defined locks.
+ */
+static void bench_lock() {
+    if ((bench_threads_define(4, 1) < 0) || (bench_threads_run(bench_lock_program, BENCH_LOCK_PAIRS) < 0)) {
+        bench_report("lock: setup failed\n");
+        return;
+    }
+    bench_report("lock: pairs=%d ns/pair=%u\n", bench_ops, bench_per(bench_ns, bench_ops));
+
+    if ((bench_threads_define(4, 1) < 0) || (bench_threads_run(bench_lock_fast_program, BENCH_LOCK_PAIRS) < 0)) {
+        bench_report("lock fast path: setup failed\n");
+        return;
+    }
+    bench_report("lock fast path: pairs=%d ns/pair=%u\n", bench_ops, bench_per(bench_ns, bench_ops));
+
+    // The ceiling stack makes an unlock independent of the number of defined locks
+    const uint32_t lock_counts[] = {2, 8, MAX_USER_LOCKS};
+    for (uint32_t count = 0; count < sizeof(lock_counts) / sizeof(lock_counts[0]); count++) {
+        uint32_t num_locks = lock_counts[count];
+        if ((bench_threads_define(4, num_locks) < 0) || (bench_threads_run(bench_lock_nested_program, BENCH_LOCK_PAIRS) < 0)) {
+            bench_report("nested lock: setup failed for %d locks\n", num_locks);
+            continue;
+        }
+        bench_report("nested lock: locks=%d pairs=%d ns/pair=%u\n", num_locks, bench_ops, bench_per(bench_ns, bench_ops));
+    }
+}
+
+/**
+ * Times contended unlocks for a growing number of waiters and counts the PendSV exceptions that it takes to pass the lock down the wait queue (per 100 handoffs: the switch to the new holder and the one after the previous holder goes back to waiting, whatever the number of waiters).
+ */
+static void bench_contended() {
+    const uint32_t waiter_counts[] = {1, 4, 16};
+    for (uint32_t count = 0; count < sizeof(waiter_counts) / sizeof(waiter_counts[0]); count++) {
+        uint32_t waiters = waiter_counts[count];
+        if ((bench_contended_define(waiters) < 0) || (bench_threads_run(bench_contended_program, 0xFFFFFFFF) < 0)) {
+            bench_report("contended lock: setup failed for %d waiters\n", waiters);
+            continue;
+        }
+        bench_report("contended lock: waiters=%d handoffs=%d pendsv/100 handoffs=%u ns/handoff=%u\n", waiters, bench_ops, bench_per(bench_switches * 100, bench_ops), bench_per(bench_ns, bench_ops));
+    }
+}
+
+/**
+ * Times the wakeup of a blocked thread through a semaphore, an event flag, a condition variable, and a ring (each one a signal and two switches).
+ */
+static void bench_sync_objects() {
+    const char* names[] = {"semaphore", "event", "cond", "ring"};
+    for (uint32_t kind = BenchSyncSemaphore; kind <= BenchSyncRing; kind++) {
+        if ((bench_sync_define((bench_sync_kind)kind) < 0) || (bench_threads_run(bench_sync_program, BENCH_SYNC_HANDOFFS) < 0)) {
+            bench_report("sync: setup failed for %s\n", names[kind]);
+            continue;
+        }
+        bench_report("sync: object=%s wakeups=%d pendsv/100 wakeups=%u ns/wakeup=%u errors=%d\n", names[kind], bench_ops, bench_per(host_pendsv_count * 100, bench_ops), bench_per(bench_ns, bench_ops), bench_sync_errors);
+    }
+}
+
+/**
+ * Times printk formatting and the copy into the terminal up buffer (the buffer is drained without printing after every call).
+ */
+static void bench_printk() {
+    unsigned long long bytes = 0;
+    unsigned long long start = host_time_ns();
+    for (uint32_t call = 0; call < BENCH_PRINTK_CALLS; call++) {
+        printk("thread %d at %x: %s\n", call, call*4, "ok");
+        bytes += host_console_discard();
+    }
+    unsigned long long ns = host_time_ns() - start;
+    bench_report("printk: calls=%d bytes=%u ns/call=%u ns/byte=%u\n", BENCH_PRINTK_CALLS, (uint32_t)bytes, bench_per(ns, BENCH_PRINTK_CALLS), bench_per(ns, bytes));
+}
+
+/**
+ * Times rtt_write of fixed size chunks (the buffer is drained without printing after every call).
+ */
+static void bench_rtt() {
+    static char chunk[BENCH_RTT_CHUNK];
+    for (uint32_t byte = 0; byte < BENCH_RTT_CHUNK; byte++) {
+        chunk[byte] = 'a' + (byte % 26);
+    }
+    unsigned long long start = host_time_ns();
+    for (uint32_t call = 0; call < BENCH_RTT_WRITES; call++) {
+        rtt_write(chunk, BENCH_RTT_CHUNK);
+        host_console_discard();
+    }
+    unsigned long long ns = host_time_ns() - start;
+    bench_report("rtt_write: bytes=%d ns/call=%u ns/byte=%u\n", BENCH_RTT_CHUNK, bench_per(ns, BENCH_RTT_WRITES), bench_per(ns, (unsigned long long)BENCH_RTT_WRITES * BENCH_RTT_CHUNK));
+}
+
+/**
+ * Times the PWM duty cycle encoding of a single neopixel color.
+ */
+static void bench_pix() {
+    unsigned long long start = host_time_ns();
+    for (uint32_t call = 0; call < BENCH_PIX_CALLS; call++) {
+        pix_color_set(call & 0xFF, (call >> 8) & 0xFF, (call >> 16) & 0xFF, call % PIX_NUM);
+    }
+    unsigned long long ns = host_time_ns() - start;
+    bench_report("pix_color_set: calls=%d ns/call=%u\n", BENCH_PIX_CALLS, bench_per(ns, BENCH_PIX_CALLS));
+}
+
+/**
+ * Runs every benchmark once.
+ */
+int main() {
+    host_machine_init();
+    bench_schedule();
+    bench_schedule_pick();
+    bench_switch_protect();
+    bench_lock();
+    bench_contended();
+    bench_sync_objects();
+    bench_printk();
+    bench_rtt();
+    bench_pix();
+    return 0;
+}
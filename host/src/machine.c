@@ -0,0 +1,237 @@
+/** @file   machine.c
+ *  @brief  Simulated Cortex-M4 that runs the kernel core in a host process (exception entry, the SysTick clock, and the memory areas of the linker script).
+ *
+ *  Threads have no code of their own on the host: a benchmark acts for whichever thread is active and issues its syscalls through host_svc.
+ *  Every exception is entered the way the target enters it (the hardware frame of the running thread on the simulated PSP and the switch frame that PendSV_Handler pushes below it), so the scheduler, the syscalls, and the locks run unchanged.
+**/
+
+#include "host.h"
+#include "arm.h"
+#include "thread.h"
+#include "syscall.h"
+#include "systick.h"
+#include "multitask.h"
+#include "rtt.h"
+
+/// Simulated PRIMASK
+volatile uint32_t host_primask = 0;
+
+/// Simulated PSP
+uint32_t host_psp = 0;
+
+/// Simulated IPSR
+uint32_t host_ipsr = 0;
+
+/// Set when the last host_svc blocked its thread
+unsigned int host_svc_blocked = 0;
+
+/// Number of simulated PendSV exceptions
+unsigned long long host_pendsv_count = 0;
+
+/// RTT control block (placed by the linker script on the target)
+rtt_control_block __rtt_start;
+
+/// Lock words shared with user space (defined by the user library on the target)
+volatile lock_shared_t lock_shared;
+
+/// Memory areas that the linker script reserves on the target (host/host.lds points the kernel's range symbols at them)
+uint8_t host_heap[0x10000] __attribute__((aligned(0x10000)));
+uint8_t host_user_data[0x1000] __attribute__((aligned(0x1000)));
+uint8_t host_user_bss[0x1000] __attribute__((aligned(0x1000)));
+uint8_t host_user_process_stack[0x4000] __attribute__((aligned(0x4000)));
+uint8_t host_kernel_main_stack[0x4000] __attribute__((aligned(0x4000)));
+uint8_t host_thread_user_stacks[MAX_TOTAL_THREAD_STACK_SIZE] __attribute__((aligned(MAX_TOTAL_THREAD_STACK_SIZE)));
+
+/// Kernel handlers entered from the vector table on the target (the assembly wrappers are replaced by host_pendsv and host_svc)
+void* PendSV_C_Handler(void* psp);
+void SysTick_Handler();
+
+/// Simulated svc instructions (`svc n` at index n) that the stacked pc of a syscall points past
+static uint16_t svc_instructions[256];
+
+/// Processor cycles since the last SysTick reload (the simulated SysTick counter counts down from RVR through 0)
+static uint32_t systick_elapsed = 0;
+
+/// Nonzero while a SysTick interrupt is pending because PRIMASK was set when it fired
+static uint8_t systick_pending = 0;
+
+/**
+ * Entry point of user space threads once their function returns (the stacked lr of a new thread points here on the target - never executed on the host).
+ */
+void thread_end() {
+    host_halt("thread_end executed on the host");
+}
+
+/**
+ * Default idle thread function (its stacked pc on the target - the benchmarks call host_wait_for_interrupt instead).
+ */
+void default_idle() {
+    host_halt("default_idle executed on the host");
+}
+
+/**
+ * Runs the PendSV exception the way PendSV_Handler does: pushes the basic switch frame below the hardware frame of the running thread, calls PendSV_C_Handler, and pops the switch frame of the thread it returns.
+ */
+static void host_pendsv() {
+    // Hardware clears the pending bit on entry (PendSV_C_Handler also writes PENDSVCLR which the register file keeps)
+    ICSR &= ~((1u << 28) | (1u << 27));
+    host_ipsr = 14;
+
+    // Simulated threads never touch the FPU so the outgoing thread always has a basic frame
+    switch_stackframe_t* outgoing = (switch_stackframe_t*)(host_psp - SWITCH_STACKFRAME_BASIC_SIZE);
+    if ((uint32_t)outgoing < (uint32_t)switch_frame_limit) {
+        host_halt("switch frame does not fit above the process stack limit");
+    }
+    outgoing->lr = EXC_RETURN_THREAD_PSP;
+    switch_stackframe_t* incoming = PendSV_C_Handler(outgoing);
+    host_pendsv_count++;
+
+    ICSR &= ~((1u << 28) | (1u << 27));
+    host_psp = (uint32_t)incoming + ((incoming->lr & EXC_RETURN_BASIC_FRAME) ? SWITCH_STACKFRAME_BASIC_SIZE : sizeof(switch_stackframe_t));
+    host_ipsr = 0;
+}
+
+/**
+ * Delivers the pending SysTick interrupt and then PendSV (which has the same priority as every other exception so it tail chains once the others are done).
+ */
+static void host_exceptions_deliver() {
+    if (host_primask) {
+        return;
+    }
+    if (systick_pending) {
+        systick_pending = 0;
+        host_ipsr = 15;
+        SysTick_Handler();
+        host_ipsr = 0;
+    }
+    if (ICSR & (1u << 28)) {
+        host_pendsv();
+    }
+}
+
+/**
+ * Maps the registers and brings up the parts of kernel_main that the kernel core depends on (RTT and the cycle counter).
+ */
+void host_machine_init(void) {
+    host_mmio_map();
+    for (uint32_t num = 0; num < 256; num++) {
+        svc_instructions[num] = 0xDF00 | num;
+    }
+    rtt_init();
+    enable_cycle_counter();
+
+    // Main starts on the user process stack with room above its frame for the stacked 5th and 6th syscall arguements
+    extern uint32_t __user_process_stack_base;
+    host_psp = (uint32_t)&__user_process_stack_base - sizeof(stack_frame_t) - 2*sizeof(uint32_t);
+}
+
+/**
+ * Clears the flags that make a second multitask_request or thread_define fail (and the one that adds blocking to admission once started) (every thread has ended so nothing else is left over).
+ */
+void host_kernel_reset(void) {
+    extern uint8_t multitask_request_called;
+    extern uint8_t thread_define_called;
+    extern uint8_t multitask_start_called;
+    multitask_request_called = 0;
+    thread_define_called = 0;
+    multitask_start_called = 0;
+    num_defined_locks = 0;
+    lock_shared.held = 0;
+    lock_shared.contended = 0;
+    lock_held_seen = 0;
+    num_active_threads = 0;
+    total_utilization = 0;
+}
+
+/**
+ * Advances DWT_CYCCNT and the SysTick counter (interrupts that fire while PRIMASK is set are delivered once it is clear).
+ */
+void host_clock_advance(unsigned int cycles) {
+    if (DWT_CTRL & 1) {
+        DWT_CYCCNT += cycles;
+    }
+
+    volatile systick_t* systick = (volatile systick_t*)SYSTICK_BASE_ADDR;
+    if ((systick->CSR & 1) == 0) {
+        return;
+    }
+
+    // Every reload of the simulated counter is one SysTick interrupt (a handler that is still pending when the next one fires merges with it)
+    uint32_t period = (systick->RVR & MAX_24_BIT) + 1;
+    systick_elapsed += cycles;
+    while (systick_elapsed >= period) {
+        systick_elapsed -= period;
+        systick->CSR |= (1u << 16);
+        if (systick->CSR & (1u << 1)) {
+            systick_pending = 1;
+            host_exceptions_deliver();
+            if ((systick->CSR & 1) == 0) {
+                break;
+            }
+        }
+    }
+    systick->CVR = period - 1 - systick_elapsed;
+}
+
+/**
+ * Sleeps until the next SysTick interrupt (there is no other interrupt source on the simulated machine).
+ */
+void host_wait_for_interrupt(void) {
+    volatile systick_t* systick = (volatile systick_t*)SYSTICK_BASE_ADDR;
+    if ((systick->CSR & 3) != 3) {
+        host_halt("wait for interrupt with no interrupt source");
+    }
+    host_clock_advance((systick->RVR & MAX_24_BIT) + 1 - systick_elapsed);
+}
+
+/**
+ * Stacks the frame that an svc instruction at svc_instructions[svc_num] would, runs SVC_C_Handler on it, and delivers the PendSV that it requested.
+ */
+unsigned int host_svc(unsigned int svc_num, unsigned int r0, unsigned int r1, unsigned int r2, unsigned int r3, unsigned int arg5, unsigned int arg6) {
+    // Hardware stacks the frame of the calling thread on its process stack
+    stack_frame_t* frame = (stack_frame_t*)host_psp;
+    frame->r0 = r0;
+    frame->r1 = r1;
+    frame->r2 = r2;
+    frame->r3 = r3;
+    ((uint32_t*)frame)[8] = arg5;
+    ((uint32_t*)frame)[9] = arg6;
+    frame->pc = (uint32_t)&svc_instructions[svc_num & 0xFF] + sizeof(uint16_t);
+    frame->xpsr = 0x01000000; // Thumb state with no alignment padding (the stacked arguements are right above the frame)
+
+    host_ipsr = 11;
+    SVC_C_Handler(frame, EXC_RETURN_THREAD_PSP);
+    host_ipsr = 0;
+
+    // A rewound pc means the thread has to execute the svc again once it is scheduled
+    host_svc_blocked = (frame->pc == (uint32_t)&svc_instructions[svc_num & 0xFF]);
+    unsigned int result = frame->r0;
+    host_exceptions_deliver();
+    return result;
+}
+
+/**
+ * Reads the terminal up buffer like the debugger (the unread part may wrap around the end of the ring).
+ */
+void host_console_flush(void) {
+    rtt_up_buffer* up_buffer = &__rtt_start.up_buffer;
+    uint32_t write_index = up_buffer->w_idx;
+    uint32_t read_index = up_buffer->r_idx;
+    if (write_index < read_index) {
+        host_console_write(&up_buffer->p[read_index], up_buffer->buffer_size - read_index);
+        read_index = 0;
+    }
+    host_console_write(&up_buffer->p[read_index], write_index - read_index);
+    up_buffer->r_idx = write_index;
+}
+
+/**
+ * Marks the whole terminal up buffer as read.
+ */
+unsigned int host_console_discard(void) {
+    rtt_up_buffer* up_buffer = &__rtt_start.up_buffer;
+    uint32_t write_index = up_buffer->w_idx;
+    uint32_t read_index = up_buffer->r_idx;
+    up_buffer->r_idx = write_index;
+    return (write_index >= read_index) ? (write_index - read_index) : (up_buffer->buffer_size - read_index + write_index);
+}
@@ -0,0 +1,67 @@
+/** @file   mmio.c
+ *  @brief  Host process side of the simulated machine (the only file of the host build that uses libc).
+**/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "host.h"
+
+/**
+ * Address range of the target that the kernel accesses through MMIO.
+ */
+typedef struct {
+    unsigned long base; ///< First address of the range
+    unsigned long size; ///< Number of bytes in the range
+    const char* name; ///< Name of the range for error messages
+} host_mmio_range;
+
+/// Register ranges of the nRF52840 and the Cortex-M4 that the kernel touches
+static const host_mmio_range mmio_ranges[] = {
+    {0x40000000, 0x100000, "APB peripherals"},
+    {0x50000000, 0x1000, "GPIO"},
+    {0xE0000000, 0x100000, "private peripheral bus"},
+};
+
+/**
+ * Maps every range in mmio_ranges at its target address.
+ */
+void host_mmio_map(void) {
+    for (unsigned int range = 0; range < sizeof(mmio_ranges) / sizeof(mmio_ranges[0]); range++) {
+        void* base = (void*)mmio_ranges[range].base;
+        void* mapped = mmap(base, mmio_ranges[range].size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (mapped != base) {
+            fprintf(stderr, "host: cannot map the %s registers at %#lx\n", mmio_ranges[range].name, mmio_ranges[range].base);
+            exit(2);
+        }
+    }
+}
+
+/**
+ * Reads CLOCK_MONOTONIC.
+ */
+unsigned long long host_time_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ull + (unsigned long long)now.tv_nsec;
+}
+
+/**
+ * Writes to stdout without buffering so that kernel output and host messages stay in order.
+ */
+void host_console_write(const char* bytes, unsigned int len) {
+    fwrite(bytes, 1, len, stdout);
+    fflush(stdout);
+}
+
+/**
+ * Exits with a nonzero status (the kernel has no way to continue after a breakpoint or a wfi with interrupts disabled).
+ */
+void host_halt(const char* reason) {
+    fflush(stdout);
+    fprintf(stderr, "host: simulation halted (%s)\n", reason);
+    exit(1);
+}
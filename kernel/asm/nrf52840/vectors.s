@@ -0,0 +1,165 @@
+@   file:        vectors.s
+@   description: vector table and default external interrupt handlers
+@   target:      Nordic nRF52840
+
+    .syntax unified
+    .arch armv7e-m
+    .cpu cortex-m4
+    .fpu fpv4-sp-d16
+    .thumb
+
+    .section .vector_table
+    .global __vector_table
+__vector_table:
+    .long __kernel_main_stack_base             @ base address of kernel main stack
+
+@
+@  Armv7-M system faults and exceptions
+@
+    .long Reset_Handler
+    .long NMI_Handler
+    .long HardFault_Handler
+    .long MemFault_Handler
+    .long BusFault_Handler
+    .long UsageFault_Handler
+    .long 0
+    .long 0
+    .long 0
+    .long 0
+    .long SVC_Handler
+    .long DebugMon_Handler
+    .long 0
+    .long PendSV_Handler
+    .long SysTick_Handler
+
+@
+@  nRF52840 external interrupts
+@
+    .long POWER_CLOCK_Handler
+    .long RADIO_Handler
+    .long UARTE0_Handler
+    .long SPIM0_SPIS0_TWIM0_TWIS0_Handler
+    .long SPIM1_SPIS1_TWIM1_TWIS1_Handler
+    .long NFCT_Handler
+    .long GPIOTE_Handler
+    .long SAADC_Handler
+    .long TIMER0_Handler
+    .long TIMER1_Handler
+    .long TIMER2_Handler
+    .long RTC0_Handler
+    .long TEMP_Handler
+    .long RNG_Handler
+    .long ECB_Handler
+    .long CCM_AAR_Handler
+    .long WDT_Handler
+    .long RTC1_Handler
+    .long QDEC_Handler
+    .long COMP_LPCOMP_Handler
+    .long SWI0_EGU0_Handler
+    .long SWI1_EGU1_Handler
+    .long SWI2_EGU2_Handler
+    .long SWI3_EGU3_Handler
+    .long SWI4_EGU4_Handler
+    .long SWI5_EGU5_Handler
+    .long TIMER3_Handler
+    .long TIMER4_Handler
+    .long PWM0_Handler
+    .long PDM_Handler
+    .long ACL_NVMC_Handler
+    .long PPI_Handler
+    .long MWU_Handler
+    .long PWM1_Handler
+    .long PWM2_Handler
+    .long SPIM2_SPIS2_Handler
+    .long RTC2_Handler
+    .long I2S_Handler
+    .long FPU_Handler
+    .long USBD_Handler
+    .long UARTE1_Handler
+    .long QSPI_Handler
+    .long 0
+    .long 0
+    .long 0
+    .long PWM3_Handler
+    .long 0
+    .long SPIM3_Handler
+
+    .size __vector_table, . - __vector_table
+
+
+@   macro:       EXHANDLER
+@   description: assembly macro providing weak handler definition that
+@                refers to a default handler containing an infinite loop
+    .text
+    .thumb_func
+    .global Default_Handler
+    .type Default_Handler, %function
+Default_Handler:
+    bkpt
+    b .
+    .size Default_Handler, . - Default_Handler
+
+    .macro EXHANDLER handler
+    .weak \handler
+    .set \handler, Default_Handler
+    .endm
+
+@
+@  default definitions for system faults and exceptions
+@
+    EXHANDLER NMI_Handler
+    EXHANDLER HardFault_Handler
+    EXHANDLER BusFault_Handler
+    EXHANDLER UsageFault_Handler
+    EXHANDLER DebugMon_Handler
+    EXHANDLER SysTick_Handler
+
+@
+@  default definitions for external interrupts
+@
+    EXHANDLER POWER_CLOCK_Handler
+    EXHANDLER RADIO_Handler
+    EXHANDLER UARTE0_Handler
+    EXHANDLER SPIM0_SPIS0_TWIM0_TWIS0_Handler
+    EXHANDLER SPIM1_SPIS1_TWIM1_TWIS1_Handler
+    EXHANDLER NFCT_Handler
+    EXHANDLER GPIOTE_Handler
+    EXHANDLER SAADC_Handler
+    EXHANDLER TIMER0_Handler
+    EXHANDLER TIMER1_Handler
+    EXHANDLER TIMER2_Handler
+    EXHANDLER RTC0_Handler
+    EXHANDLER TEMP_Handler
+    EXHANDLER RNG_Handler
+    EXHANDLER ECB_Handler
+    EXHANDLER CCM_AAR_Handler
+    EXHANDLER WDT_Handler
+    EXHANDLER RTC1_Handler
+    EXHANDLER QDEC_Handler
+    EXHANDLER COMP_LPCOMP_Handler
+    EXHANDLER SWI0_EGU0_Handler
+    EXHANDLER SWI1_EGU1_Handler
+    EXHANDLER SWI2_EGU2_Handler
+    EXHANDLER SWI3_EGU3_Handler
+    EXHANDLER SWI4_EGU4_Handler
+    EXHANDLER SWI5_EGU5_Handler
+    EXHANDLER TIMER3_Handler
+    EXHANDLER TIMER4_Handler
+    EXHANDLER PWM0_Handler
+    EXHANDLER PDM_Handler
+    EXHANDLER ACL_NVMC_Handler
+    EXHANDLER PPI_Handler
+    EXHANDLER MWU_Handler
+    EXHANDLER PWM1_Handler
+    EXHANDLER PWM2_Handler
+    EXHANDLER SPIM2_SPIS2_Handler
+    EXHANDLER RTC2_Handler
+    EXHANDLER I2S_Handler
+    EXHANDLER FPU_Handler
+    EXHANDLER USBD_Handler
+    EXHANDLER UARTE1_Handler
+    EXHANDLER QSPI_Handler
+    EXHANDLER PWM3_Handler
+    EXHANDLER SPIM3_Handler
+
+    .end
@@ -0,0 +1,143 @@
+@   file:        vectors.s
+@   description: vector table and default handlers for the QEMU mps2-an386
+@                machine (Cortex-M4 with the CMSDK peripherals of the Arm
+@                MPS2 AN386 FPGA image)
+@   target:      QEMU mps2-an386
+
+    .syntax unified
+    .arch armv7e-m
+    .cpu cortex-m4
+    .fpu fpv4-sp-d16
+    .thumb
+
+    .section .vector_table
+    .global __vector_table
+__vector_table:
+    .long __kernel_main_stack_base             @ base address of kernel main stack
+
+@
+@  Armv7-M system faults and exceptions
+@
+    .long Reset_Handler
+    .long NMI_Handler
+    .long HardFault_Handler
+    .long MemFault_Handler
+    .long BusFault_Handler
+    .long UsageFault_Handler
+    .long 0
+    .long 0
+    .long 0
+    .long 0
+    .long SVC_Handler
+    .long DebugMon_Handler
+    .long 0
+    .long PendSV_Handler
+    .long SysTick_Handler
+
+@
+@  mps2-an386 external interrupts (the kernel enables none of them on QEMU)
+@
+    .long CMSDK_UARTRX0_Handler
+    .long CMSDK_UARTTX0_Handler
+    .long CMSDK_UARTRX1_Handler
+    .long CMSDK_UARTTX1_Handler
+    .long CMSDK_UARTRX2_Handler
+    .long CMSDK_UARTTX2_Handler
+    .long CMSDK_GPIO0ALL_Handler
+    .long CMSDK_GPIO1ALL_Handler
+    .long CMSDK_TIMER0_Handler
+    .long CMSDK_TIMER1_Handler
+    .long CMSDK_DUALTIMER_Handler
+    .long CMSDK_SPI_Handler
+    .long CMSDK_UARTOVF_Handler
+    .long CMSDK_ETHERNET_Handler
+    .long CMSDK_I2S_Handler
+    .long CMSDK_TOUCHSCREEN_Handler
+    .long CMSDK_GPIO0_0_Handler
+    .long CMSDK_GPIO0_1_Handler
+    .long CMSDK_GPIO0_2_Handler
+    .long CMSDK_GPIO0_3_Handler
+    .long CMSDK_GPIO0_4_Handler
+    .long CMSDK_GPIO0_5_Handler
+    .long CMSDK_GPIO0_6_Handler
+    .long CMSDK_GPIO0_7_Handler
+    .long CMSDK_GPIO0_8_Handler
+    .long CMSDK_GPIO0_9_Handler
+    .long CMSDK_GPIO0_10_Handler
+    .long CMSDK_GPIO0_11_Handler
+    .long CMSDK_GPIO0_12_Handler
+    .long CMSDK_GPIO0_13_Handler
+    .long CMSDK_GPIO0_14_Handler
+    .long CMSDK_GPIO0_15_Handler
+
+    .size __vector_table, . - __vector_table
+
+
+@   function:    Default_Handler
+@   description: ends the QEMU process through semihosting (SYS_EXIT with
+@                ADP_Stopped_RunTimeErrorUnknown) so that a fault in a
+@                headless run fails instead of hanging at a breakpoint
+    .text
+    .thumb_func
+    .global Default_Handler
+    .type Default_Handler, %function
+Default_Handler:
+    mov r0, #0x18
+    ldr r1, =0x20023
+    bkpt 0xab
+    b .
+    .pool
+    .size Default_Handler, . - Default_Handler
+
+    .macro EXHANDLER handler
+    .weak \handler
+    .set \handler, Default_Handler
+    .endm
+
+@
+@  default definitions for system faults and exceptions
+@
+    EXHANDLER NMI_Handler
+    EXHANDLER HardFault_Handler
+    EXHANDLER BusFault_Handler
+    EXHANDLER UsageFault_Handler
+    EXHANDLER DebugMon_Handler
+    EXHANDLER SysTick_Handler
+
+@
+@  default definitions for external interrupts
+@
+    EXHANDLER CMSDK_UARTRX0_Handler
+    EXHANDLER CMSDK_UARTTX0_Handler
+    EXHANDLER CMSDK_UARTRX1_Handler
+    EXHANDLER CMSDK_UARTTX1_Handler
+    EXHANDLER CMSDK_UARTRX2_Handler
+    EXHANDLER CMSDK_UARTTX2_Handler
+    EXHANDLER CMSDK_GPIO0ALL_Handler
+    EXHANDLER CMSDK_GPIO1ALL_Handler
+    EXHANDLER CMSDK_TIMER0_Handler
+    EXHANDLER CMSDK_TIMER1_Handler
+    EXHANDLER CMSDK_DUALTIMER_Handler
+    EXHANDLER CMSDK_SPI_Handler
+    EXHANDLER CMSDK_UARTOVF_Handler
+    EXHANDLER CMSDK_ETHERNET_Handler
+    EXHANDLER CMSDK_I2S_Handler
+    EXHANDLER CMSDK_TOUCHSCREEN_Handler
+    EXHANDLER CMSDK_GPIO0_0_Handler
+    EXHANDLER CMSDK_GPIO0_1_Handler
+    EXHANDLER CMSDK_GPIO0_2_Handler
+    EXHANDLER CMSDK_GPIO0_3_Handler
+    EXHANDLER CMSDK_GPIO0_4_Handler
+    EXHANDLER CMSDK_GPIO0_5_Handler
+    EXHANDLER CMSDK_GPIO0_6_Handler
+    EXHANDLER CMSDK_GPIO0_7_Handler
+    EXHANDLER CMSDK_GPIO0_8_Handler
+    EXHANDLER CMSDK_GPIO0_9_Handler
+    EXHANDLER CMSDK_GPIO0_10_Handler
+    EXHANDLER CMSDK_GPIO0_11_Handler
+    EXHANDLER CMSDK_GPIO0_12_Handler
+    EXHANDLER CMSDK_GPIO0_13_Handler
+    EXHANDLER CMSDK_GPIO0_14_Handler
+    EXHANDLER CMSDK_GPIO0_15_Handler
+
+    .end
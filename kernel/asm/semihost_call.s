@@ -0,0 +1,18 @@
+@   file:        semihost_call.s
+@   description: Issues an Arm semihosting request (operation in r0 and the
+@                address of its parameter block in r1, result returned in r0).
+@   target:      QEMU mps2-an386 (assembled for every target but only called on QEMU)
+
+.syntax unified
+.thumb
+.text
+
+@ QEMU services the request when it is started with semihosting enabled (a board without a debugger would halt on the bkpt instead)
+.thumb_func
+.global semihost_call
+.type semihost_call, %function
+semihost_call:
+    bkpt 0xab
+    bx lr
+.size semihost_call, . - semihost_call
+.end
@@ -35,6 +35,27 @@
 /// MMIO address for the CPACR (used to enable floating point computation)
 #define CPACR *((volatile uint32_t *) 0xe000ed88)
 
+/// MMIO address for the FPCCR (used to enable automatic and lazy stacking of the FP context on exception entry)
+#define FPCCR *((volatile uint32_t *) 0xe000ef34)
+
+/// MMIO address for the DEMCR (used to power the DWT unit through the TRCENA bit)
+#define DEMCR *((volatile uint32_t *) 0xe000edfc)
+
+/// MMIO address for the DWT control register (used to enable the cycle counter)
+#define DWT_CTRL *((volatile uint32_t *) 0xe0001000)
+
+/// MMIO address for the DWT cycle counter (counts processor cycles once enabled and wraps at 32 bits)
+#define DWT_CYCCNT *((volatile uint32_t *) 0xe0001004)
+
+/// MMIO address for the control register of CMSDK timer 0 on QEMU mps2-an386 (QEMU has no DWT so this timer stands in for the cycle counter)
+#define QEMU_CYCLE_TIMER_CTRL *((volatile uint32_t *) 0x40000000)
+
+/// MMIO address for the current value of CMSDK timer 0 (counts down at the 25 MHz system clock)
+#define QEMU_CYCLE_TIMER_VALUE *((volatile uint32_t *) 0x40000004)
+
+/// MMIO address for the reload value of CMSDK timer 0
+#define QEMU_CYCLE_TIMER_RELOAD *((volatile uint32_t *) 0x40000008)
+
 /// One byte signed
 typedef char int8_t;
 
@@ -59,6 +80,12 @@ typedef long long int64_t;
 /// Four bytes unsigned
 typedef unsigned long long uint64_t;
 
+// A host build (make host) replaces the intrinsics that execute Arm instructions with the simulated ones in host/include/host_intrinsics.h
+// The intrinsics that only touch MMIO registers are shared since the host maps a register file at the same addresses
+#ifdef HOST_BUILD
+#include "host_intrinsics.h"
+#else
+
 /// Direct conversion between C instruction and bkpt Arm assembly instruction at call point
 intrinsic void breakpoint() { asm volatile("bkpt"); }
 
@@ -86,6 +113,36 @@ intrinsic void wait_for_event() { asm volatile("wfe"); }
 /// Direct conversion between C instruction and sev (signal event) Arm assembly instruction at call point
 intrinsic void send_event() { asm volatile("sev"); }
 
+/// Direct conversion between C instruction and clz Arm assembly instruction at call point (returns 32 when `n` is 0)
+intrinsic uint32_t count_leading_zeros(uint32_t n) {
+    uint32_t zeros;
+    asm volatile("clz %0, %1" : "=r" (zeros) : "r" (n));
+    return zeros;
+}
+
+/// Returns the current value of the active stack pointer
+intrinsic uint32_t stack_pointer() {
+    uint32_t sp;
+    asm volatile("mov %0, sp" : "=r" (sp));
+    return sp;
+}
+
+/// Returns the current value of the process stack pointer (pointing at the frame stacked by hardware while a handler runs on behalf of a thread)
+intrinsic uint32_t process_stack_pointer() {
+    uint32_t psp;
+    asm volatile("mrs %0, psp" : "=r" (psp));
+    return psp;
+}
+
+/// Returns the number of the exception being handled (from IPSR - 0 in thread mode, 11 for SVC, 14 for PendSV, 15 for SysTick, and 16 plus the IRQ number for interrupts)
+intrinsic uint32_t active_exception() {
+    uint32_t ipsr;
+    asm volatile("mrs %0, ipsr" : "=r" (ipsr));
+    return ipsr & 0x1ff;
+}
+
+#endif
+
 /// Sets the PendSV bit in the ICSR
 intrinsic void set_pendsv() { ICSR |= (1 << 28); }
 
@@ -110,8 +167,31 @@ intrinsic uint32_t ceil_log2(uint32_t n) {
     return cl2n;
 }
 
-/// Enables the floating point unit to handle float types 
+#ifdef TARGET_QEMU
+/// Starts CMSDK timer 0 counting down from its maximum (QEMU does not model the DWT - deterministic when QEMU runs with -icount)
+intrinsic void enable_cycle_counter() {
+    QEMU_CYCLE_TIMER_RELOAD = 0xFFFFFFFF;
+    QEMU_CYCLE_TIMER_VALUE = 0xFFFFFFFF;
+    QEMU_CYCLE_TIMER_CTRL = (1 << 0);
+}
+
+/// Returns the number of system clock ticks counted by CMSDK timer 0 (counts up from 0 like the DWT cycle counter so differences are wrap-safe)
+intrinsic uint32_t cycle_count() { return ~QEMU_CYCLE_TIMER_VALUE; }
+#else
+/// Enables the DWT cycle counter (starting from 0)
+intrinsic void enable_cycle_counter() {
+    DEMCR |= (1 << 24);
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= (1 << 0);
+}
+
+/// Returns the current value of the DWT cycle counter (differences between two samples are wrap-safe)
+intrinsic uint32_t cycle_count() { return DWT_CYCCNT; }
+#endif
+
+/// Enables the floating point unit to handle float types (with automatic and lazy stacking so that exceptions only save FP registers once they use the FPU themselves)
 intrinsic void enable_fpu() {
+    FPCCR |= (1u << 31) | (1 << 30);
     CPACR |= (0xf << 20);
     data_sync_barrier();
     inst_sync_barrier();
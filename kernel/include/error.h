@@ -70,4 +70,34 @@
 /// Returned if the stepper motor is attempting to be used without initialization
 #define STEPPER_MOTOR_UNINITIALIZED -18
 
+/// Returned if the task set can miss a deadline once the blocking from lock priority ceilings is accounted for
+#define MULTITASK_START_UNSCHEDULABLE -19
+
+/// Returned if no active thread has the requested ID
+#define THREAD_ID_NOT_FOUND -20
+
+/// Returned if the stacks of a thread do not fit in the remaining thread stack space
+#define THREAD_DEFINE_NO_STACK_SPACE -21
+
+/// Returned if a deadline miss policy is not one of the supported policies
+#define THREAD_INVALID_DEADLINE_POLICY -22
+
+/// Returned if a semaphore, event group, or condition variable handle was not returned by its init syscall
+#define SYNC_INVALID_OBJECT -23
+
+/// Returned if a thread tries to block on a semaphore, event group, or condition variable while it holds a lock (it could block higher priority threads for an unbounded time)
+#define SYNC_WAIT_HOLDING_LOCK -24
+
+/// Returned if a thread waits on a condition variable without holding the lock it passed (or while holding other locks too)
+#define COND_WAIT_LOCK_NOT_HELD -25
+
+/// Returned if the main or idle thread would have to block on a semaphore, event group, or condition variable (they are what runs when no user thread can)
+#define SYNC_WAIT_CANNOT_BLOCK -26
+
+/// Returned if ring_wait is asked to wait for something other than data or space
+#define RING_INVALID_WAIT -27
+
+/// Returned if a thread calls a blocking driver syscall while another thread is still waiting for the operation it started
+#define DEVICE_BUSY -28
+
 #endif
\ No newline at end of file
@@ -85,5 +85,10 @@ typedef enum {
 /// Interrupt request number in vector table for GPIOTE (will be pended from GPIOTE when GPIO pin state changes as desired)
 #define GPIOTE_IRQ 6
 
+/**
+ * Handles an edge on the ultrasonic echo pin if its event is set (called by GPIOTE_Handler and polled by ultrasonic_range for a caller that cannot block).
+ */
+void gpiote_ultrasonic_event();
+
 #endif
 
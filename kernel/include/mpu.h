@@ -45,6 +45,8 @@ typedef enum {
 /** @brief MPU RBAR register (~ARM p.639) */
 //@{
 #define MPU_RBAR_ADDR_MASK  (0xffffffe0)    /*<! base address (32B aligned) to apply to selected region */
+#define MPU_RBAR_VALID_POS  (4)             /*<! bit offset of flag to select the region from the REGION field (updating RNR) */
+#define MPU_RBAR_REGION_POS (0)             /*<! bit offset of region number field (only used when VALID is set) */
 //@}
 
 /** @brief MPU RASR register (~ARM p.640) */
@@ -54,6 +56,7 @@ typedef enum {
 #define MPU_RASR_AP_MAX     (7)             /*<! max value of access and privilege field (~ARM, Table B3-15) */
 #define MPU_RASR_AP_RO      (2)             /*<! unprivileged read-only --> AP = 0b010 */
 #define MPU_RASR_AP_RW      (3)             /*<! unprivileged read/write --> AP = 0b011 */
+#define MPU_RASR_SRD_POS    (8)             /*<! bit offset of subregion disable field in RASR (bit n disables the nth eighth of the region) */
 #define MPU_RASR_SIZE_POS   (1)             /*<! bit offset of region size field in RASR */
 #define MPU_RASR_SIZE_MIN   (4)             /*<! min value in region size field (size is 2^{1+value}) */
 #define MPU_RASR_SIZE_MAX   (31)            /*<! max value in region size field (size is 2^{1+value}) */
@@ -69,6 +72,52 @@ typedef enum {
 #define CFSR_MMFARVALID_POS (7)             /*<! bit offset of MMFAR validity flag */
 //@}
 
+/**
+ * Precomputed register values for a single memory protection region.
+ * The RBAR value has the VALID bit set so writing it selects the region on its own (no RNR write needed).
+ */
+typedef struct {
+    uint32_t rbar; ///< Value for MPU_RBAR (base address, VALID, and region number)
+    uint32_t rasr; ///< Value for MPU_RASR (attributes, size, and enable)
+} mpu_region_t;
+
+/** @brief Region number used for the user stack of the running thread */
+#define MPU_THREAD_STACK_REGION (6)
+
+/** @brief Number of equally sized subregions in every region (each can be disabled through the SRD field) */
+#define MPU_SUBREGIONS (8)
+
+/** @brief Smallest region size (log2) that supports subregions (regions of 128 bytes or less ignore the SRD field) */
+#define MPU_SUBREGION_MIN_SIZE_LOG2 (8)
+
+/**
+ * Returns the log2 of the smallest region (that supports subregions) whose size is at least `size` bytes.
+ */
+intrinsic uint32_t mpu_region_log2_for(uint32_t size) {
+    return MAX(ceil_log2(size), MPU_SUBREGION_MIN_SIZE_LOG2);
+}
+
+/**
+ * Loads the precomputed user stack `region` of a thread (two stores with a single barrier since the RBAR value selects the region itself).
+ */
+intrinsic void mpu_stack_region_load(const mpu_region_t* region) {
+    MPU_RBAR = region->rbar;
+    MPU_RASR = region->rasr;
+    data_sync_barrier();
+}
+
+/**
+ * Encodes a memory protection region (`region` starting at `base_addr` with size 2^`size_log2`) into `descriptor` without touching the MPU.
+ * Returns -1 if the parameters cannot be encoded and 0 otherwise.
+ */
+int mpu_region_encode(mpu_region_t* descriptor, uint32_t region, void *base_addr, uint32_t size_log2, uint8_t execute, uint8_t write);
+
+/**
+ * Encodes a memory protection region covering exactly `size` bytes starting at `limit` into `descriptor` (using the smallest enclosing aligned region with the subregions outside of the range disabled).
+ * Returns -1 if the range does not line up with the subregions of a single region and 0 otherwise.
+ */
+int mpu_subregion_encode(mpu_region_t* descriptor, uint32_t region, void *limit, uint32_t size, uint8_t execute, uint8_t write);
+
 /**
  * Enables the memory protection unit unconditionally (always want to protect kernel).
  */
@@ -89,14 +138,4 @@ void mpu_thread_region_enable(void *base_addr, uint32_t size);
  */
 void mpu_thread_region_disable();
 
-/**
- * Enables a memory protection region for a kernel stack (specified as starting at `base_addr` with allocated `size`).
- */
-void mpu_kernel_region_enable(void *base_addr, uint32_t size);
-
-/**
- * Disables the enabled kernel stack protection region.
- */
-void mpu_kernel_region_disable();
-
 #endif
\ No newline at end of file
@@ -9,7 +9,55 @@
 #include "thread.h"
 #include "mpu.h"
 #include "mutex.h"
+#include "syscall.h"
+#include "trace.h"
 
+/** 
+ * Specifies how the scheduler keeps track of time once multitask_start is called.
+ */
+typedef enum {
+    PERIODIC_TICK, ///< SysTick interrupts the running thread once every timeslot
+    TICKLESS ///< A one-shot compare on TIMER2 only interrupts at the next release or budget exhaustion (elapsed timeslots are accounted for in bulk)
+} tick_mode;
+
+/** 
+ * Specifies which policy the scheduler uses to pick between ready threads (and the admission test used when defining threads).
+ */
+typedef enum {
+    RATE_MONOTONIC, ///< Fixed priorities by period with the priority ceiling protocol for locks (admission by exact response time analysis including blocking)
+    EARLIEST_DEADLINE_FIRST ///< Earliest absolute deadline first with the stack resource policy for locks (admission up to a utilization of 1)
+} sched_policy;
+
+/**
+ * Cycle counters returned by the thread cycles syscall (all counted since the last multitask_start except for the thread, which counts since it was defined).
+ */
+typedef struct {
+    uint64_t thread; ///< Cycles that the requested thread was running (including the syscalls it made)
+    uint64_t kernel; ///< Cycles spent in the scheduler (PendSV) and in interrupt handlers
+    uint64_t idle; ///< Cycles that the idle thread was running
+} cycle_counters_t;
+
+/**
+ * Stack high-water marks returned by the thread stack usage syscall (in bytes).
+ */
+typedef struct {
+    uint32_t process_used; ///< Deepest use of the process stack of the requested thread since it was defined
+    uint32_t process_size; ///< Size of the process stack of the requested thread
+    uint32_t kernel_used; ///< Deepest use of the kernel stack (shared by every thread) since multitask_request
+    uint32_t kernel_size; ///< Size of the kernel stack
+} stack_usage_t;
+
+/**
+ * Deadline counters returned by the thread deadline stats syscall (all counted since the thread was defined).
+ */
+typedef struct {
+    uint32_t deadline_misses; ///< Releases at which the previous job of the thread had not completed yet
+    uint32_t overruns; ///< Times the thread used up its budget without completing its job
+    uint32_t max_lateness; ///< Largest number of timeslots that a job completed after its deadline
+} deadline_stats_t;
+
+/// Event bit set by the kernel for a server waiting on it whenever input is waiting in the RTT down buffer (checked at every release of the server - the other bits are free for server_notify)
+#define SERVER_EVENT_STDIN (0x80000000)
 
 /// Array of TCB's of threads specificed by user
 extern tcb_t user_threads[MAX_NUM_THREADS+2];
@@ -23,12 +71,21 @@ extern uint8_t num_active_threads;
 /// Active index of the thread in user_thread
 extern uint8_t active_thread_index;
 
+/// Lowest address that the switch frame of the active thread may reach (checked by PendSV_Handler before it pushes the frame)
+extern void* switch_frame_limit;
+
 /// The current timeslot that the scheduler is using since program start
 extern uint32_t global_timeslot_counter;
 
 /// Used for determining the source of the schedulign decision (asserted when scheduling is performed from systick timer)
 extern uint8_t preemption_flag;
 
+/// Indices in user_threads of the threads waiting for their next release (binary min-heap on next_release)
+extern uint8_t release_heap[MAX_NUM_THREADS];
+
+/// Number of threads in the release heap
+extern uint8_t release_heap_size;
+
 /// Maintain the utilization of the currently active task set (used in admission control)
 extern float total_utilization; 
 
@@ -41,32 +98,158 @@ extern uint8_t num_user_locks;
 /// Number of locks already defined by the user application (should not exceed num_user_locks)
 extern uint8_t num_defined_locks;
 
+/// Lock words shared with user space (defined by the user library so that the threads can write them)
+extern volatile lock_shared_t lock_shared;
+
+/// Bits of lock_shared.held as of the last time the kernel accounted for them
+extern uint32_t lock_held_seen;
+
 /// Current priority ceiling for user tasks (i.e. the maximum priority ceiling for all currently held locks)
 extern uint32_t global_priority_ceiling;
 
 /// Address of the lock that currently is dictating the global_priority_ceiling (i.e. the lock who set the current global priority ceiling equal to its priority ceiling)
 extern mutex_t* highest_priority_lock;
 
+/// Index in user_locks of the lock that was locked last and is still locked (LOCK_STACK_END if none)
+extern uint8_t ceiling_stack_top;
+
+/// Bitmap of ready threads indexed by dynamic priority (priority p occupies bit 31-(p%32) of word p/32)
+extern uint32_t ready_bitmap[READY_BITMAP_WORDS];
+
+/// One bit per word of ready_bitmap that has a ready thread (word w occupies bit 31-w so that two CLZs find the highest priority ready thread)
+extern uint32_t ready_bitmap_summary;
+
+/// Index in user_threads of the ready thread with the earliest absolute deadline (head of the EDF ready queue)
+extern uint8_t edf_ready_head;
+
+/// Scheduling policy selected in multitask_request
+extern sched_policy scheduling_policy;
+
+/// Number of processor cycles spent in the scheduler and in interrupt handlers since multitask_start
+extern uint64_t kernel_cycles;
+
+/// Value of the cycle counter when cycles were last charged to the running thread
+extern uint32_t cycle_last_sample;
+
+/// Processor cycles that PendSV_C_Handler took for the last switch to a different thread
+extern uint32_t switch_cycles_last;
+
+/**
+ * Called first thing in an interrupt handler: records the start of the handler in the trace and returns the cycle count to pass to isr_cycles_charge on exit.
+ */
+intrinsic uint32_t isr_enter() {
+    uint32_t start = cycle_count();
+    trace_record(TRACE_IRQ_ENTER, active_thread_index, active_exception());
+    return start;
+}
+
+/**
+ * Charges the cycles since `start` (sampled on entry to an interrupt handler by isr_enter) to the kernel instead of the interrupted thread and records the end of the handler in the trace.
+ * Moving the last sample forward by the same amount removes them from what the running thread is charged at the next context switch.
+ */
+intrinsic void isr_cycles_charge(uint32_t start) {
+    uint32_t elapsed = cycle_count() - start;
+    kernel_cycles += elapsed;
+    cycle_last_sample += elapsed;
+    trace_record(TRACE_IRQ_EXIT, active_thread_index, active_exception());
+}
+
 /**
  * Returns the next thread id that will be scheduled (from currently active threads) using a rate-monotonic scheduler
  */
 uint32_t schedule_rms();
 
 /**
- * Syscall requesting the paritioning of kernel and user stack space for multiple threads (`num_threads` pieces each with both process and main stack size of `stack_bytes`) and specifies an optional `idle_function` for when no other tasks are schedulable
- * Also specifies the number of locks that have be used by the user application.
+ * Returns the next thread id that will be scheduled (from currently active threads) using an earliest deadline first scheduler with the stack resource policy
+ */
+uint32_t schedule_edf();
+
+/**
+ * Accounts for one elapsed scheduling period (charging the running thread and releasing any threads whose period starts now).
+ * Returns a nonzero value only if a new scheduling decision is needed (i.e. PendSV should be pended).
+ */
+uint32_t scheduler_tick();
+
+/**
+ * Accounts for `timeslots` elapsed scheduling periods at once (exactly as the same number of calls to scheduler_tick would).
+ * Returns a nonzero value only if a new scheduling decision is needed (i.e. PendSV should be pended).
+ */
+uint32_t scheduler_advance(uint32_t timeslots);
+
+/**
+ * Called from the TIMER2 handler in tickless mode once the programmed scheduling event is reached (accounts for the elapsed timeslots and programs the next event).
+ */
+void tickless_event();
+
+/**
+ * Returns 1 if `released` should take the processor from `running` right away (used when a thread becomes ready outside of a scheduling decision)
+ */
+uint32_t release_preempts(tcb_t* released, tcb_t* running);
+
+/**
+ * Moves `thread` into `state` while keeping the ready bitmap consistent (all state changes of user threads should go through this function)
+ */
+void thread_set_state(tcb_t* thread, thread_state state);
+
+/**
+ * Changes the dynamic priority of `thread` to `priority` (used for priority inheritance) while keeping the ready bitmap consistent
+ */
+void thread_set_dynamic_priority(tcb_t* thread, uint32_t priority);
+
+/**
+ * Returns the frame that hardware stacked for the thread at `index` on its last exception entry (where a blocked syscall leaves its return value for the thread)
+ */
+stack_frame_t* thread_stack_frame(uint8_t index);
+
+/**
+ * Inserts the thread at `index` into the wait queue starting at `head` (ordered by dynamic priority with equal priorities in arrival order)
+ */
+void wait_queue_insert(uint8_t* head, uint8_t index);
+
+/**
+ * Returns the bit of the lock `m` in the lock words shared with user space
+ */
+uint32_t lock_bit(mutex_t* m);
+
+/**
+ * Syscall requesting user stack space for multiple threads (up to `num_threads` threads with a default stack size of `stack_bytes` - every thread shares the kernel stack) and specifies an optional `idle_function` for when no other tasks are schedulable
+ * Also specifies the number of locks that have be used by the user application and the scheduling `policy` used for the threads defined afterwards.
  */
-int syscall_multitask_request(uint32_t num_threads, uint32_t stack_bytes, void* idle_function, mpu_mode mpu_protect, uint32_t num_locks);
+int syscall_multitask_request(uint32_t num_threads, uint32_t stack_bytes, void* idle_function, mpu_mode mpu_protect, uint32_t num_locks, sched_policy policy);
 
 /**
  * Syscall spawning a thread that asynchronously executes the given `fn` with an optional `arg` and a given `id` (id must be unique for thread to spawn) along with periodic behavior given by worst-case execution time `c` and period `t`
+ * The thread gets a process stack of `stack_bytes` (zero selects the stack size given to multitask_request).
+ */
+int syscall_thread_define(uint32_t id, void *fn, void *arg, uint32_t c, uint32_t t, uint32_t stack_bytes);
+
+/**
+ * Syscall spawning an aperiodic (deferrable) server that executes `fn` with the same arguements as syscall_thread_define
+ * The server only uses its budget `c` (replenished every period `t`) while it has work signalled through events (see syscall_server_wait).
+ */
+int syscall_server_define(uint32_t id, void *fn, void *arg, uint32_t c, uint32_t t, uint32_t stack_bytes);
+
+/**
+ * Syscall for a server to wait until any of the event bits in `mask` is signalled (returns and clears the signalled bits of the mask)
  */
-int syscall_thread_define(uint32_t id, void *fn, void *arg, uint32_t c, uint32_t t);
+uint32_t syscall_server_wait(uint32_t mask);
+
+/**
+ * Syscall for signalling the event bits `events` to the server with the given `id`
+ */
+int syscall_server_notify(uint32_t id, uint32_t events);
+
+/**
+ * Signals the event bits `events` to the server at `index` in user_threads (waking it if it waits on any of them) without pending a scheduling decision.
+ * Returns 1 if the woken server should preempt the running thread and 0 otherwise (safe to call from interrupt handlers).
+ */
+uint32_t server_signal(uint8_t index, uint32_t events);
 
 /**
  * Syscall specifying the frequency of the scheduling call (with a call with zero being interpretted as a non-preemptive scheduler - i.e. the scheduler will not run unless a task explicitly yields)
+ * The `mode` selects whether the scheduler is driven by a periodic tick or only interrupts at scheduling events (tickless).
  */
-int syscall_multitask_start(uint32_t freq);
+int syscall_multitask_start(uint32_t freq, tick_mode mode);
 
 /**
  * Syscall for returning the thread id of the currently running thread
@@ -98,10 +281,72 @@ uint32_t syscall_thread_time();
  */
 uint32_t syscall_thread_priority();
 
+/**
+ * Syscall for returning the worst case response time of the thread with the given `id` (computed by admission control)
+ */
+int syscall_thread_response_time(uint32_t id);
+
+/**
+ * Syscall for filling `counters` with the cycles consumed by the thread with the given `id`, the kernel, and the idle thread
+ */
+int syscall_thread_cycles(uint32_t id, cycle_counters_t* counters);
+
+/**
+ * Syscall for returning the current value of the cycle counter
+ */
+uint32_t syscall_cycle_count();
+
+/**
+ * Syscall for returning the cycles that the last context switch between two different threads took
+ */
+uint32_t syscall_switch_cycles();
+
+/**
+ * Syscall for filling `stats` with the deadline misses, overruns, and maximum lateness of the thread with the given `id`
+ */
+int syscall_thread_deadline_stats(uint32_t id, deadline_stats_t* stats);
+
+/**
+ * Syscall for choosing what the scheduler does when the thread with the given `id` misses a deadline
+ */
+int syscall_thread_deadline_policy(uint32_t id, deadline_policy policy);
+
+/**
+ * Syscall for filling `usage` with the stack high-water marks of the thread with the given `id` (the idle thread has the id 0xFFFFFFFF) and of the shared kernel stack
+ */
+int syscall_thread_stack_usage(uint32_t id, stack_usage_t* usage);
+
+/**
+ * Prints the stack high-water marks of every defined thread and of the shared kernel stack (used when reporting faults)
+ */
+void thread_stack_usage_dump();
+
+/**
+ * Returns 1 if the active thread holds any lock and 0 otherwise
+ */
+uint32_t active_thread_holds_locks();
+
+/**
+ * Accounts the locks that the running thread took or released in user space since the last kernel entry.
+ * Returns 1 if a change did not check out against the kernel's view of the locks (it is undone and the caller ends the running thread).
+ */
+uint32_t lock_fast_sync();
+
+/**
+ * Works out which lock sets the global priority ceiling at every level of the ceiling stack again (after a held lock was bound to a different ceiling).
+ */
+void lock_stack_relink();
+
+/**
+ * Grants the lock `m` to the thread at `index` under the priority ceiling protocol or blocks the thread behind the lock that stands in its way (interrupts must be disabled).
+ * Returns 1 if the thread got the lock and 0 if it was blocked.
+ */
+uint32_t lock_request(uint8_t index, mutex_t* m);
+
 /**
  * Syscall for initializing a lock (kernel must already have defined empty structs for mutexes by the time this function is called from user space) with an additional parameter to specify the highest locker ID `prio`
  */
-mutex_t* syscall_lock_init(uint32_t prio);
+mutex_t* syscall_lock_init(uint32_t prio, uint32_t critical_section);
 
 /**
  * Syscall for locking a lock with the opaque address `m` (will be of a different type at user level but maps to a mutex_t struct at kernel level)
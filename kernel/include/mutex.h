@@ -8,6 +8,9 @@
 #include "arm.h"
 #include "thread.h"
 
+// A host build takes the exclusive load and store from host/include/host_intrinsics.h (included by arm.h)
+#ifndef HOST_BUILD
+
 /// C wrapper function for exclusive store (does not perform store if address has been accessed since load - returns a 1 if unsuccessful)
 intrinsic uint32_t store_exclusive(uint32_t *addr, uint32_t value) {
     uint32_t status;
@@ -22,6 +25,8 @@ intrinsic uint32_t load_exclusive(uint32_t *addr) {
     return value;
 }
 
+#endif
+
 /**
  * Contains fields for semaphores and lock metadata (such as time locked and last locker).
  * Address to mutex_t struct will also be address to semaphore struct field.
@@ -29,12 +34,25 @@ intrinsic uint32_t load_exclusive(uint32_t *addr) {
 typedef struct {
     uint32_t s; ///< Semaphore value (1 means unlocked and 0 means locked)
     tcb_t* current_locker; ///< Specifies the address of the TCB that current holds this lock
-    tcb_t* blocked_threads[MAX_NUM_THREADS]; ///< Specifies all of the threads that are currently block waiting for this mutex to unlock
-    uint32_t num_blocked_threads; ///< Specifies the length of the blocked_threads field (i.e. the number of waiting threads)
     uint32_t priority_ceiling; ///< Priority of the task specified as being the highest locker of this lock
     uint32_t highest_locker_id; ///< Priority of the thread whose static priority gets assigned to the priority ceiling mentioned above
+    uint32_t critical_section; ///< Longest time in timeslots that any thread holds this lock as given to lock_init (0 if unknown - the budget of the holder is used as the bound instead)
+    uint8_t wait_head; ///< Index in user_threads of the highest priority thread blocked on this mutex (the wait queue is linked through wait_next of the TCBs - WAIT_QUEUE_END if empty)
+    uint8_t stack_below; ///< Index in user_locks of the lock under this one on the ceiling stack while it is locked (LOCK_STACK_END at the bottom)
+    uint8_t ceiling_lock; ///< Index in user_locks of the lock that sets the global priority ceiling while this one is on top of the ceiling stack (this lock or the ceiling lock of the one under it)
+    uint8_t held_below; ///< Index in user_locks of the lock that the holder took before this one and still holds (LOCK_STACK_END if none)
 } mutex_t;
 
+/**
+ * Lock words shared with user space (bit i stands for the lock at index i of user_locks) so that an uncontended lock or unlock does not have to enter the kernel.
+ * A thread may only set a bit (with an exclusive store) while no bit of `held` is set, and only clear a bit that it set while the same bit of `contended` is clear. Every other case goes through syscall_lock or syscall_unlock.
+ * Exception entry and return clear the exclusive monitor, so a thread that is preempted between its exclusive load and store retries instead of overwriting what the kernel wrote in between.
+ */
+typedef struct {
+    uint32_t held; ///< Bit per lock that is locked
+    uint32_t contended; ///< Bit per lock that has threads blocked on it or held back by its ceiling under EDF (its holder must unlock it through the kernel to wake them)
+} lock_shared_t;
+
 /**
  * Initializes a provided mutex_t struct and prepares it for locking/unlocking.
  */
@@ -0,0 +1,39 @@
+/** @file   notify.h
+ *  @brief  One-shot notifications that let a thread block in a driver syscall until an interrupt handler signals that the awaited event happened.
+**/
+
+#ifndef _NOTIFY_H_
+#define _NOTIFY_H_
+
+#include "arm.h"
+
+/// Marks a notification that no thread is blocked on
+#define NOTIFY_NO_WAITER (0xFF)
+
+/**
+ * Event that a single thread can wait on while interrupt handlers complete it.
+ */
+typedef struct {
+    volatile uint8_t pending; ///< Set by notify_signal once the event happened (consumed by notify_wait)
+    volatile uint8_t waiter; ///< Index in user_threads of the thread that waits on this notification from when it blocks until it consumes the signal (NOTIFY_NO_WAITER if none)
+    void (*poll)(); ///< Checks the peripheral events that signal this notification and handles them like their interrupt handlers would (spun on when the caller cannot block)
+} notify_t;
+
+/**
+ * Clears the notification `n` (dropping a stale signal) and records the `poll` function used in place of the interrupts for callers that cannot block.
+ */
+void notify_init(notify_t* n, void (*poll)());
+
+/**
+ * Consumes the signal of `n` from syscall context, blocking the calling thread if it has not arrived yet.
+ * Returns 1 once the event happened and 0 if the thread was blocked instead (the syscall then returns right away and is restarted once the thread is woken, so it must be safe to run again).
+ * Returns DEVICE_BUSY without touching `n` if another thread is waiting on it (the signal belongs to that thread).
+ */
+int notify_wait(notify_t* n);
+
+/**
+ * Signals `n` from an interrupt handler, making the blocked thread (if any) ready and pending a scheduling decision if it should run before the interrupted thread.
+ */
+void notify_signal(notify_t* n);
+
+#endif
@@ -10,4 +10,9 @@
  */
 #define NVIC_ISER0_ADDR 0xE000E100
 
+/** 
+ * Memory mapped address of NVIC_ISPR0 (writing a 1 at offset m pends interrupt m without the peripheral generating it).
+ */
+#define NVIC_ISPR0_ADDR 0xE000E200
+
 #endif
\ No newline at end of file
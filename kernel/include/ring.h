@@ -0,0 +1,67 @@
+/** @file   ring.h
+ *  @brief  Single producer single consumer rings of fixed size slots that user threads fill and drain in place without syscalls.
+**/
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include "arm.h"
+
+/// The maximum number of rings that the user application can define
+#define MAX_USER_RINGS (8)
+
+/// Option of ring_wait to wait until the ring has a committed slot (the consumer side)
+#define RING_WAIT_DATA (0x1)
+
+/// Option of ring_wait to wait until the ring has a free slot (the producer side)
+#define RING_WAIT_SPACE (0x2)
+
+/**
+ * Header of a ring in user memory (mirrored by `ring_t` in user/include/userutil.h), followed by its slots.
+ * The producer only writes `head` and the consumer only writes `tail`, so neither side needs a lock or a syscall to move a slot.
+ * The kernel only reads the indices to decide whether a waiter has to block (it keeps its own copy of the geometry so a corrupted header can never make it block or wake the wrong thread).
+ */
+typedef struct {
+    volatile uint32_t head; ///< Number of slots committed by the producer (free running - the next slot to reserve is head modulo num_slots)
+    volatile uint32_t tail; ///< Number of slots released by the consumer (free running - the next slot to peek is tail modulo num_slots)
+    volatile uint32_t waiting; ///< RING_WAIT_DATA and RING_WAIT_SPACE while a thread is blocked on that side (set and cleared by the kernel - a commit or release that sees the bit of the other side makes the notify syscall)
+    uint32_t slot_size; ///< Bytes per slot (a multiple of 4 so every slot is word aligned)
+    uint32_t num_slots; ///< Number of slots (a power of two)
+    uint32_t index; ///< Index of the kernel side of this ring in user_rings
+} ring_shared_t;
+
+/**
+ * Kernel side of a ring (the threads blocked on it and the geometry that the waits are checked against).
+ */
+typedef struct {
+    ring_shared_t* shared; ///< Header of the ring in user memory
+    uint32_t num_slots; ///< Number of slots (the copy that the kernel trusts)
+    uint8_t data_wait_head; ///< Index in user_threads of the highest priority thread waiting for a committed slot (linked through wait_next - WAIT_QUEUE_END if empty)
+    uint8_t space_wait_head; ///< Index in user_threads of the highest priority thread waiting for a free slot (linked through wait_next - WAIT_QUEUE_END if empty)
+} ring_t;
+
+/**
+ * Forgets every ring (called by multitask_request before the application defines its own - the memory of old rings stays in the heap).
+ */
+void ring_reset();
+
+/**
+ * Syscall for defining a ring of `num_slots` slots (a power of two) of `slot_size` bytes each (only from the main thread before multitask_start).
+ * The header and the slots are taken from the heap, which the MPU leaves readable and writable by every thread.
+ * Returns the address of the header in user memory or NULL if the geometry is invalid or no rings or heap are left.
+ */
+ring_shared_t* syscall_ring_init(uint32_t slot_size, uint32_t num_slots);
+
+/**
+ * Syscall for waiting until the ring `r` has a committed slot (RING_WAIT_DATA) or a free slot (RING_WAIT_SPACE) - blocks the calling thread until the other side notifies it.
+ * Returns 0 once the wait is satisfied (the caller checks the ring again) or a negative error code.
+ */
+int syscall_ring_wait(ring_shared_t* r, uint32_t what);
+
+/**
+ * Syscall for waking the threads blocked on the ring `r` whose wait is now satisfied (made by a commit or release that sees a waiting bit).
+ * Returns 0 on success or a negative error code.
+ */
+int syscall_ring_notify(ring_shared_t* r);
+
+#endif
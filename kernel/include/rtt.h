@@ -10,6 +10,9 @@
 /// Max number of characters that can be placed in the rtt_up buffer at a time (i.e. from controller to host)
 #define RTT_UP_BUFFER_SIZE      256
 
+/// Number of up buffers in the control block (the terminal and the scheduler trace)
+#define RTT_NUM_UP_BUFFERS      2
+
 /// Max number of characters that can be placed in the rtt_down buffer at a time (i.e. from host to controller)
 #define RTT_DOWN_BUFFER_SIZE    16
 
@@ -41,13 +44,14 @@ typedef struct {
 
 /**
  * Struct for specifying the layout of the allocated rtt_control_block created in linking.
- * Creates space for an up buffer, a down buffer, an identifier for finding the control block, and counts for the numbers of buffers (assumed to both be 1 in this implementation).
+ * Creates space for two up buffers (the terminal followed by the trace channel, as the protocol lays up buffers out back to back), a down buffer, an identifier for finding the control block, and counts for the numbers of buffers.
  */
 typedef struct {
     char id[16]; ///< Identifier to find the rtt_control_block
-    uint32_t num_up_buffers; ///< Default 1 (only 1 up buffer)
+    uint32_t num_up_buffers; ///< RTT_NUM_UP_BUFFERS (terminal and trace)
     uint32_t num_down_buffers; ///< Default 1 (only 1 down buffer)
-    rtt_up_buffer up_buffer; ///< Instance of a a single rtt_up_buffer struct
+    rtt_up_buffer up_buffer; ///< Up buffer 0 carrying terminal output
+    rtt_up_buffer trace_buffer; ///< Up buffer 1 carrying binary scheduler trace records
     rtt_down_buffer down_buffer; ///< Instance of a single rtt_down_buffer struct
 } rtt_control_block;
 
@@ -64,6 +68,12 @@ void rtt_init();
  */
 uint32_t rtt_write(const char *src, uint32_t len);
 
+/**
+ * Writes all `len` bytes from `src` into the trace up buffer or nothing at all if the host has not left enough room.
+ * Never blocks (so that tracing does not change the timing it is recording). Returns the number of bytes written (`len` or 0).
+ */
+uint32_t rtt_trace_write(const void *src, uint32_t len);
+
 /**
  * Stub for a read by the controller of information from the host/
  * The controller will read exactly `len` bytes from the `p` character array of the down buffer into the provided `dst` array.
@@ -0,0 +1,49 @@
+/** @file   semihost.h
+ *  @brief  Arm semihosting requests used in place of RTT and the reset button on the QEMU target (make TARGET=qemu).
+**/
+
+#ifndef _SEMIHOST_H_
+#define _SEMIHOST_H_
+
+#include "arm.h"
+
+/// SYS_OPEN operation (opens a file on the host - ":tt" is the console)
+#define SEMIHOST_SYS_OPEN (0x01)
+
+/// SYS_WRITE operation (writes a buffer to an open handle and returns the number of bytes that were not written)
+#define SEMIHOST_SYS_WRITE (0x05)
+
+/// SYS_READC operation (blocks until a character is read from the console)
+#define SEMIHOST_SYS_READC (0x07)
+
+/// SYS_EXIT_EXTENDED operation (ends the simulation with a reason and an exit status)
+#define SEMIHOST_SYS_EXIT_EXTENDED (0x20)
+
+/// SYS_OPEN mode for writing ("w")
+#define SEMIHOST_OPEN_MODE_WRITE (4)
+
+/// Exit reason for an application that ended by itself (the subcode is the exit status)
+#define SEMIHOST_ADP_STOPPED_APPLICATION_EXIT (0x20026)
+
+/**
+ * Issues the semihosting request `op` with the parameter block at `arg` (implemented in semihost_call.s).
+ */
+uint32_t semihost_call(uint32_t op, void* arg);
+
+/**
+ * Writes `len` bytes from `src` to the console of the host.
+ * Returns the number of bytes written.
+ */
+uint32_t semihost_write(const char* src, uint32_t len);
+
+/**
+ * Blocks until a character is read from the console of the host and returns it.
+ */
+char semihost_read_char();
+
+/**
+ * Ends the simulation with `status` as the exit status of the QEMU process.
+ */
+void semihost_exit(int status);
+
+#endif
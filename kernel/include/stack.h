@@ -0,0 +1,62 @@
+/** @file   stack.h
+ *  @brief  Allocator for packing variable sized thread stacks into the thread stack areas (so that each stack can still be covered by a single MPU region).
+**/
+
+#ifndef _STACK_H_
+#define _STACK_H_
+
+#include "arm.h"
+#include "thread.h"
+
+/// Smallest unit of a thread stack area tracked by the allocator (equal to the smallest MPU subregion)
+#define STACK_GRANULE_BYTES (32)
+
+/// Number of granules in a single thread stack area
+#define STACK_AREA_GRANULES (MAX_TOTAL_THREAD_STACK_SIZE / STACK_GRANULE_BYTES)
+
+/// Word written over unused stack space so that the deepest point ever reached can be found later (high-water mark)
+#define STACK_PAINT_PATTERN (0xDEADBEEF)
+
+/**
+ * Bookkeeping for one area of thread stacks.
+ */
+typedef struct {
+    uint32_t limit; ///< Lowest address of the area
+    uint32_t base; ///< Address directly above the highest address of the area
+    uint32_t used[STACK_AREA_GRANULES / 32]; ///< Bitmap of granules that belong to an allocated stack (granule g is bit g%32 of word g/32)
+} stack_area_t;
+
+/// Area holding the process (user) stacks of the threads (between the __thread_user_stacks linker symbols - sized by THREAD_STACKS in the Makefile)
+extern stack_area_t thread_user_stack_area;
+
+/**
+ * Marks the whole `area` (`size` bytes starting at `limit`) as free.
+ */
+void stack_area_init(stack_area_t* area, void* limit, uint32_t size);
+
+/**
+ * Rounds `size` up to the next size that a single MPU region can cover exactly with subregions (a multiple of one eighth of the next power of two).
+ */
+uint32_t stack_size_round(uint32_t size);
+
+/**
+ * Allocates a stack of `size` bytes (already rounded by stack_size_round) from `area` and returns its limit (lowest address) or NULL if it does not fit.
+ */
+void* stack_alloc(stack_area_t* area, uint32_t size);
+
+/**
+ * Returns the stack of `size` bytes starting at `limit` to `area`.
+ */
+void stack_free(stack_area_t* area, void* limit, uint32_t size);
+
+/**
+ * Fills the words of a stack from `limit` up to (not including) `end` with STACK_PAINT_PATTERN.
+ */
+void stack_paint(void* limit, void* end);
+
+/**
+ * Returns the most bytes of the painted stack between `limit` and `base` that have been in use (the high-water mark measured from `base`).
+ */
+uint32_t stack_high_water(void* limit, void* base);
+
+#endif
@@ -7,6 +7,7 @@
 
 #include "arm.h"
 #include "gpio.h"
+#include "notify.h"
 
 /// Number of steps in one revolution of the stepper motor
 #define STEPPER_STEPS_PER_REVOLUTION 2048
@@ -63,6 +64,9 @@ typedef struct {
 /// Stepper motor currently attached to the nrf52840 (assuming only one used at a time)
 extern stepper_t attached_stepper;
 
+/// Signalled by the TIMER0 handler once the last step of the move started by stepper_move has been applied
+extern notify_t stepper_move_done;
+
 /**
  * Initializer for 4-wire control sequence.
  * This is the number of control pins available with the driver board and is also the default of the above referenced library.
@@ -80,7 +84,7 @@ int stepper_speed(uint32_t rpm);
  * Move the motor through the specified number of steps in the specified direction.
  * The apparent rotation of the motor is determined as the ratio between 
  * the number of steps per revolution and steps_to_move.
- * This call is blocking - waits until all steps are completed.
+ * This call is blocking - waits until all steps are completed (a calling user thread is blocked so that other threads can run in the meantime).
  * A CW rotation is applied if steps_to_move is positive and a CCW rotation is applied if steps_to_move is negative
  */
 int stepper_move(int32_t steps_to_move);
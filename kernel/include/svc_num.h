@@ -29,6 +29,21 @@
 /// SVC number for loadd neopixel sequence system call
 #define SVC_NEOPIXEL_LOAD 25
 
+/// SVC number for server define system call
+#define SVC_SERVER_DEFINE 26
+
+/// SVC number for server wait system call
+#define SVC_SERVER_WAIT 27
+
+/// SVC number for server notify system call
+#define SVC_SERVER_NOTIFY 28
+
+/// SVC number for thread deadline stats system call
+#define SVC_THREAD_DEADLINE_STATS 29
+
+/// SVC number for thread deadline policy system call
+#define SVC_THREAD_DEADLINE_POLICY 30
+
 /// SVC number for multitask request system call
 #define SVC_MULTITASK_REQUEST 31
 
@@ -56,6 +71,9 @@
 /// SVC number for thread priority system call
 #define SVC_THREAD_PRIORITY 39
 
+/// SVC number for thread response time system call
+#define SVC_THREAD_RESPONSE_TIME 40
+
 /// SVC number of lock init system call
 #define SVC_LOCK_INIT 41
 
@@ -65,6 +83,18 @@
 /// SVC number of unlock system call
 #define SVC_UNLOCK 43
 
+/// SVC number of thread cycles system call
+#define SVC_THREAD_CYCLES 44
+
+/// SVC number of thread stack usage system call
+#define SVC_THREAD_STACK_USAGE 45
+
+/// SVC number of cycle count system call
+#define SVC_CYCLE_COUNT 46
+
+/// SVC number of switch cycles system call
+#define SVC_SWITCH_CYCLES 47
+
 /// SVC number of stepper set speed system call
 #define SVC_STEPPER_SET_SPEED 51
 
@@ -74,4 +104,49 @@
 /// SVC number for ultrasonic sensor measurement system call
 #define SVC_ULTRASONIC_SENSOR_READ 53
 
+/// SVC number of semaphore init system call
+#define SVC_SEM_INIT 54
+
+/// SVC number of semaphore wait system call
+#define SVC_SEM_WAIT 55
+
+/// SVC number of semaphore try wait system call
+#define SVC_SEM_TRY_WAIT 56
+
+/// SVC number of semaphore post system call
+#define SVC_SEM_POST 57
+
+/// SVC number of event group init system call
+#define SVC_EVENT_GROUP_INIT 58
+
+/// SVC number of event wait system call
+#define SVC_EVENT_WAIT 59
+
+/// SVC number of event set system call
+#define SVC_EVENT_SET 60
+
+/// SVC number of event clear system call
+#define SVC_EVENT_CLEAR 61
+
+/// SVC number of condition variable init system call
+#define SVC_COND_INIT 62
+
+/// SVC number of condition variable wait system call
+#define SVC_COND_WAIT 63
+
+/// SVC number of condition variable signal system call
+#define SVC_COND_SIGNAL 64
+
+/// SVC number of condition variable broadcast system call
+#define SVC_COND_BROADCAST 65
+
+/// SVC number of ring init system call
+#define SVC_RING_INIT 66
+
+/// SVC number of ring wait system call
+#define SVC_RING_WAIT 67
+
+/// SVC number of ring notify system call
+#define SVC_RING_NOTIFY 68
+
 #endif
\ No newline at end of file
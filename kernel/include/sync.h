@@ -0,0 +1,147 @@
+/** @file   sync.h
+ *  @brief  Counting semaphores, event flag groups, and condition variables that block threads in the scheduler instead of having them poll.
+**/
+
+#ifndef _SYNC_H_
+#define _SYNC_H_
+
+#include "arm.h"
+#include "mutex.h"
+
+/// The maximum number of counting semaphores that the user application can define
+#define MAX_USER_SEMAPHORES (16)
+
+/// The maximum number of event flag groups that the user application can define
+#define MAX_USER_EVENT_GROUPS (8)
+
+/// The maximum number of condition variables that the user application can define
+#define MAX_USER_CONDS (8)
+
+/// Option of event_wait to wait until every flag in the mask is set (otherwise any one of them is enough)
+#define EVENT_WAIT_ALL (0x1)
+
+/// Option of event_wait to clear the flags that it returns (so each setting of a flag is consumed by one waiter)
+#define EVENT_WAIT_CLEAR (0x2)
+
+/**
+ * Counting semaphore with the threads blocked on it kept in priority order.
+ */
+typedef struct {
+    uint32_t count; ///< Units that can be taken without blocking (always 0 while threads are blocked on it)
+    uint8_t wait_head; ///< Index in user_threads of the highest priority thread blocked on this semaphore (linked through wait_next - WAIT_QUEUE_END if empty)
+} semaphore_t;
+
+/**
+ * Group of 32 event flags with the threads blocked on it kept in priority order (each waiter has its own mask and options in its TCB).
+ */
+typedef struct {
+    uint32_t flags; ///< Flags that are set
+    uint8_t wait_head; ///< Index in user_threads of the highest priority thread blocked on this group (linked through wait_next - WAIT_QUEUE_END if empty)
+} event_group_t;
+
+/**
+ * Condition variable whose waiters take back their lock (under the priority ceiling protocol) before they are woken.
+ */
+typedef struct {
+    uint8_t wait_head; ///< Index in user_threads of the highest priority thread blocked on this condition variable (linked through wait_next - WAIT_QUEUE_END if empty)
+} cond_t;
+
+/**
+ * Forgets every semaphore, event group, and condition variable (called by multitask_request before the application defines its own).
+ */
+void sync_reset();
+
+/**
+ * Returns 0 if the running thread may block and a negative error code otherwise (only user threads that hold no lock can block).
+ */
+int sync_can_block();
+
+/**
+ * Blocks the running thread in the wait queue starting at `head` and invokes the scheduler (`svc_num` is the wait that blocked it).
+ */
+void sync_block(uint8_t* head, uint32_t svc_num);
+
+/**
+ * Makes the blocked thread at `index` ready (it has to be unlinked from its wait queue already).
+ * Returns 1 if it should take the processor from the running thread.
+ */
+uint32_t sync_wake(uint8_t index);
+
+/**
+ * Invokes the scheduler if `preempt` is set (a woken thread should run before the caller).
+ */
+void sync_preempt(uint32_t preempt);
+
+/**
+ * Syscall for defining a counting semaphore with `count` units available (only from the main thread before multitask_start).
+ * Returns the kernel address of the semaphore or NULL if none are left.
+ */
+semaphore_t* syscall_sem_init(uint32_t count);
+
+/**
+ * Syscall for taking a unit of the semaphore `s` (blocks the calling thread until sem_post hands it one if none are available).
+ * Returns 0 once the unit was taken or a negative error code.
+ */
+int syscall_sem_wait(semaphore_t* s);
+
+/**
+ * Syscall for taking a unit of the semaphore `s` only if one is available right away.
+ * Returns 0 if a unit was taken, 1 if none was available, or a negative error code.
+ */
+int syscall_sem_try_wait(semaphore_t* s);
+
+/**
+ * Syscall for giving a unit to the highest priority thread blocked on the semaphore `s` (or adding it to the count if none are blocked).
+ * Returns 0 on success or a negative error code.
+ */
+int syscall_sem_post(semaphore_t* s);
+
+/**
+ * Syscall for defining a group of event flags with every flag clear (only from the main thread before multitask_start).
+ * Returns the kernel address of the group or NULL if none are left.
+ */
+event_group_t* syscall_event_group_init();
+
+/**
+ * Syscall for waiting until any (or with EVENT_WAIT_ALL every) flag of `mask` is set in the group `g` (blocks the calling thread until then).
+ * Returns the flags of `mask` that were set (cleared from the group with EVENT_WAIT_CLEAR) or 0 if the wait was refused.
+ */
+uint32_t syscall_event_wait(event_group_t* g, uint32_t mask, uint32_t options);
+
+/**
+ * Syscall for setting `flags` in the group `g` and waking every waiter whose wait is now satisfied (in priority order).
+ * Returns 0 on success or a negative error code.
+ */
+int syscall_event_set(event_group_t* g, uint32_t flags);
+
+/**
+ * Syscall for clearing `flags` in the group `g`.
+ * Returns the flags that were set before or 0 if `g` is not a group.
+ */
+uint32_t syscall_event_clear(event_group_t* g, uint32_t flags);
+
+/**
+ * Syscall for defining a condition variable (only from the main thread before multitask_start).
+ * Returns the kernel address of the condition variable or NULL if none are left.
+ */
+cond_t* syscall_cond_init();
+
+/**
+ * Syscall for releasing the lock `m` and blocking on the condition variable `c` in one step (`m` must be the only lock that the calling thread holds).
+ * Returns 0 once the thread was signalled and holds `m` again or a negative error code.
+ */
+int syscall_cond_wait(cond_t* c, mutex_t* m);
+
+/**
+ * Syscall for waking the highest priority thread blocked on the condition variable `c` (it runs once it holds its lock again).
+ * Returns 0 on success or a negative error code.
+ */
+int syscall_cond_signal(cond_t* c);
+
+/**
+ * Syscall for waking every thread blocked on the condition variable `c` (each one runs once it holds its lock again).
+ * Returns 0 on success or a negative error code.
+ */
+int syscall_cond_broadcast(cond_t* c);
+
+#endif
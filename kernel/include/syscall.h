@@ -19,11 +19,20 @@ typedef struct {
     uint32_t xpsr; ///< Previous value of xpsr
 } stack_frame_t;
 
+/// Number of words that hardware stacks for a thread with an active FP context (the basic frame followed by s0-s15, FPSCR, and a reserved word)
+#define STACK_FRAME_EXTENDED_WORDS (26)
+
+/// Bit of the stacked xPSR that is set when hardware skipped a word above the frame to align it to 8 bytes
+#define STACK_FRAME_XPSR_PADDED (1 << 9)
+
+/// Set by a syscall that blocked the calling thread so that SVC_C_Handler rewinds the thread to its svc instruction (the syscall runs again from the start once the thread is scheduled)
+extern uint8_t svc_restart;
+
 /**
  * Offers support for multiple software-pended exceptions/syscalls through use of single SVC_Handler.
- * Will receive pointer to process stack as arguement (loaded into r0 by SVC_Handler assembly func which calls this C-level handler).  
+ * Will receive pointer to process stack as arguement (loaded into r0 by SVC_Handler assembly func which calls this C-level handler) and the EXC_RETURN value of the exception (in r1) that tells how large the stacked frame is.
  */ 
-void SVC_C_Handler(void *psp);
+void SVC_C_Handler(void *psp, uint32_t exc_return);
 
 /**
  * sbrk system call implementation supporting NEWLIB.
@@ -46,8 +46,12 @@ typedef enum {
     SystickEnabled ///< Counter is enabled
 } systick_enable;
 
-/// Base frequency of the SysTick timer (64 MHz)
+/// Base frequency of the SysTick timer (64 MHz processor clock - QEMU mps2-an386 clocks it from its 25 MHz system clock)
+#ifdef TARGET_QEMU
+#define SYSTICK_BASE_FREQUENCY (25000000)
+#else
 #define SYSTICK_BASE_FREQUENCY (64000000)
+#endif
 
 /// Maximum value of a 24-bit parameter (will result in an error if RELOAD value is above this value)
 #define MAX_24_BIT 0x00FFFFFF
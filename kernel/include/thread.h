@@ -6,15 +6,44 @@
 #define _THREAD_H_
 
 #include "arm.h"
+#include "mpu.h"
 
 // The maximum number of threads that the user is allowed to specifiy (included 2 additional threads - the main thread and the idle thread)
-#define MAX_NUM_THREADS (14)
+// Indices into user_threads are kept in a uint8_t with 0xFF reserved as an end marker, so this must stay below 254
+#define MAX_NUM_THREADS (64)
 
 /// The maximum number of locks that the user application is allowed to use to coordinate between threads
 #define MAX_USER_LOCKS (32)
 
-/// Enforce a maximum of 32kB of space for the user thread stacks (max for only a single stack)
-#define MAX_TOTAL_THREAD_STACK_SIZE (32768)
+/// Number of words in the scheduler's ready bitmap (one bit per dynamic priority level - at most 32 words since a single summary word has one bit per word)
+#define READY_BITMAP_WORDS ((MAX_NUM_THREADS + 31) / 32)
+
+/// Number of dynamic priority levels tracked by the scheduler's ready bitmap (at least MAX_NUM_THREADS)
+#define READY_BITMAP_LEVELS (READY_BITMAP_WORDS * 32)
+
+/// Marks an empty release queue and a thread that is not in it (used in place of an index into user_threads or a position in the release heap)
+#define RELEASE_QUEUE_END (0xFF)
+
+/// Marks the end of the EDF ready queue (used in place of an index into user_threads)
+#define READY_QUEUE_END (0xFF)
+
+/// Marks the end of the wait queue of a lock (used in place of an index into user_threads)
+#define WAIT_QUEUE_END (0xFF)
+
+/// Marks the bottom of the ceiling stack and of the stack of locks held by a thread (used in place of an index into user_locks)
+#define LOCK_STACK_END (0xFF)
+
+/// Dynamic priority of a thread demoted to the background after a deadline miss (below every user thread but above the idle and main thread - never tracked by the ready bitmap)
+#define THREAD_PRIORITY_BACKGROUND (0xFFFFFFFE)
+
+/// EXC_RETURN value for returning to thread mode on the PSP with a basic (integer only) stack frame
+#define EXC_RETURN_THREAD_PSP (0xfffffffd)
+
+/// Bit of EXC_RETURN that is clear when the stacked frame is extended with FP state (i.e. the thread has touched the FPU)
+#define EXC_RETURN_BASIC_FRAME (1 << 4)
+
+/// Largest thread stack area (set by __thread_user_stacks_size in the linker script) that the stack allocator can track (also the max for a single stack)
+#define MAX_TOTAL_THREAD_STACK_SIZE (131072)
 
 /**
  * The possible states that the thread can be in (running state). 
@@ -27,17 +56,24 @@ typedef enum {
     ThreadDefunct ///< Thread is not schedulable
 } thread_state;
 
+/**
+ * What the scheduler does with a thread whose previous job is still unfinished when its next job is released (a deadline miss).
+ */
+typedef enum {
+    DeadlineMissContinue, ///< Only count the miss (the late job keeps running with the budget of the new job)
+    DeadlineMissSkip, ///< Skip the new job (its budget is not re-armed so the late job finishes with what is left, or with the budget re-armed at the following release if it is still late then)
+    DeadlineMissDemote, ///< Run the thread in the background (below every other user thread) until the late job completes
+    DeadlineMissEnd ///< End the thread (it runs thread_end the next time it is scheduled so that its locks are released as usual)
+} deadline_policy;
+
 /**
  * TCB containing all of the necessary metadata to completely encapsulate the current running state of a thread.
  */
 typedef struct {
     uint32_t id; ///< Task ID
     void* base_process_stack; ///< The base address of the process stack for this thread (not current pointer)
-    void* base_main_stack; ///< The base address of the main stack for this thread (not current pointer)
     void* limit_process_stack; ///< The limit address of the process stack for this thread (not current pointer - used for detecting under/overflow)
-    void* limit_main_stack; ///< The limit address of the kernel stack for this thread (not current pointer - used for detecting under/overflow)
-    void* psp; ///< Process stack pointer (user space) of the thread
-    void* msp; ///< Main stack pointer of the thread
+    void* psp; ///< Process stack pointer (user space) of the thread (points at its switch_stackframe_t while it is switched out)
     thread_state state; ///< Execution status of the thread 
     uint32_t c; ///< Worst case execution time in a single period
     uint32_t t; ///< Amount of time between releases for this task
@@ -45,16 +81,37 @@ typedef struct {
     uint32_t dynamic_priority; ///< Dynamic priority of the current thread (will either equal the static priority or an inherited dynamic priority)
     uint32_t active_time; ///< The total number of scheduler periods that this task has been scheduled since global start
     uint32_t remaining_work; ///< Number of scheduler periods that this task still needs to be active before its next period
-    uint32_t time_until_release; ///< Number of scheduler periods until the next instance of this task arrives
-    uint32_t svc_status; ///< Boolean variable determining whether the executing thread was handling an SVC request when it was suspended
+    uint32_t next_release; ///< Absolute timeslot (value of global_timeslot_counter) at which the next instance of this task arrives
+    uint8_t release_slot; ///< Position of this thread in the release heap (RELEASE_QUEUE_END if it is not queued)
+    uint32_t absolute_deadline; ///< Absolute timeslot by which the current instance of this task must finish (release plus period - only used for ordering under EDF)
+    uint8_t ready_next; ///< Index in user_threads of the ready thread with the next latest deadline in the EDF ready queue (READY_QUEUE_END if last)
+    uint8_t wait_next; ///< Index in user_threads of the next thread in the wait queue that this thread is blocked in (WAIT_QUEUE_END if last)
+    uint8_t wait_lock; ///< Index in user_locks of the lock that this thread asked for while it is blocked (not always the lock whose wait queue it is in - the ceiling of another lock can be what blocks it)
+    uint32_t wait_mask; ///< Event flags that this thread waits for while it is blocked in event_wait
+    uint8_t wait_options; ///< Options (EVENT_WAIT_ALL and EVENT_WAIT_CLEAR) of the event_wait that this thread is blocked in
+    uint8_t held_top; ///< Index in user_locks of the last lock that this thread took and still holds (the others are linked through held_below of the locks - LOCK_STACK_END if it holds none)
+    uint32_t response_time; ///< Worst case number of scheduler periods between a release of this task and its completion (from response time analysis)
+    mpu_region_t stack_region; ///< Precomputed MPU region for the user stack (region 6) of this thread (loaded on every switch under THREAD_PROTECT)
+    uint64_t cycles; ///< Number of processor cycles that this thread has run for since it was defined (sampled from the DWT cycle counter on every context switch)
+    uint8_t server; ///< Nonzero if this thread is an aperiodic (deferrable) server that only runs when woken by an event (its budget is kept while it waits instead of being used up by polling)
+    uint32_t events; ///< Event bits signalled to this server that it has not consumed yet
+    uint32_t event_mask; ///< Event bits that this server is waiting on in server_wait (0 if it is not waiting for an event)
+    uint8_t job_pending; ///< Nonzero while the current job has not completed (set at every release and cleared when the thread yields)
+    uint32_t job_deadline; ///< Absolute timeslot by which the oldest unfinished job had to complete (kept across releases while that job is late)
+    uint32_t deadline_misses; ///< Number of releases at which the previous job of this thread had not completed yet
+    uint32_t overruns; ///< Number of times this thread used up its budget without completing its job
+    uint32_t max_lateness; ///< Largest number of timeslots that a job of this thread completed after its deadline
+    deadline_policy miss_policy; ///< What the scheduler does at a deadline miss of this thread
+    uint8_t demoted; ///< Nonzero while this thread runs in the background after a deadline miss (DeadlineMissDemote)
+    uint8_t job_skipped; ///< Nonzero once a release was skipped for the current late job (DeadlineMissSkip - the next release re-arms the budget instead of skipping again)
 } tcb_t;
 
 /**
- * Contents that is manually saved on the MSP so that a copy of the registers is not needed to be stored in the TCB directly.
- * Ensures that all of the information is available for use 
+ * Contents that is manually saved on the PSP of a thread (directly below the frame stacked by hardware) so that a copy of the registers is not needed to be stored in the TCB directly.
+ * Keeping it on the process stack means that threads need no kernel stack of their own (every handler runs on the single kernel main stack and context switches only happen once no handler is active).
+ * The callee saved FP registers are only saved (after the integer registers) if bit 4 of the saved lr is clear, so threads that never touch the FPU do not pay for them.
  */
 typedef struct {
-    uint32_t psp; ///< User stack address
     uint32_t r4; ///< Register 4 old content (callee saved)
     uint32_t r5; ///< Register 5 old content (callee saved)
     uint32_t r6; ///< Register 6 old content (callee saved)
@@ -64,6 +121,10 @@ typedef struct {
     uint32_t r10; ///< Register 10 old content (callee saved)
     uint32_t r11; ///< Register 11 old content (callee saved)
     uint32_t lr; ///< Exec return address (how to return out of handler)
-} main_stackframe_t;
+    uint32_t s[16]; ///< FP registers s16-s31 old content (callee saved - only present when lr & EXC_RETURN_BASIC_FRAME is 0)
+} switch_stackframe_t;
+
+/// Size of a switch_stackframe_t without the FP registers (what PendSV_Handler pushes for a thread that has not touched the FPU)
+#define SWITCH_STACKFRAME_BASIC_SIZE (sizeof(switch_stackframe_t) - 16*sizeof(uint32_t))
 
 #endif
\ No newline at end of file
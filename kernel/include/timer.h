@@ -27,6 +27,12 @@ extern volatile uint32_t timer0_num_interrupts_already_handled;
 /// Interrupt request number in vector table for TIMER1 (will be pended from TIMER1 when timeout value is found)
 #define TIMER1_IRQ (9)
 
+/// Base address for the TIMER2 instance of the timer peripheral (currently used by the scheduler in tickless mode)
+#define TIMER2_BASE_ADDR 0x4000A000
+
+/// Interrupt request number in vector table for TIMER2 (will be pended from TIMER2 when the next scheduling event is reached)
+#define TIMER2_IRQ (10)
+
 /// The base frequency of each timer peripheral is 16 MHz (which can be subdivided by setting the prescaler register)
 #define TIMER_BASE_FREQUENCY (16000000)
 
@@ -42,6 +48,16 @@ typedef enum {
     CC3 ///< Capture compare register 3
 } timer_cc;
 
+/**
+ * Valid widths of the timer counter (written to the BITMODE register).
+ */
+typedef enum {
+    Bit16, ///< 16 bit timer counter (default)
+    Bit08, ///< 8 bit timer counter
+    Bit24, ///< 24 bit timer counter
+    Bit32 ///< 32 bit timer counter
+} timer_bitmode;
+
 /// MMIO address for issuing the start task (starting timer countdown)
 #define TIMER_TASKS_START_ADDR(timer_addr) (timer_addr + 0x000)
 
@@ -63,6 +79,9 @@ typedef enum {
 /// The number of open right-aligned indices in the intenset register before bits start to enable interrupts
 #define TIMER_INTENSET_INDEX_OFFSET (16)
 
+/// Sets the width of the timer counter (see timer_bitmode for valid values)
+#define TIMER_BITMODE_ADDR(timer_addr) (timer_addr + 0x508)
+
 /// Set the prescalar for the 16 MHz to be used in the timer (valid values are 0-9 with the timer being divided by 2^prescaler)
 #define TIMER_PRESCALER_ADDR(timer_addr) (timer_addr + 0x510)
 
@@ -88,6 +107,11 @@ void timer0_start();
  */
 void timer0_stop();
 
+/**
+ * Handles the COMPARE[0] event of TIMER0 if it is set (called by TIMER0_Handler and polled by stepper_move for a caller that cannot block).
+ */
+void timer0_compare_event();
+
 /**
  * Configures the TIMER1 peripheral for use in tracking the delay between a source ultrasonic pulse and the detection of that pulse on return. 
  * This timer will begin counting until 36ms timeout point is reached (after which no object is assumed to be detected).
@@ -105,4 +129,30 @@ void timer1_start();
  */
 void timer1_stop();
 
+/**
+ * Handles the COMPARE[0] event of TIMER1 if it is set (called by TIMER1_Handler and polled by ultrasonic_range for a caller that cannot block).
+ */
+void timer1_compare_event();
+
+/**
+ * Configures the TIMER2 peripheral as a free running 32 bit counter at the full 16 MHz base frequency and starts it.
+ * CC[0] is used as a one-shot compare (loaded with timer2_compare) that generates a TIMER2 interrupt, and CC[1] is used to capture the current count.
+ */
+void timer2_init();
+
+/**
+ * Returns the current value of the TIMER2 counter (captured into CC[1]).
+ */
+uint32_t timer2_now();
+
+/**
+ * Loads `count` into CC[0] so that a TIMER2 interrupt is generated once the counter reaches it (clearing any stale compare event).
+ */
+void timer2_compare(uint32_t count);
+
+/**
+ * Immediately stop TIMER2 from counting further.
+ */
+void timer2_stop();
+
 #endif
\ No newline at end of file
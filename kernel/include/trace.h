@@ -0,0 +1,58 @@
+/** @file   trace.h
+ *  @brief  Compact binary event records for tracing the scheduler (streamed to the host over the second RTT up buffer).
+**/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "arm.h"
+
+/// Size of the RTT up buffer holding trace records (records that do not fit are dropped and counted instead of blocking)
+#define TRACE_BUFFER_SIZE (4096)
+
+/// Argument of the TRACE_THREAD_DEFINE record for the idle thread
+#define TRACE_ID_IDLE (0xFFFF)
+
+/// Argument of the TRACE_THREAD_DEFINE record for the main thread
+#define TRACE_ID_MAIN (0xFFFE)
+
+/**
+ * Kinds of trace records (the meaning of the thread and arg fields of each record is given per kind).
+ */
+typedef enum {
+    TRACE_SWITCH_OUT = 1, ///< Thread at index `thread` was switched out (arg is the thread_state it was left in)
+    TRACE_SWITCH_IN = 2, ///< Thread at index `thread` was switched in
+    TRACE_RELEASE = 3, ///< Thread at index `thread` was released (arg is the low 16 bits of the timeslot of the release)
+    TRACE_LOCK_BLOCK = 4, ///< Thread at index `thread` blocked on a lock (arg is the index of the lock)
+    TRACE_UNLOCK = 5, ///< Thread at index `thread` unlocked a lock (arg is the index of the lock)
+    TRACE_SVC_ENTER = 6, ///< Thread at index `thread` made a syscall (arg is the SVC number)
+    TRACE_SVC_EXIT = 7, ///< Syscall of the thread at index `thread` returned (arg is the SVC number)
+    TRACE_IRQ_ENTER = 8, ///< Interrupt handler started while the thread at index `thread` was running (arg is the exception number)
+    TRACE_IRQ_EXIT = 9, ///< Interrupt handler finished (arg is the exception number)
+    TRACE_THREAD_DEFINE = 10, ///< Index `thread` now holds the thread with the low 16 bits of its ID in arg (TRACE_ID_IDLE and TRACE_ID_MAIN for the idle and main thread)
+    TRACE_OVERFLOW = 11, ///< The host fell behind and arg records were dropped right before this one
+    TRACE_SERVER_WAKE = 12, ///< Server at index `thread` was woken by an event (arg is the low 16 bits of its pending event bits)
+    TRACE_NOTIFY_WAKE = 13, ///< Thread at index `thread` blocked in a driver syscall was woken by an interrupt handler (arg is the exception number)
+    TRACE_DEADLINE_MISS = 14, ///< Thread at index `thread` had not completed its previous job when it was released (arg is the low 16 bits of its miss count)
+    TRACE_OVERRUN = 15, ///< Thread at index `thread` used up its budget without completing its job (arg is the low 16 bits of its overrun count)
+    TRACE_SYNC_BLOCK = 16, ///< Thread at index `thread` blocked on a semaphore, event group, condition variable, or ring (arg is the SVC number of the wait)
+    TRACE_SYNC_WAKE = 17 ///< Thread at index `thread` blocked on a semaphore, event group, condition variable, or ring was woken (arg is the index of the thread that woke it)
+} trace_event;
+
+/**
+ * Single trace record as it appears in the RTT buffer (8 bytes, little endian).
+ */
+typedef struct {
+    uint32_t timestamp; ///< Value of the DWT cycle counter when the event happened (wraps at 32 bits)
+    uint8_t event; ///< Kind of event (one of trace_event)
+    uint8_t thread; ///< Index in user_threads of the thread the event belongs to
+    uint16_t arg; ///< Event specific argument
+} trace_record_t;
+
+/**
+ * Appends a record of `event` for the thread at index `thread` with argument `arg` (timestamped with the cycle counter) to the trace buffer.
+ * Never blocks (the record is dropped and counted if the host has not made room yet).
+ */
+void trace_record(trace_event event, uint8_t thread, uint16_t arg);
+
+#endif
@@ -7,6 +7,7 @@
 
 #include "arm.h"
 #include "gpiote.h"
+#include "notify.h"
 
 /// The value of the last measurement (range in cm) obtained from the ultrasonic sensor (max range is roughly 300 cm)
 extern volatile uint32_t last_ultrasonic_measurement;
@@ -14,9 +15,18 @@ extern volatile uint32_t last_ultrasonic_measurement;
 /// Flag for saying if an event has already been serviced dealing with the start of the signal (rising edge - if so the next interrupt should take a different action)
 extern volatile uint8_t in_measurement;
 
+/// Signalled by the GPIOTE handler (echo received) or the TIMER1 handler (timeout) once last_ultrasonic_measurement holds the result
+extern notify_t ultrasonic_done;
+
 /// Amount of time (in uS) until the ultrasonic sensor measurement is said to be invalid
 #define ULTRASONIC_TIMEOUT_US 36000
 
+/// Range reported when no echo came back before ULTRASONIC_TIMEOUT_US (mirrored in user/include/usyscall.h)
+#define ULTRASONIC_RANGE_NONE (0xFFFFFFFF)
+
+/// Range reported instead of a measurement when another thread is still waiting for the measurement it started (mirrored in user/include/usyscall.h)
+#define ULTRASONIC_RANGE_BUSY (0xFFFFFFFE)
+
 /// GPIO port for the ultrasonic trigger signal
 #define ULTRASONIC_TRIGGER_PORT P0
 
@@ -39,7 +49,8 @@ void ultrasonic_init();
 
 /**
  * Return a single measurement from the ultrasonic sensor of the current range in cm.
- * This implementation is blocking to allow user threads to accurately gauge execution time of interrupts.
+ * This implementation is blocking, but a calling user thread is blocked (letting other threads run) until the measurement completes instead of spinning through its budget.
+ * Returns ULTRASONIC_RANGE_NONE if no echo came back and ULTRASONIC_RANGE_BUSY if another thread is still waiting for a measurement that it started (both beyond any range the sensor can measure).
  */
 uint32_t ultrasonic_range();
 
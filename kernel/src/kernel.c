@@ -18,14 +18,21 @@ extern void enter_user_mode(void);
  */
 int kernel_main() {
     // Initializations for integrated peripherals (and floating point computation)
+#ifndef TARGET_QEMU
     reset_enable();
+#endif
     rtt_init();
     enable_fpu();
+    enable_cycle_counter();
     mpu_enable();
+
+    // The board peripherals (reset button, neopixels, stepper, and ultrasonic sensor) do not exist on QEMU
+#ifndef TARGET_QEMU
     pix_init();
     stepper_init(STEPPER_STEPS_PER_REVOLUTION, STEPPER_CONTROL_PORT_1, STEPPER_CONTROL_PIN_1, STEPPER_CONTROL_PORT_3, STEPPER_CONTROL_PIN_3, STEPPER_CONTROL_PORT_2, STEPPER_CONTROL_PIN_2, STEPPER_CONTROL_PORT_4, STEPPER_CONTROL_PIN_4); // Sequence assumes 3-wired declared as second arguement (for some reason)
     stepper_speed(10); // 10 RPM default speed
     ultrasonic_init();
+#endif
 
     // Enter user mode directly (should never return from here)
     enter_user_mode();
@@ -9,11 +9,13 @@
 #include "syscall.h"
 
 
-/** @brief  enables an aligned memory protection region
+/** @brief  encodes an aligned memory protection region
  *
- *  Helper function used locally to wrap mapping desired MPU configuration into
- *  proper encodings for MPU RNR, RBAR, and RASR fields.
+ *  Maps desired MPU configuration into proper encodings for the MPU RBAR
+ *  (with VALID and REGION set) and RASR fields so that they can be loaded
+ *  later (or immediately by mpu_region_enable).
  *
+ *  @param  descriptor  destination for the encoded register values
  *  @param  region      region number to enable
  *  @param  base_addr   region's base address
  *  @param  size_log2   ceil(log_2) of the region's size
@@ -22,7 +24,7 @@
  *
  *  @return -1 on error, 0 otherwise
  */
-int mpu_region_enable(uint32_t region, void *base_addr, uint32_t size_log2, uint8_t execute, uint8_t write) {
+int mpu_region_encode(mpu_region_t* descriptor, uint32_t region, void *base_addr, uint32_t size_log2, uint8_t execute, uint8_t write) {
     if(region > MPU_RNR_REGION_MAX) {
         printk("error: invalid region number\n");
         return -1;
@@ -38,15 +40,76 @@ int mpu_region_enable(uint32_t region, void *base_addr, uint32_t size_log2, uint
         return -1;
     }
 
-    MPU_RNR = (region & MPU_RNR_REGION_MAX) << MPU_RNR_REGION_POS;
-    MPU_RBAR = ((uint32_t)base_addr) & MPU_RBAR_ADDR_MASK;
+    descriptor->rbar = (((uint32_t)base_addr) & MPU_RBAR_ADDR_MASK) | (1 << MPU_RBAR_VALID_POS) | ((region & MPU_RNR_REGION_MAX) << MPU_RBAR_REGION_POS);
 
     uint32_t xn = (execute ? 0 : 1) << MPU_RASR_XN_POS;
     uint32_t ap = (write ? MPU_RASR_AP_RW : MPU_RASR_AP_RO) << MPU_RASR_AP_POS;
     uint32_t size = ((size_log2 - 1) & MPU_RASR_SIZE_MAX) << MPU_RASR_SIZE_POS;
     uint32_t en = 1 << MPU_RASR_ENABLE_POS;
 
-    MPU_RASR = xn | ap | size | en;
+    descriptor->rasr = xn | ap | size | en;
+
+    return 0;
+}
+
+/** @brief  encodes a memory protection region using subregions
+ *
+ *  Covers a range that is not a power of two in size (or not aligned to
+ *  its own size) with the smallest naturally aligned region containing it,
+ *  disabling every subregion of that region outside of the range.
+ *
+ *  @param  descriptor  destination for the encoded register values
+ *  @param  region      region number to enable
+ *  @param  limit       lowest address of the range
+ *  @param  size        size of the range in bytes
+ *  @param  execute     indicator/non-zero if region is executable
+ *  @param  write       indicator/non-zero if region is writable
+ *
+ *  @return -1 on error, 0 otherwise
+ */
+int mpu_subregion_encode(mpu_region_t* descriptor, uint32_t region, void *limit, uint32_t size, uint8_t execute, uint8_t write) {
+    uint32_t size_log2 = mpu_region_log2_for(size);
+    uint32_t subregion_bytes = (1 << size_log2) / MPU_SUBREGIONS;
+    uint32_t block = (uint32_t)limit & ~((1 << size_log2) - 1);
+    uint32_t first = ((uint32_t)limit - block) / subregion_bytes;
+    uint32_t count = (size + subregion_bytes - 1) / subregion_bytes;
+
+    if(((uint32_t)limit - block) % subregion_bytes || size % subregion_bytes || first + count > MPU_SUBREGIONS) {
+        printk("error: range does not fit the subregions of a single region\n");
+        return -1;
+    }
+
+    if(mpu_region_encode(descriptor, region, (void *)block, size_log2, execute, write)) {
+        return -1;
+    }
+
+    uint32_t enabled = ((1 << count) - 1) << first;
+    descriptor->rasr |= (~enabled & 0xff) << MPU_RASR_SRD_POS;
+
+    return 0;
+}
+
+/** @brief  enables an aligned memory protection region
+ *
+ *  Helper function used locally to encode the desired MPU configuration
+ *  (see mpu_region_encode) and immediately load it into RBAR and RASR.
+ *
+ *  @param  region      region number to enable
+ *  @param  base_addr   region's base address
+ *  @param  size_log2   ceil(log_2) of the region's size
+ *  @param  execute     indicator/non-zero if region is executable
+ *  @param  write       indicator/non-zero if region is writable
+ *
+ *  @return -1 on error, 0 otherwise
+ */
+int mpu_region_enable(uint32_t region, void *base_addr, uint32_t size_log2, uint8_t execute, uint8_t write) {
+    mpu_region_t descriptor;
+    if(mpu_region_encode(&descriptor, region, base_addr, size_log2, execute, write)) {
+        return -1;
+    }
+
+    MPU_RBAR = descriptor.rbar; // VALID bit selects the region (no separate RNR write)
+    MPU_RASR = descriptor.rasr;
 
     return 0;
 }
@@ -126,7 +189,7 @@ void mpu_disable() {
  */
 void mpu_thread_region_enable(void *base_addr, uint32_t size) {
     // Designate region 6 as dealing with the user stack
-    mpu_region_enable(6, base_addr, ceil_log2(size), 0, 1);
+    mpu_region_enable(MPU_THREAD_STACK_REGION, base_addr, ceil_log2(size), 0, 1);
     data_sync_barrier();
 }
 
@@ -135,27 +198,7 @@ void mpu_thread_region_enable(void *base_addr, uint32_t size) {
  * Will always deactive region 6 (as this is what is assigned above).
  */
 void mpu_thread_region_disable() {
-    mpu_region_disable(6);
-    data_sync_barrier();
-}
-
-/**
- * Creates a kernel stack thread memory protection region according to whether the user wants to protect individual threads or just the kernel.
- * If the user application only wants to protect kernel, a single region covers the entire range of thread kernel stack space (else this thread should only access its own kernel stack space)
- * Thread will have RW access to its own kernel stack space.
- */
-void mpu_kernel_region_enable(void *base_addr, uint32_t size) {
-    // Designate region 7 as dealing with the kernel stack
-    mpu_region_enable(7, base_addr, ceil_log2(size), 0, 1);
-    data_sync_barrier();
-}
-
-/**
- * Deactive the memory protection region associated with the kernel stack.
- * Will always deactive region 7 (as this is what is assigned above).
- */
-void mpu_kernel_region_disable() {
-    mpu_region_disable(7);
+    mpu_region_disable(MPU_THREAD_STACK_REGION);
     data_sync_barrier();
 }
 
@@ -190,6 +233,9 @@ void MemFault_C_Handler(void *psp) {
         CFSR |= (1 << CFSR_IACCVIOL_POS);
     }
 
+    // Report how deep every stack has gone so far (an overflow shows up as a stack used up to its size)
+    thread_stack_usage_dump();
+
     // Check if there is an unrecoverable stack overflow or underflow (for not the main thread)
     // If so, print an appropriate error message and exit the application with a suitable error code
     if (active_thread_index < num_user_threads+1) {
@@ -5,8 +5,13 @@
 #include "multitask.h"
 #include "syscall.h"
 #include "systick.h"
+#include "timer.h"
+#include "stack.h"
+#include "rtt.h"
 #include "error.h"
 #include "printk.h"
+#include "sync.h"
+#include "ring.h"
 
 /// Array of TCB's of threads specificed by user (the active thread will be at index num_user_threads - i.e. one more than the last defined user thread)
 tcb_t user_threads[MAX_NUM_THREADS+2] = { 0 };
@@ -20,6 +25,9 @@ uint8_t num_active_threads = 0;
 /// Active index of the thread in user_thread
 uint8_t active_thread_index;
 
+/// Lowest address that the switch frame of the active thread may reach (read by PendSV_Handler before it pushes anything - NULL for the main thread which is not checked)
+void* switch_frame_limit = NULL;
+
 /// The current timeslot that the scheduler is using (i.e. how many scheduling decisions have been made as a result of timer preemption)
 uint32_t global_timeslot_counter = 0;
 
@@ -44,156 +52,742 @@ uint32_t global_priority_ceiling = 0xFFFFFFFF;
 /// Address of the lock that currently is dictating the global_priority_ceiling (i.e. the lock who set the current global priority ceiling equal to its priority ceiling)
 mutex_t* highest_priority_lock = 0;
 
+/// Index in user_locks of the lock that was locked last and is still locked (the locked locks are linked through stack_below in the order they were granted - LOCK_STACK_END if none)
+uint8_t ceiling_stack_top = LOCK_STACK_END;
+
+/// Bits of lock_shared.held as of the last time the kernel accounted for them (a bit that differs from lock_shared was set or cleared in user space by the thread that ran since)
+uint32_t lock_held_seen = 0;
+
 /// Signal for indiciating that a scheduling decision needs to be made from preemption (and not from an explicit yield - used for charging time units)
 uint8_t preemption_flag = 0;
 
+/// Indices in user_threads of the threads waiting for their next release, kept as a binary min-heap on next_release (the earliest release is always at position 0)
+uint8_t release_heap[MAX_NUM_THREADS];
+
+/// Number of threads in the release heap
+uint8_t release_heap_size = 0;
+
+/// Wrap-safe comparison of two absolute timeslots (true if timeslot `_A` comes strictly before timeslot `_B`)
+#define TIMESLOT_BEFORE(_A,_B) ((int32_t)((_A) - (_B)) < 0)
+
+/// Converts a dynamic priority level (or a word of the ready bitmap) into its bit within a word (reversed so that the highest priority is the most significant bit)
+#define READY_BIT(_P) (0x80000000u >> ((_P) % 32))
+
+/// Bitmap of ready threads indexed by dynamic priority (bit 31-(p%32) of word p/32 is set when the thread at dynamic priority p is ThreadReady)
+uint32_t ready_bitmap[READY_BITMAP_WORDS] = { 0 };
+
+/// Bit 31-w is set when word w of ready_bitmap is nonzero (so the highest ready level is found with one CLZ on this word and one on the word it points at, whatever the number of threads)
+uint32_t ready_bitmap_summary = 0;
+
+/// Index in user_threads of the ready thread occupying each dynamic priority level (only meaningful for levels whose bit is set in ready_bitmap)
+uint8_t ready_thread_index[READY_BITMAP_LEVELS];
+
+/// Index in user_threads of the ready thread with the earliest absolute deadline (head of the EDF ready queue sorted by absolute_deadline)
+uint8_t edf_ready_head = READY_QUEUE_END;
+
+/// Scheduling policy selected in multitask_request (decides between the ready bitmap and the EDF ready queue)
+sched_policy scheduling_policy = RATE_MONOTONIC;
+
+/// Number of processor cycles spent in the scheduler and in interrupt handlers since multitask_start
+uint64_t kernel_cycles = 0;
+
+/// Value of the cycle counter when cycles were last charged to the running thread (at the end of the last context switch)
+uint32_t cycle_last_sample = 0;
+
+/// Processor cycles that PendSV_C_Handler took for the last switch to a different thread (from its first cycle count to the end of the switch)
+uint32_t switch_cycles_last = 0;
+
+/**
+ * Inserts the thread at `index` into the EDF ready queue according to its absolute_deadline (threads with the same deadline keep their insertion order).
+ * The idle and main thread are never queued since they are the fallback when no user thread can run.
+ */
+void edf_ready_insert(uint8_t index) {
+    if (index >= num_user_threads) {
+        return;
+    }
+
+    uint32_t deadline = user_threads[index].absolute_deadline;
+    uint8_t* link = &edf_ready_head;
+    while ((*link != READY_QUEUE_END) && !TIMESLOT_BEFORE(deadline, user_threads[*link].absolute_deadline)) {
+        link = &user_threads[*link].ready_next;
+    }
+    user_threads[index].ready_next = *link;
+    *link = index;
+}
+
+/**
+ * Unlinks the thread at `index` from the EDF ready queue (no effect if it is not queued).
+ */
+void edf_ready_remove(uint8_t index) {
+    uint8_t* link = &edf_ready_head;
+    while (*link != READY_QUEUE_END) {
+        if (*link == index) {
+            *link = user_threads[index].ready_next;
+            return;
+        }
+        link = &user_threads[*link].ready_next;
+    }
+}
+
+/**
+ * Marks the thread at `index` as ready in the ready bitmap (at its current dynamic priority).
+ * Threads with a priority outside of the bitmap (the idle thread and main thread at 0xFFFFFFFF) are never tracked since they are the fallback when the bitmap is empty.
+ * PCP guarantees a single ready thread per dynamic priority level (a thread only shares its level with a lock holder that inherited it while the thread itself is blocked).
+ */
+void ready_bitmap_insert(uint8_t index) {
+    uint32_t priority = user_threads[index].dynamic_priority;
+    if (priority < READY_BITMAP_LEVELS) {
+        ready_bitmap[priority / 32] |= READY_BIT(priority);
+        ready_bitmap_summary |= READY_BIT(priority / 32);
+        ready_thread_index[priority] = index;
+    }
+}
+
+/**
+ * Removes the thread at `index` from the ready bitmap (only clearing the level if this thread is the one occupying it).
+ * The summary bit of the word is cleared along with the last level set in it.
+ */
+void ready_bitmap_remove(uint8_t index) {
+    uint32_t priority = user_threads[index].dynamic_priority;
+    if ((priority < READY_BITMAP_LEVELS) && (ready_thread_index[priority] == index)) {
+        ready_bitmap[priority / 32] &= ~READY_BIT(priority);
+        if (ready_bitmap[priority / 32] == 0) {
+            ready_bitmap_summary &= ~READY_BIT(priority / 32);
+        }
+    }
+}
+
+/**
+ * Clears every level of the ready bitmap.
+ */
+void ready_bitmap_clear() {
+    for (uint32_t word = 0; word < READY_BITMAP_WORDS; word++) {
+        ready_bitmap[word] = 0;
+    }
+    ready_bitmap_summary = 0;
+}
+
+/**
+ * Recomputes the ready bitmap from scratch by sweeping the user threads.
+ * Only needed when a range of priority levels moves at once (i.e. when a thread is inserted into or removed from priority_order) - all other changes are applied incrementally.
+ */
+void ready_bitmap_rebuild() {
+    ready_bitmap_clear();
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if (user_threads[index].state == ThreadReady) {
+            ready_bitmap_insert(index);
+        }
+    }
+}
+
+/**
+ * Changes the state of `thread` to `state`.
+ * Removes the thread from the ready bitmap (or the EDF ready queue) if it was ready and inserts it again if the new state is ready (so that the scheduler never needs to sweep user_threads).
+ */
+void thread_set_state(tcb_t* thread, thread_state state) {
+    uint8_t index = (uint8_t)(thread - user_threads);
+    if (thread->state == ThreadReady) {
+        if (scheduling_policy == EARLIEST_DEADLINE_FIRST) {
+            edf_ready_remove(index);
+        } else {
+            ready_bitmap_remove(index);
+        }
+    }
+
+    thread->state = state;
+    if (state == ThreadReady) {
+        if (scheduling_policy == EARLIEST_DEADLINE_FIRST) {
+            edf_ready_insert(index);
+        } else {
+            ready_bitmap_insert(index);
+        }
+    }
+}
+
+/**
+ * Changes the dynamic priority of `thread` to `priority` (either inheriting a higher priority or falling back to a lower one).
+ * A ready thread is moved between levels of the ready bitmap so that the next scheduling decision sees the new priority.
+ */
+void thread_set_dynamic_priority(tcb_t* thread, uint32_t priority) {
+    uint8_t index = (uint8_t)(thread - user_threads);
+    if ((thread->state == ThreadReady) && (scheduling_policy == RATE_MONOTONIC)) {
+        ready_bitmap_remove(index);
+        thread->dynamic_priority = priority;
+        ready_bitmap_insert(index);
+    } else {
+        thread->dynamic_priority = priority;
+    }
+}
+
+/**
+ * Changes the absolute deadline of `thread` to `deadline` (at the start of each of its periods).
+ * A ready thread (one that is still unfinished when its next period starts) is moved within the EDF ready queue so that it is ordered by its new deadline.
+ */
+void thread_set_deadline(tcb_t* thread, uint32_t deadline) {
+    uint8_t index = (uint8_t)(thread - user_threads);
+    if ((thread->state == ThreadReady) && (scheduling_policy == EARLIEST_DEADLINE_FIRST)) {
+        edf_ready_remove(index);
+        thread->absolute_deadline = deadline;
+        edf_ready_insert(index);
+    } else {
+        thread->absolute_deadline = deadline;
+    }
+}
+
+/**
+ * Returns 1 if `released` should take the processor from `running` as soon as it is released (higher dynamic priority under RMS or an earlier deadline under EDF).
+ * Under EDF, the idle and main thread have no deadline so any release preempts them.
+ */
+uint32_t release_preempts(tcb_t* released, tcb_t* running) {
+    if (scheduling_policy == EARLIEST_DEADLINE_FIRST) {
+        return (active_thread_index >= num_user_threads) || TIMESLOT_BEFORE(released->absolute_deadline, running->absolute_deadline);
+    }
+    return released->dynamic_priority < running->dynamic_priority;
+}
+
+/**
+ * Returns the index in user_threads of the thread with the earliest upcoming release (RELEASE_QUEUE_END if no thread is queued).
+ */
+uint8_t release_queue_first() {
+    return (release_heap_size > 0) ? release_heap[0] : RELEASE_QUEUE_END;
+}
+
+/**
+ * Places the thread at `index` at `slot` of the release heap (keeping its release_slot in step so it can be found again without a search).
+ */
+void release_heap_place(uint32_t slot, uint8_t index) {
+    release_heap[slot] = index;
+    user_threads[index].release_slot = slot;
+}
+
+/**
+ * Moves the thread at `slot` of the release heap towards the root until its parent is released no later than it.
+ */
+void release_heap_sift_up(uint32_t slot) {
+    uint8_t index = release_heap[slot];
+    while (slot > 0) {
+        uint32_t parent = (slot - 1) / 2;
+        if (!TIMESLOT_BEFORE(user_threads[index].next_release, user_threads[release_heap[parent]].next_release)) break;
+        release_heap_place(slot, release_heap[parent]);
+        slot = parent;
+    }
+    release_heap_place(slot, index);
+}
+
+/**
+ * Moves the thread at `slot` of the release heap towards the leaves until neither child is released before it.
+ */
+void release_heap_sift_down(uint32_t slot) {
+    uint8_t index = release_heap[slot];
+    while (1) {
+        uint32_t child = 2*slot + 1;
+        if (child >= release_heap_size) break;
+        if ((child + 1 < release_heap_size) && TIMESLOT_BEFORE(user_threads[release_heap[child+1]].next_release, user_threads[release_heap[child]].next_release)) {
+            child++;
+        }
+        if (!TIMESLOT_BEFORE(user_threads[release_heap[child]].next_release, user_threads[index].next_release)) break;
+        release_heap_place(slot, release_heap[child]);
+        slot = child;
+    }
+    release_heap_place(slot, index);
+}
+
+/**
+ * Inserts the thread at `index` into the release queue according to its next_release.
+ * The queue is a binary heap so an insertion costs O(log n) whatever the periods of the threads (a sorted list would walk every thread released earlier).
+ */
+void release_queue_insert(uint8_t index) {
+    release_heap_size++;
+    release_heap_place(release_heap_size - 1, index);
+    release_heap_sift_up(release_heap_size - 1);
+}
+
+/**
+ * Removes the thread at `index` from the release queue (no effect if it is not queued).
+ * The last thread of the heap fills the hole and is moved whichever way restores the ordering.
+ */
+void release_queue_remove(uint8_t index) {
+    uint32_t slot = user_threads[index].release_slot;
+    if ((slot >= release_heap_size) || (release_heap[slot] != index)) {
+        return;
+    }
+
+    user_threads[index].release_slot = RELEASE_QUEUE_END;
+    release_heap_size--;
+    if (slot == release_heap_size) {
+        return;
+    }
+    uint8_t moved = release_heap[release_heap_size];
+    release_heap_place(slot, moved);
+    release_heap_sift_up(slot);
+    if (user_threads[moved].release_slot == slot) {
+        release_heap_sift_down(slot);
+    }
+}
+
+/**
+ * Signals the event bits `events` to the server at `index` and wakes it if it is waiting on any of them in server_wait.
+ * A deferrable server keeps whatever budget it has left while it waits, so it becomes ready right away unless its budget already ran out (in which case the next release makes it ready).
+ * Only changes state (the caller pends PendSV if needed) so that it can be called from the release loop and from interrupt handlers. Returns 1 if the woken server should preempt the running thread.
+ */
+uint32_t server_signal(uint8_t index, uint32_t events) {
+    tcb_t* server = &user_threads[index];
+    server->events |= events;
+    if ((server->events & server->event_mask) == 0) {
+        return 0;
+    }
+
+    trace_record(TRACE_SERVER_WAKE, index, server->events);
+    server->event_mask = 0;
+    if ((server->state != ThreadWaiting) || (server->remaining_work == 0)) {
+        return 0;
+    }
+    thread_set_state(server, ThreadReady);
+    return release_preempts(server, &user_threads[active_thread_index]);
+}
+
+/// External user space declaration for making the svc call to thread_end (should be what is called when user space function end)
+extern void thread_end();
+
+/// Offset from the next release used as the EDF deadline of a demoted thread (far enough to order it after every regular deadline while staying within the wrap-safe range of TIMESLOT_BEFORE)
+#define DEMOTED_DEADLINE_OFFSET (0x40000000)
+
+/**
+ * Returns the frame that hardware stacked for the thread at `index` when it last entered an exception.
+ * The frame of the running thread is at the current PSP, while a switched out thread has its switch frame (with or without the FP registers) below it.
+ */
+stack_frame_t* thread_stack_frame(uint8_t index) {
+    if (index == active_thread_index) {
+        return (stack_frame_t*)process_stack_pointer();
+    }
+    switch_stackframe_t* switch_frame = (switch_stackframe_t*)user_threads[index].psp;
+    uint32_t switch_size = (switch_frame->lr & EXC_RETURN_BASIC_FRAME) ? SWITCH_STACKFRAME_BASIC_SIZE : sizeof(switch_stackframe_t);
+    return (stack_frame_t*)((uint32_t)switch_frame + switch_size);
+}
+
+/**
+ * Makes the thread at `index` call thread_end the next time it runs by rewriting the pc in the frame stacked by hardware (so it ends itself and releases its locks exactly as if its function had returned).
+ */
+void thread_redirect_end(uint8_t index) {
+    stack_frame_t* frame = thread_stack_frame(index);
+    frame->pc = (uint32_t)thread_end | 1;
+    frame->xpsr = 0x01000000; // Leave any IT block that the thread was interrupted in
+}
+
+/**
+ * Checks at a release of the thread at `index` (after its next_release was advanced) whether its previous job completed by its deadline.
+ * A miss is counted and handled according to the miss_policy of the thread, with the late job keeping its original deadline for the lateness measured when it completes.
+ * Servers have no jobs of their own so they are never checked. Returns 0 if the released job is skipped (its budget should not be re-armed) and 1 otherwise.
+ * A late job skips a single release: if it is still unfinished at the release after that, its budget is re-armed so it can finish (a thread that used up its budget would otherwise never get one again).
+ */
+uint32_t deadline_check(uint8_t index) {
+    tcb_t* thread = &user_threads[index];
+    if (thread->server) {
+        return 1;
+    }
+    if (!thread->job_pending) {
+        thread->job_pending = 1;
+        thread->job_deadline = thread->next_release;
+        return 1;
+    }
+
+    thread->deadline_misses++;
+    trace_record(TRACE_DEADLINE_MISS, index, thread->deadline_misses);
+    if (thread->miss_policy == DeadlineMissSkip) {
+        thread->job_skipped = !thread->job_skipped;
+        return !thread->job_skipped;
+    } else if ((thread->miss_policy == DeadlineMissDemote) && !thread->demoted) {
+        // An inherited priority is left alone (the unlock that drops it falls back to the background instead of the static priority)
+        thread->demoted = 1;
+        if ((scheduling_policy == RATE_MONOTONIC) && (thread->dynamic_priority == thread->static_priority)) {
+            thread_set_dynamic_priority(thread, THREAD_PRIORITY_BACKGROUND);
+        }
+    } else if (thread->miss_policy == DeadlineMissEnd) {
+        thread_redirect_end(index);
+    }
+    return 1;
+}
+
+/**
+ * Marks the current job of the running thread as complete (called when it yields) and records how late it was.
+ * A demoted thread returns to its own priority now that its late job is done.
+ */
+void deadline_job_complete() {
+    tcb_t* thread = &user_threads[active_thread_index];
+    if (TIMESLOT_BEFORE(thread->job_deadline, global_timeslot_counter)) {
+        thread->max_lateness = MAX(thread->max_lateness, global_timeslot_counter - thread->job_deadline);
+    }
+    thread->job_pending = 0;
+    thread->job_skipped = 0;
+
+    if (thread->demoted) {
+        thread->demoted = 0;
+        if (scheduling_policy == RATE_MONOTONIC) {
+            if (thread->dynamic_priority == THREAD_PRIORITY_BACKGROUND) {
+                thread_set_dynamic_priority(thread, thread->static_priority);
+            }
+        } else {
+            thread_set_deadline(thread, thread->next_release);
+        }
+    }
+}
+
+/**
+ * Called from the SysTick handler once per scheduling period (see scheduler_advance).
+ */
+uint32_t scheduler_tick() {
+    return scheduler_advance(1);
+}
+
+/**
+ * Charges `timeslots` elapsed periods to the running thread (total active time and remaining work of the current period) and advances the global timeslot counter by the same amount.
+ * Releases only the threads at the head of the release queue whose next_release is due (re-arming their work and re-inserting them one period later) so a tick without releases costs the same regardless of the number of threads.
+ * The elapsed periods are split at every release so that the budget re-armed by a release is charged exactly as it would be with one tick per period (the cost only depends on the number of releases and not the number of periods).
+ * Returns 1 if the running thread exhausted its budget or a released thread has a higher priority than the running one (a scheduling decision is needed) and 0 if the running thread can simply continue.
+ */
+uint32_t scheduler_advance(uint32_t timeslots) {
+    tcb_t* running = &user_threads[active_thread_index];
+    uint32_t reschedule = 0;
+
+    while (timeslots > 0) {
+        // Only advance up to the next release (the remaining periods are charged after the release is applied)
+        uint32_t step = timeslots;
+        uint8_t first = release_queue_first();
+        if ((first != RELEASE_QUEUE_END) && TIMESLOT_BEFORE(global_timeslot_counter, user_threads[first].next_release)) {
+            step = MIN(step, user_threads[first].next_release - global_timeslot_counter);
+        }
+        timeslots -= step;
+
+        // Charge the running thread for these timeslots (idle thread has no budget to exhaust)
+        global_timeslot_counter += step;
+        running->active_time += step;
+        if ((active_thread_index != num_user_threads) && (running->remaining_work > 0)) {
+            running->remaining_work -= MIN(step, running->remaining_work);
+            if (running->remaining_work == 0) {
+                reschedule = 1;
+            }
+        }
+
+        // Release every thread whose period starts at this timeslot
+        // Waiting threads become ready again, while blocked threads keep waiting on their lock (they are made ready by the unlock that frees them) but still receive their new budget
+        // Servers waiting for an event only receive their new budget (the release is also when the kernel checks for input on behalf of servers waiting on stdin)
+        while ((release_queue_first() != RELEASE_QUEUE_END) && !TIMESLOT_BEFORE(global_timeslot_counter, user_threads[release_queue_first()].next_release)) {
+            uint8_t index = release_queue_first();
+            tcb_t* released = &user_threads[index];
+            release_queue_remove(index);
+
+            released->next_release += released->t;
+            if (deadline_check(index)) {
+                released->remaining_work = released->c;
+            }
+            thread_set_deadline(released, released->next_release + (released->demoted ? DEMOTED_DEADLINE_OFFSET : 0)); // Deadline of the new instance is the start of the following period
+            release_queue_insert(index);
+
+            trace_record(TRACE_RELEASE, index, released->next_release - released->t);
+
+            if ((released->event_mask & SERVER_EVENT_STDIN) && (rtt_peek() > 0) && server_signal(index, SERVER_EVENT_STDIN)) {
+                reschedule = 1;
+            }
+            // A thread that used up its budget stays waiting through a skipped release (it has no budget to run with until the next one)
+            if ((released->state == ThreadWaiting) && (released->event_mask == 0) && (released->remaining_work > 0)) {
+                thread_set_state(released, ThreadReady);
+                if (release_preempts(released, running)) {
+                    reschedule = 1;
+                }
+            }
+        }
+    }
+
+    return reschedule;
+}
+
+/// Largest number of timeslots that a single tickless compare is allowed to span (keeps the compare value within half of the 32 bit TIMER2 range so that wrap-safe comparisons hold)
+uint32_t tickless_max_timeslots;
+
+/// Number of TIMER2 counts that make up a single timeslot in tickless mode
+uint32_t tickless_timeslot_counts;
+
+/// TIMER2 count at which the timeslot given by global_timeslot_counter started in tickless mode (advanced by whole timeslots so no time is lost to rounding)
+uint32_t tickless_timeslot_start;
+
+/// Timing mode selected in the last call to multitask_start
+tick_mode timing_mode = PERIODIC_TICK;
+
+/**
+ * Brings the global timeslot counter up to date in tickless mode by charging every timeslot boundary that TIMER2 passed since the last update.
+ * Each boundary is charged to the running thread (the same thread that a periodic tick at that boundary would have charged) so this must be called before every context switch.
+ * Returns a nonzero value if the elapsed timeslots require a new scheduling decision (see scheduler_advance).
+ * Interrupts are disabled so that the TIMER2 handler cannot charge the same timeslots a second time while they are being accounted for.
+ */
+uint32_t tickless_catch_up() {
+    disable_interrupts();
+    uint32_t reschedule = 0;
+    uint32_t elapsed = (timer2_now() - tickless_timeslot_start) / tickless_timeslot_counts;
+    if (elapsed > 0) {
+        tickless_timeslot_start += elapsed * tickless_timeslot_counts;
+        reschedule = scheduler_advance(elapsed);
+    }
+    enable_interrupts();
+    return reschedule;
+}
+
+/**
+ * Programs the TIMER2 compare for the next scheduling event in tickless mode (the earlier of the next release and the timeslot where the running thread exhausts its budget).
+ * If the event is already reached by the time the compare is loaded, the TIMER2 interrupt is pended manually (otherwise it would not fire until the counter wraps).
+ */
+void tickless_program_next() {
+    uint32_t timeslots = tickless_max_timeslots;
+    uint8_t first = release_queue_first();
+    if (first != RELEASE_QUEUE_END) {
+        timeslots = MIN(timeslots, user_threads[first].next_release - global_timeslot_counter);
+    }
+
+    // The idle and main thread have no budget to exhaust
+    tcb_t* running = &user_threads[active_thread_index];
+    if ((active_thread_index < num_user_threads) && (running->state == ThreadRunning) && (running->remaining_work > 0)) {
+        timeslots = MIN(timeslots, running->remaining_work);
+    }
+
+    uint32_t target = tickless_timeslot_start + MAX(timeslots, 1)*tickless_timeslot_counts;
+    timer2_compare(target);
+    if ((int32_t)(target - timer2_now()) <= 0) {
+        *(volatile uint32_t *)NVIC_ISPR0_ADDR = (1 << TIMER2_IRQ);
+    }
+}
+
+/**
+ * Handles a tickless scheduling event (replacing the SysTick handler for this mode).
+ * Assert the preempt flag (as the SysTick handler would) only if the accounted timeslots changed who should be running.
+ */
+void tickless_event() {
+    // Ignore an event left pending after multitask_start stopped the timer
+    if (timing_mode != TICKLESS) {
+        return;
+    }
+
+    if (tickless_catch_up()) {
+        preemption_flag = 1;
+        set_pendsv();
+    }
+    tickless_program_next();
+}
+
+/**
+ * Brings the global timeslot counter up to date before it is read or before a scheduling decision is made (only needed in tickless mode since the periodic tick always keeps it current).
+ */
+void scheduler_sync_time() {
+    if ((timing_mode == TICKLESS) && tickless_catch_up()) {
+        preemption_flag = 1;
+        set_pendsv();
+    }
+}
+
 /**
  * Helper function for determining if the current thread holds any locks.
  * Returns a boolean value (0 false / 1 true) indicating if locks are held by the active thread at the point of invoking this function
  */
 uint32_t active_thread_holds_locks() {
-    // Sweep through the user lock fields and look for any locks that the active thread is the current locker of
-    for (uint8_t index = 0; index < num_defined_locks; index++) {
-        if (user_locks[index].current_locker == &user_threads[active_thread_index]) {
-            return 1;
-        }
+    return user_threads[active_thread_index].held_top != LOCK_STACK_END;
+}
+
+/**
+ * Charges the cycles since `start` (sampled on entry to PendSV_C_Handler) to the kernel and restarts the sample for the thread that is about to run.
+ */
+void scheduler_cycles_charge(uint32_t start) {
+    uint32_t now = cycle_count();
+    kernel_cycles += now - start;
+    cycle_last_sample = now;
+}
+
+/**
+ * Stops the SysTick timer (or TIMER2 if tickless) once every user thread has terminated and the main thread is switched back in.
+ */
+void multitask_timers_stop() {
+    systick_disable();
+    if (timing_mode == TICKLESS) {
+        timer2_stop();
+        timing_mode = PERIODIC_TICK;
     }
-    return 0;
+}
+
+/**
+ * Points switch_frame_limit at the process stack limit of the thread that just became active.
+ */
+static void switch_frame_limit_update() {
+    switch_frame_limit = (active_thread_index < num_user_threads+1) ? user_threads[active_thread_index].limit_process_stack : NULL;
+}
+
+/**
+ * Entered from PendSV_Handler instead of PendSV_C_Handler when the switch frame of the outgoing thread would not fit above switch_frame_limit (`psp` is its PSP and nothing was pushed yet).
+ * The stacks are packed next to each other so pushing the frame would have overwritten the stack of another thread, and the application is ended like for any other overflow.
+ */
+void PendSV_Overflow_C_Handler(void* psp) {
+    printk("PendSV found that user thread with ID %d has no room for its switch frame below psp 0x%x (overflow of process stack)\n", user_threads[active_thread_index].id, (uint32_t)psp);
+    syscall_exit(THREAD_MEMORY_OUT_OF_BOUNDS_ACCESS);
 }
 
 /**
  * Continues to service the PendSV interrupt after the assembly-level interrupt has finished.
- * Accepts a pointer to a main stack frame with all needed information (expected to be called from the assembly-level PendSV_Handler which merely prepares the stack prior to this function being invoked).
+ * Accepts the PSP of the outgoing thread pointing at its switch_stackframe_t (expected to be called from the assembly-level PendSV_Handler which merely prepares the stack prior to this function being invoked).
  * Performs the essential acts of context switching and runs the global scheduler.
- * Returns a pointer to the new MSP of the task to be run (can restore context from this in the assembly handler)
+ * Returns the saved PSP of the task to be run (can restore context from this in the assembly handler)
+ * PendSV has the same priority as every other handler so it only runs once no handler is active (no thread has anything left on the shared kernel stack at this point).
  */
-void* PendSV_C_Handler(void* msp) {
+void* PendSV_C_Handler(void* psp) {
     // Clear signal for handler (not technically necessary since it is automatically cleared but it makes me feel good)
     clr_pendsv();
 
-    // Check if this scheduling decision was made as a result of preemption (if yes charge the time to the current thread - if no do not charge the time yet for both total time active and remaining work)
+    // Account the locks that the outgoing thread took or released in user space before the scheduler looks at them
+    // A thread that broke the lock words is only made to call thread_end once it runs again (ending it here would free its stack and reorder the priorities in the middle of the switch)
+    if (lock_fast_sync() && (active_thread_index < num_user_threads)) {
+        thread_redirect_end(active_thread_index);
+    }
+
+    // Charge the outgoing thread for every cycle since it was switched in (interrupt handlers already moved the sample past the cycles they took)
+    uint32_t switch_start = cycle_count();
+    user_threads[active_thread_index].cycles += switch_start - cycle_last_sample;
+
+    // In tickless mode the timeslots that passed since the last event have not been charged yet (charge them to the outgoing thread before deciding)
+    if ((timing_mode == TICKLESS) && tickless_catch_up()) {
+        preemption_flag = 1;
+    }
+
+    // Check if this scheduling decision was made as a result of preemption (time was already charged to the current thread by scheduler_tick in the SysTick handler)
     // Thread will not be in ThreadRunning state if this was not a result of preemption (so scheduler can work as needed)
-    // Decrement the remaining work of the current task (assuming it is not the idle thread)
     // Only change thread back to ready if it is still in running state and there is more work to do (i.e. not done for this period and not defunct/ended) 
     // Thread becomes waiting if computation time for this thread is exhausted
     if (preemption_flag) {
-        global_timeslot_counter++; // Only increment global counter if this was a result of preempt (counting time instead of raw number of decision)
-        user_threads[active_thread_index].active_time++; // Charge active time (total time)
-
-        // Decrement except for the idle thread (just put idle thread back in ready)
-        // Check to see if the thread should actually be waiting instead
-        if (active_thread_index != num_user_threads) {
-            user_threads[active_thread_index].remaining_work--;
-        } 
-
         // Mark as waiting instead if all of the computation for this period was finished
         // Else say it can run again
-        if (user_threads[active_thread_index].remaining_work == 0) { 
-            user_threads[active_thread_index].state = ThreadWaiting; 
+        // A thread that already blocked, yielded, or ended right before the tick keeps the state it chose
+        thread_state current_state = user_threads[active_thread_index].state;
+        if ((current_state != ThreadRunning) && (current_state != ThreadReady)) {
+            // Nothing to change
+        } else if (user_threads[active_thread_index].remaining_work == 0) { 
+            thread_set_state(&user_threads[active_thread_index], ThreadWaiting);
+
+            // A periodic thread that has to be stopped by the scheduler overran its budget (a server running out of budget is expected)
+            if (!user_threads[active_thread_index].server) {
+                user_threads[active_thread_index].overruns++;
+                trace_record(TRACE_OVERRUN, active_thread_index, user_threads[active_thread_index].overruns);
+            }
 
             // Check if thread held locks when it got put into waiting
             if (active_thread_holds_locks()) {
                 printk("Thread with ID %d elapsed computation time while holding a lock\n", user_threads[active_thread_index].id);
             }
         } else {
-            user_threads[active_thread_index].state = ThreadReady;
+            thread_set_state(&user_threads[active_thread_index], ThreadReady);
         }
     }
 
-    // Run scheduler to figure out which index in user_threads should be scheduled next (according to RMS)
-    uint32_t next_index = schedule_rms();
-    preemption_flag = 0; // Reset flag (now that it is no longer needed for scheduling to reduce time until next release)
+    // Run scheduler to figure out which index in user_threads should be scheduled next (according to the policy chosen in multitask_request)
+    uint32_t next_index = (scheduling_policy == EARLIEST_DEADLINE_FIRST) ? schedule_edf() : schedule_rms();
+    preemption_flag = 0; // Reset flag (now that it is no longer needed for deciding the state of the preempted thread)
 
     // Skip TCB context saving / restoring if next_index == active_thread_index (i.e. rescheduling same thread)
     if (next_index == active_thread_index) {
-        user_threads[active_thread_index].state = ThreadRunning; // Change the thread back to running
-        return msp; // Just return the MSP that was just passed in (nothing to change)
+        thread_set_state(&user_threads[active_thread_index], ThreadRunning); // Change the thread back to running
+        if (timing_mode == TICKLESS) tickless_program_next(); // Budget of the running thread may have changed
+        scheduler_cycles_charge(switch_start);
+        return psp; // Just return the PSP that was just passed in (nothing to change)
     }
 
     // Save current context to the active TCB then switch to new TCB based on next_index returned from scheduling policy
-    // Construct a stack frame at MSP arguement so that PSP value can be retrieved and stored in the TCB
-    main_stackframe_t* frame = (main_stackframe_t*)(msp);
-    user_threads[active_thread_index].psp = (void*)frame->psp;
-    user_threads[active_thread_index].msp = msp;
-    user_threads[active_thread_index].svc_status = get_svc_status(); // Save current svc status based on register value
+    // The registers are already on the process stack of the outgoing thread so only its PSP is kept
+    user_threads[active_thread_index].psp = psp;
+    trace_record(TRACE_SWITCH_OUT, active_thread_index, user_threads[active_thread_index].state);
 
     // Restore context of the new thread (from when it was saved on its TCB)
     active_thread_index = next_index;
-    user_threads[active_thread_index].state = ThreadRunning;
-    set_svc_status(user_threads[active_thread_index].svc_status);
+    switch_frame_limit_update();
+    if (active_thread_index == num_user_threads+1) {
+        multitask_timers_stop();
+    }
+    trace_record(TRACE_SWITCH_IN, active_thread_index, 0);
+    thread_set_state(&user_threads[active_thread_index], ThreadRunning);
 
-    // If performing thread-wise protection, disable the old stack protection region for the old thread and re-enable it with the current thread
+    // If performing thread-wise protection, replace the stack protection region of the old thread with the one precomputed for the current thread
     // Only try to set up the protection region for an actual user defined thread (not main)
     if (protection_status == THREAD_PROTECT && active_thread_index < num_user_threads+1) {
-        mpu_thread_region_disable();
-        mpu_kernel_region_disable();
-        void* process_stack_limit = user_threads[active_thread_index].limit_process_stack;
-        void* kernel_stack_limit = user_threads[active_thread_index].limit_main_stack;
-        uint32_t stack_size = (uint32_t)user_threads[active_thread_index].base_process_stack - (uint32_t)process_stack_limit; // Size is the same for both stacks
-        
-        // Enable MPU regions for only this thread's stacks
-        mpu_thread_region_enable(process_stack_limit, stack_size);
-        mpu_kernel_region_enable(kernel_stack_limit, stack_size);
+        mpu_stack_region_load(&user_threads[active_thread_index].stack_region);
     }
-    
-    return user_threads[active_thread_index].msp; // Return pointer to the new MSP to have registers popped off of it
+
+    // Next tickless event depends on the budget of the thread that was just switched in
+    if (timing_mode == TICKLESS) {
+        tickless_program_next();
+    }
+
+    scheduler_cycles_charge(switch_start);
+    switch_cycles_last = cycle_last_sample - switch_start;
+    return user_threads[active_thread_index].psp; // Return pointer to the new PSP to have registers popped off of it
+}
+
+/**
+ * Returns the index of a ready thread that was demoted to the background after a deadline miss (or the idle thread if there is none).
+ * Demoted threads are not tracked by the ready bitmap so this sweeps the threads, but only when no other thread is ready.
+ */
+uint32_t schedule_background() {
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if ((user_threads[index].state == ThreadReady) && (user_threads[index].dynamic_priority == THREAD_PRIORITY_BACKGROUND)) {
+            return index;
+        }
+    }
+    return num_user_threads;
 }
 
 /**
  * Scheduling policy using RMS that returns the index in the user_threads array of the next task to be scheduled.
- * Sweeps through the user_threads array and determines the highest priority task (including the idle thread) that is ready to run.
- * Also performs bookkeeping related to maintaining the number of scheduling cycles until a waiting task can be made ready again (i.e. only consider tasks that are ThreadReady but change thread from ThreadWaiting to ThreadReady when time_until_release = 0).
- * Maintain periodic behavior by incrementing time_until_release by thread period every time it equals 0 and by decrementing remaining_work for every cycle the current task is scheduled (reset to computation time upon reaching 0).
+ * The highest priority ready task is found in constant time from the two level ready bitmap (a CLZ on the summary word and one on the word it selects give the highest dynamic priority level with a ready thread) with a demoted thread or the idle thread returned if no level is set.
+ * Periodic releases are not handled here but by scheduler_tick (which moves waiting threads back to ready through the release queue before the decision is pended).
  */
 uint32_t schedule_rms() {
-    // Maintain highest priority that is currently schedulable (and keep track of what index this TCB corresponds to)
-    // Set initial state as the idle thread (so if no other thread is schedulable this is returned)
-    uint32_t highest_priority = 0xFFFFFFFF;
-    uint32_t next_index = num_user_threads;
+    // Check if all tasks have exited (return main in this case)
+    if (num_active_threads == 0) {
+        return num_user_threads+1;
+    }
 
+    // Schedule a demoted thread or the idle thread if no other thread is ready
+    // Otherwise the most significant set bit of the summary is the highest word with a ready level, and the most significant set bit of that word is the highest dynamic priority with a ready thread
+    if (ready_bitmap_summary == 0) {
+        return schedule_background();
+    }
+    uint32_t word = count_leading_zeros(ready_bitmap_summary);
+    return ready_thread_index[word*32 + count_leading_zeros(ready_bitmap[word])];
+}
+
+/**
+ * Scheduling policy using EDF that returns the index in the user_threads array of the next task to be scheduled.
+ * Locks follow the stack resource policy: the ready thread with the earliest deadline only starts if its preemption level (static priority - ordered by period like RMS) is strictly above the current global priority ceiling.
+ * The holder of the lock that set the ceiling is always allowed to continue (since every lock is nested within the critical sections of the threads it preempted, the ceiling only drops back once it unlocks).
+ * A thread that is held back sets the contended bit of that lock, so the unlock that lowers the ceiling always enters the kernel and lets the held back thread start.
+ * This way a thread is blocked at most once and only before it starts, so a thread that is running can always acquire the locks it asks for without waiting.
+ */
+uint32_t schedule_edf() {
     // Check if all tasks have exited (return main in this case)
     if (num_active_threads == 0) {
         return num_user_threads+1;
     }
 
-    // Loop through each index in user_threads and determine what the highest priority task is (ignoring defunct threads)
-    // Perform bookkeeping as needed to maintain periodic nature for each task
-    for (uint8_t index = 0; index < num_user_threads; index++) {
-        if (user_threads[index].state == ThreadDefunct) {continue;}
-        
-        // Check if the current task has higher priority than the highest seen
-        // Use ID as tie-breaker in the event of equal priority
-        if ((user_threads[index].state == ThreadReady) && (user_threads[index].dynamic_priority < highest_priority)) {
-            // New task guranteed to be more important
-            highest_priority = user_threads[index].dynamic_priority;
-            next_index = index;
-        }
-
-        // Decrement the time until release of all active threads if they are not defunct (and this was a preempt round)
-        // Reset next period of any tasks that have reached their release point (in time for scheduling decision)
-        // Set time until release equal to period and reset the amount of work to do (also mark this thread as being schedulable in a future decision)
-        if (preemption_flag) {
-            user_threads[index].time_until_release--;
-            if (user_threads[index].time_until_release == 0) {
-                user_threads[index].time_until_release = user_threads[index].t;
-                user_threads[index].remaining_work = user_threads[index].c;
-                user_threads[index].state = ThreadReady;
-            }
+    // Take the earliest deadline that passes the preemption test (usually the head of the queue)
+    // A thread held back by the ceiling marks the lock that set it as contended, so that its holder unlocks it through the kernel (which reschedules) instead of the user-space fast path
+    for (uint8_t index = edf_ready_head; index != READY_QUEUE_END; index = user_threads[index].ready_next) {
+        if ((user_threads[index].static_priority < global_priority_ceiling) || (highest_priority_lock->current_locker == &user_threads[index])) {
+            return index;
         }
+        lock_shared.contended |= lock_bit(highest_priority_lock);
     }
 
-    return next_index;
+    // Schedule the idle thread if no other thread is ready
+    return num_user_threads;
 }
 
-/// External user space declaration for making the svc call to thread_end (should be what is called when user space function end)
-extern void thread_end();
-
 /**
- * Helper function that constructs a default user-level stack frame on the PSP to allow this thread to be cleanly scheduled (mirrors the contents of the stack frame as if this thread moved to handler execution).
+ * Helper function that constructs a default user-level stack frame on the PSP to allow this thread to be cleanly scheduled (mirrors the contents of the stack frame as if this thread moved to handler execution and was then switched out by PendSV_Handler).
  * Sets registers to expecting default values based on the values of `fn` and arg` at `index` in user_threads.
  */
 void thread_function_define(void *fn, void *arg, uint8_t index) {
-    // Construct custom stack frames at MSP and PSP such that registers hold expected values for when this thread is scheduled
+    // Construct custom stack frames on the PSP such that registers hold expected values for when this thread is scheduled
     // This allows the new thread to be scheduled like expected (i.e. pushing and popping values off stacks)
     // Start with initial PSP frame
     stack_frame_t* custom_user_frame = (stack_frame_t*)(user_threads[index].base_process_stack);
@@ -208,11 +802,13 @@ void thread_function_define(void *fn, void *arg, uint8_t index) {
     custom_user_frame->pc = (uint32_t)fn | 1; // Set PC as function pointer with a bitwise or 1 to indicate execution in thumb mode
     custom_user_frame->xpsr = 0x01000000;
 
-    // Define initial MSP frame
-    main_stackframe_t* custom_kernel_frame = (main_stackframe_t*)(user_threads[index].base_main_stack);
-    custom_kernel_frame--; // Decrement so that a frame is actually being constructed in the correct slot instead of in the slot immediately below where desired
+    // Define initial switch frame directly below the hardware frame
+    // New threads have not touched the FPU so only the integer part of the frame is constructed
+    switch_stackframe_t* custom_kernel_frame = (switch_stackframe_t*)((uint32_t)custom_user_frame - SWITCH_STACKFRAME_BASIC_SIZE);
+
+    // Paint everything below the initial frames so that the high-water mark only counts what the thread actually uses
+    stack_paint(user_threads[index].limit_process_stack, custom_kernel_frame);
     
-    custom_kernel_frame->psp = (uint32_t)custom_user_frame; // Place new PSP address in the first slow of kernel frame
     custom_kernel_frame->r4 = 0; // Don't care
     custom_kernel_frame->r5 = 0; 
     custom_kernel_frame->r6 = 0; 
@@ -221,19 +817,71 @@ void thread_function_define(void *fn, void *arg, uint8_t index) {
     custom_kernel_frame->r9 = 0; 
     custom_kernel_frame->r10 = 0; 
     custom_kernel_frame->r11 = 0; 
-    custom_kernel_frame->lr = 0xfffffffd; // Assume uesr thread starts out in unpriviledged thread mode (initially)
+    custom_kernel_frame->lr = EXC_RETURN_THREAD_PSP; // Assume uesr thread starts out in unpriviledged thread mode (initially) with a basic frame (no FP context until the thread uses the FPU)
 
-    // Update PSP and MSP after decrement (pointing to the top of the new stack frame - lowest address)
-    // This may not be strictly necessary with the handler but it is nice to know the struct is self consistent
-    user_threads[index].psp = (void*)custom_user_frame;
-    user_threads[index].msp = (void*)custom_kernel_frame;
+    // Update PSP after decrement (pointing to the top of the switch frame - lowest address - where PendSV_Handler starts popping)
+    user_threads[index].psp = (void*)custom_kernel_frame;
 }
 
-/// External symbol for accessing base of thread user stacks (linker script symbol)
-extern uint32_t __thread_user_stacks_base;
+/**
+ * Precomputes the MPU region covering only the user stack of the thread at `index` (loaded by PendSV_C_Handler under THREAD_PROTECT).
+ * Encoding once here keeps the size computation and validation of mpu_region_enable out of every context switch.
+ * Stacks are placed by stack_alloc so that each one lines up with the subregions of a single region (the subregions outside of the stack are disabled).
+ */
+void thread_stack_region_define(uint8_t index) {
+    tcb_t* thread = &user_threads[index];
+    uint32_t stack_size = (uint32_t)thread->base_process_stack - (uint32_t)thread->limit_process_stack;
+    mpu_subregion_encode(&thread->stack_region, MPU_THREAD_STACK_REGION, thread->limit_process_stack, stack_size, 0, 1);
+}
+
+/**
+ * Allocates a user stack of `stack_bytes` (already rounded by stack_size_round) for the thread at `index` and resets its stack pointer to the new base.
+ * Returns 0 (leaving the TCB untouched) if the stack area has no room left.
+ */
+uint32_t thread_stack_alloc(uint8_t index, uint32_t stack_bytes) {
+    void* process_limit = stack_alloc(&thread_user_stack_area, stack_bytes);
+    if (process_limit == NULL) {
+        return 0;
+    }
+
+    tcb_t* thread = &user_threads[index];
+    thread->limit_process_stack = process_limit;
+    thread->base_process_stack = (void*)((uint32_t)process_limit + stack_bytes);
+    thread->psp = thread->base_process_stack;
+    return 1;
+}
+
+/**
+ * Returns the user stack of the thread at `index` to the stack area (the TCB keeps no stack until it is defined again).
+ */
+void thread_stack_free(uint8_t index) {
+    tcb_t* thread = &user_threads[index];
+    uint32_t stack_bytes = (uint32_t)thread->base_process_stack - (uint32_t)thread->limit_process_stack;
+    stack_free(&thread_user_stack_area, thread->limit_process_stack, stack_bytes);
+    thread->base_process_stack = NULL;
+    thread->limit_process_stack = NULL;
+}
+
+/// External symbol for accessing the limit of thread user stacks (linker script symbol)
+extern uint32_t __thread_user_stacks_limit;
+
+/// External symbol for accessing the base of thread user stacks (linker script symbol - the size of the area is set by THREAD_STACKS in the Makefile)
+extern uint32_t __thread_user_stacks_base;
+
+/// Size of the area shared by the thread user stacks (a power of two so that KERNEL_PROTECT can cover it with a single region)
+#define THREAD_STACK_AREA_SIZE ((uint32_t)&__thread_user_stacks_base - (uint32_t)&__thread_user_stacks_limit)
+
+/// External symbol for accessing the limit of the kernel stack shared by every thread (linker script symbol)
+extern uint32_t __kernel_main_stack_limit;
+
+/// External symbol for accessing the base of the kernel stack shared by every thread (linker script symbol)
+extern uint32_t __kernel_main_stack_base;
+
+/// Bytes left between the current kernel stack pointer and the part of the kernel stack painted by multitask_request (room for the rest of this syscall)
+#define KERNEL_STACK_PAINT_MARGIN (256)
 
-/// External symbol for accessing base of thread main stacks (linker script symbol)
-extern uint32_t __thread_kernel_stacks_base;
+/// Size of the stacks of the idle thread and of threads defined without an explicit stack size (stack_bytes of multitask_request rounded by stack_size_round)
+uint32_t default_stack_bytes;
 
 /// External user space default idle function (used in the case that idle_function is null in multitask_request)
 extern void default_idle();
@@ -244,81 +892,222 @@ uint8_t multitask_request_called = 0;
 /// Boolean flag for determining if thread_define was called at least once before multitask_start is called
 uint8_t thread_define_called = 0;
 
+/// Boolean flag for determining if multitask_start validated the locks (threads admitted from then on are analysed with their blocking time)
+uint8_t multitask_start_called = 0;
+
+/// Response time returned by response time analysis when a thread can miss its deadline
+#define RESPONSE_TIME_UNSCHEDULABLE (0xFFFFFFFF)
+
+/**
+ * Returns 1 if `a` has a higher RMS priority than `b` (lower period with ties going to the lower ID - the ordering kept in priority_order).
+ * Compares the parameters directly so that it also holds for a thread that has not been assigned a static priority yet.
+ */
+uint32_t rms_higher_priority(tcb_t* a, tcb_t* b) {
+    return (a->t < b->t) || ((a->t == b->t) && (a->id < b->id));
+}
+
+/**
+ * Computes the worst case response time of the thread at `index` under RMS with the given `blocking` time (exact response time analysis for implicit deadlines).
+ * Iterates R = c + blocking + sum(ceil((R + j_j) / t_j) * c_j) over every higher priority thread j until R stops changing (the active threads plus the thread at `candidate_index` which may still be defunct while it is being admitted).
+ * The jitter j_j is zero for periodic threads and t_j - c_j for servers (a deferrable server can spend its budget at the very end of one period and again at the start of the next).
+ * Returns RESPONSE_TIME_UNSCHEDULABLE as soon as R exceeds the period (the iteration is monotonic so it could only grow further).
+ */
+uint32_t rms_response_time(uint8_t index, uint8_t candidate_index, uint32_t blocking) {
+    tcb_t* thread = &user_threads[index];
+    uint32_t response = thread->c + blocking;
+    while (1) {
+        uint32_t next_response = thread->c + blocking;
+        for (uint8_t other_index = 0; other_index < num_user_threads; other_index++) {
+            tcb_t* other = &user_threads[other_index];
+            if ((other_index == index) || ((other->state == ThreadDefunct) && (other_index != candidate_index)) || !rms_higher_priority(other, thread)) continue;
+            uint32_t jitter = other->server ? (other->t - other->c) : 0;
+            next_response += ((response + jitter + other->t - 1) / other->t) * other->c;
+        }
+
+        if (next_response > thread->t) {
+            return RESPONSE_TIME_UNSCHEDULABLE;
+        }
+        if (next_response == response) {
+            return response;
+        }
+        response = next_response;
+    }
+}
+
+/**
+ * Returns 1 if the priority ceiling of the lock `m` is at or above the priority of the thread at `index` (the active threads plus the thread at `candidate_index`, which may not have a static priority yet).
+ * The ceiling is compared through the highest locker of `m` so that it also holds for a candidate. A lock whose highest locker has ended keeps a level that no longer names a thread, so it is counted for every thread.
+ */
+uint32_t lock_ceiling_covers(mutex_t* m, uint8_t index, uint8_t candidate_index) {
+    for (uint8_t locker_index = 0; locker_index < num_user_threads; locker_index++) {
+        tcb_t* locker = &user_threads[locker_index];
+        if (((locker->state == ThreadDefunct) && (locker_index != candidate_index)) || (locker->id != m->highest_locker_id)) continue;
+        return (locker_index == index) || rms_higher_priority(locker, &user_threads[index]);
+    }
+    return 1;
+}
+
+/**
+ * Returns the longest time that the thread at `index` can be blocked under the priority ceiling protocol (the active threads plus the thread at `candidate_index`).
+ * A thread is blocked at most once, for a single critical section of a lower priority thread on a lock whose priority ceiling is at or above its own priority, so the bound is the longest such critical section.
+ * Each lock bounds its critical sections by the length given to lock_init (a lower priority thread can never hold it for longer than its own budget, which is also the bound for a lock given no length).
+ */
+uint32_t pcp_blocking_time(uint8_t index, uint8_t candidate_index) {
+    // Nothing can block the lowest priority thread
+    uint32_t lower_budget = 0;
+    for (uint8_t other_index = 0; other_index < num_user_threads; other_index++) {
+        tcb_t* other = &user_threads[other_index];
+        if ((other_index == index) || ((other->state == ThreadDefunct) && (other_index != candidate_index)) || !rms_higher_priority(&user_threads[index], other)) continue;
+        lower_budget = MAX(lower_budget, other->c);
+    }
+    if (lower_budget == 0) {
+        return 0;
+    }
+
+    uint32_t blocking = 0;
+    for (uint8_t lock_index = 0; lock_index < num_defined_locks; lock_index++) {
+        if (!lock_ceiling_covers(&user_locks[lock_index], index, candidate_index)) continue;
+        uint32_t critical_section = user_locks[lock_index].critical_section;
+        blocking = MAX(blocking, ((critical_section == 0) || (critical_section > lower_budget)) ? lower_budget : critical_section);
+    }
+    return blocking;
+}
+
+/**
+ * Admission control for RMS when the thread at `candidate_index` is added to the active threads (its c, t, and id must already be filled in).
+ * Every thread at or below the priority of the candidate gets more interference so the response time of each active thread is recomputed.
+ * Blocking is ignored until multitask_start has validated the locks (it repeats the analysis with blocking then) and is included for threads admitted afterwards, so they keep the guarantee that multitask_start proved.
+ * The response times are only stored if every thread still meets its deadline. Returns 1 if the candidate can be admitted and 0 otherwise.
+ */
+uint32_t rms_admit(uint8_t candidate_index) {
+    uint32_t response[MAX_NUM_THREADS];
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if ((user_threads[index].state == ThreadDefunct) && (index != candidate_index)) continue;
+        uint32_t blocking = multitask_start_called ? pcp_blocking_time(index, candidate_index) : 0;
+        response[index] = rms_response_time(index, candidate_index, blocking);
+        if (response[index] == RESPONSE_TIME_UNSCHEDULABLE) {
+            return 0;
+        }
+    }
 
-/// RMS tight bounds for admission control (used to see if a new task can be safely admitted in thread_define)
-float util_bound[] = {
-    0.000, 1.000, .8284, .7798, .7568, .7435, .7348, .7286,
-    .7241, .7205, .7177, .7155, .7136, .7119, .7106, .7094
-};
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if ((user_threads[index].state == ThreadDefunct) && (index != candidate_index)) continue;
+        user_threads[index].response_time = response[index];
+    }
+    return 1;
+}
 
 /**
- * Returns an error code if the allocated space of the request would be larger than 32kB of stack space (or if the number of threads exceeds 14)
- * Otherwise, this implementation sets up the requested stacks by taking slices starting from the base addresses (i.e. stack pointer decreasing from the base_addr - growing down for each num_thread).
- * Transforms the request `stack_bytes` into the next highest power of 2 (ceiling) so that the stacks stay well aligned and behaved.
- * This transformation may result in a rejection of parameters if they are at (but not exactly at the limit) of stack space (i.e. would not be rejected without rounding).
+ * Returns an error code if a single stack of `stack_bytes` would be larger than the thread stack area (or if the number of threads exceeds MAX_NUM_THREADS)
+ * Otherwise, this implementation allocates the stacks of the idle thread and keeps `stack_bytes` as the default size for threads that do not specify their own (stacks of the user threads are only allocated once they are defined).
+ * Rounds `stack_bytes` up to a multiple of an eighth of the next power of two (see stack_size_round) so that each stack can still be covered by a single MPU region.
  * Also configures memory regions to prevent unwanted access according to `mpu_protect` policy.
  * Additionally initializes empty mutex_t structs in the global `user_locks` (one empty struct per num_locks specified by user)
+ * The scheduling `policy` is fixed from this point on since it decides the admission test applied in thread_define.
  */
-int syscall_multitask_request(uint32_t num_threads, uint32_t stack_bytes, void* idle_function, mpu_mode mpu_protect, uint32_t num_locks) {
+int syscall_multitask_request(uint32_t num_threads, uint32_t stack_bytes, void* idle_function, mpu_mode mpu_protect, uint32_t num_locks, sched_policy policy) {
     // Do not allow repeat multitask request call
     if (multitask_request_called) {
         return MULTITASK_REQUEST_REPEATED;
     }
-    // Round stack bytes to the nearest power of two
+    // Round stack bytes up to a size that can be covered exactly with MPU subregions
     // Parition the idle thread in the user space
-    uint32_t stack_bytes_aligned = 1 << ceil_log2(stack_bytes);
+    uint32_t stack_bytes_rounded = stack_size_round(stack_bytes);
     uint32_t num_threads_plus_idle = num_threads+1;
 
     // Check if modified parameters are feasible
     // Check if the number of requested locks is greater than the maximum number of available locks
     // Num_threads cannot be greater than the max or 0 and stack size cannot be greater than the max or 0
-    if ((num_threads > MAX_NUM_THREADS) || (num_threads == 0) || ((stack_bytes_aligned * num_threads_plus_idle) > MAX_TOTAL_THREAD_STACK_SIZE) || (num_locks > MAX_USER_LOCKS)) {
+    if ((num_threads > MAX_NUM_THREADS) || (num_threads == 0) || (stack_bytes == 0) || (stack_bytes_rounded > THREAD_STACK_AREA_SIZE) || (THREAD_STACK_AREA_SIZE > MAX_TOTAL_THREAD_STACK_SIZE) || (num_locks > MAX_USER_LOCKS) ||
+        ((policy != RATE_MONOTONIC) && (policy != EARLIEST_DEADLINE_FIRST))) {
         return MULTITASK_REQUEST_INVALID_PARAMS;
     }
 
-    // If params are valid then parition the user and kernel thread stacks according to stack_bytes (rounded up) including a space for the idle thread
-    // Create a "dummy" TCB with pointers to the correct MSP and PSP (but without fields actually meaninfully set with id and function to execute)
-    // Start at __thread_kernel_stacks_base and decrement by the requested task_bytes
-    // Iterate over num_threads+1 such that the idle thread TCB will be correctly partioned and will be at index num_user_threads and the main thread will be at index num_user_threads+1 (14 and 15 respectively in worst case)
-    for (uint8_t thread_index = 0; thread_index < (num_threads_plus_idle); thread_index++) {
-        uint32_t psp = (uint32_t)&__thread_user_stacks_base - (thread_index)*stack_bytes_aligned;
-        uint32_t msp = (uint32_t)&__thread_kernel_stacks_base - (thread_index)*stack_bytes_aligned;
+    // The whole stack areas are free until threads are defined
+    stack_area_init(&thread_user_stack_area, &__thread_user_stacks_limit, THREAD_STACK_AREA_SIZE);
+    default_stack_bytes = stack_bytes_rounded;
 
-        // ID is initialized as zero, pass in psp/msp pointer, say the thread is defunct/not schedulable (set to ready when actually defined), and indicate it is not coming from SVC (0 - false)
+    // Paint the unused part of the shared kernel stack (below the frames of this syscall) for its high-water mark
+    disable_interrupts();
+    stack_paint(&__kernel_main_stack_limit, (void*)(stack_pointer() - KERNEL_STACK_PAINT_MARGIN));
+    enable_interrupts();
+
+    // Create a "dummy" TCB without stacks (allocated in thread_define) and without fields actually meaninfully set with id and function to execute
+    // Iterate over num_threads+1 such that the idle thread TCB will be correctly partioned and will be at index num_user_threads and the main thread will be at index num_user_threads+1 (MAX_NUM_THREADS and MAX_NUM_THREADS+1 respectively in worst case)
+    for (uint8_t thread_index = 0; thread_index < (num_threads_plus_idle); thread_index++) {
+        // ID is initialized as zero, say the thread is defunct/not schedulable (set to ready when actually defined), and indicate it is not coming from SVC (0 - false)
         tcb_t dummy_tcb;
         dummy_tcb.id = 0;
-        dummy_tcb.base_process_stack = (void*)psp; // Save the original base address so it can be reset to if the TCB is being overwritten with a new thread (if old TCB becomes defunct)
-        dummy_tcb.base_main_stack = (void*)msp; // Save the original base address so it can be reset to if the TCB is being overwritten with a new thread (if old TCB becomes defunct)
-        dummy_tcb.limit_process_stack = (void*)(psp - stack_bytes_aligned); // Save the limit for the current stack (to check against when looking for under/overflow)
-        dummy_tcb.limit_main_stack = (void*)(msp - stack_bytes_aligned); // Save the limit for the current stack (to check against when looking for under/overflow)
-        dummy_tcb.psp = (void*)psp;
-        dummy_tcb.msp = (void*)msp;
+        dummy_tcb.base_process_stack = NULL;
+        dummy_tcb.limit_process_stack = NULL;
+        dummy_tcb.psp = NULL;
         dummy_tcb.state = ThreadDefunct;
         dummy_tcb.static_priority = 0xFFFFFFFF; // Priorities will be later overwritten when an absolute ordering is created
         dummy_tcb.dynamic_priority = 0xFFFFFFFF; 
         dummy_tcb.active_time = 0; 
         dummy_tcb.remaining_work = 0;
-        dummy_tcb.time_until_release = 0;
-        dummy_tcb.svc_status = 0;
+        dummy_tcb.next_release = 0;
+        dummy_tcb.release_slot = RELEASE_QUEUE_END;
+        dummy_tcb.absolute_deadline = 0;
+        dummy_tcb.ready_next = READY_QUEUE_END;
+        dummy_tcb.held_top = LOCK_STACK_END;
+        dummy_tcb.response_time = 0;
+        dummy_tcb.cycles = 0;
+        dummy_tcb.server = 0;
+        dummy_tcb.events = 0;
+        dummy_tcb.event_mask = 0;
+        dummy_tcb.job_pending = 0;
+        dummy_tcb.job_deadline = 0;
+        dummy_tcb.deadline_misses = 0;
+        dummy_tcb.overruns = 0;
+        dummy_tcb.max_lateness = 0;
+        dummy_tcb.miss_policy = DeadlineMissContinue;
+        dummy_tcb.demoted = 0;
+        dummy_tcb.job_skipped = 0;
         user_threads[thread_index] = dummy_tcb;
     }
 
+    // No thread is ready or waiting for a release until one is defined
+    ready_bitmap_clear();
+    edf_ready_head = READY_QUEUE_END;
+    release_heap_size = 0;
+    scheduling_policy = policy;
+
     // Set global variables to correct parameters
     // Create a TCB for the main thread
     // Add it to position num_threads+1 of user_threads array (i.e. last index in the array)
     tcb_t main_tcb;
     main_tcb.id = 0;
     main_tcb.psp = 0; // Will need to be set from first call to scheduler (currently running so probably not at linker label)
-    main_tcb.msp = 0; // Will need to be set from first call to scheduler (currently running so probably not at linker label)
     main_tcb.state = ThreadRunning;
+    main_tcb.static_priority = 0xFFFFFFFF; // Main thread is never tracked by the ready bitmap (only scheduled once all other threads end)
+    main_tcb.dynamic_priority = 0xFFFFFFFF;
     main_tcb.active_time = 0; 
     main_tcb.remaining_work = 1; // Will have its remaining_work decremented on first scheduling
-    main_tcb.time_until_release = 0;
-    main_tcb.svc_status = 0;
-    main_tcb.svc_status = 0;
+    main_tcb.next_release = 0;
+    main_tcb.release_slot = RELEASE_QUEUE_END;
+    main_tcb.absolute_deadline = 0;
+    main_tcb.ready_next = READY_QUEUE_END;
+    main_tcb.held_top = LOCK_STACK_END;
+    main_tcb.response_time = 0;
+    main_tcb.cycles = 0;
+    main_tcb.server = 0;
+    main_tcb.events = 0;
+    main_tcb.event_mask = 0;
+    main_tcb.job_pending = 0;
+    main_tcb.job_deadline = 0;
+    main_tcb.deadline_misses = 0;
+    main_tcb.overruns = 0;
+    main_tcb.max_lateness = 0;
+    main_tcb.miss_policy = DeadlineMissContinue;
+    main_tcb.demoted = 0;
+    main_tcb.job_skipped = 0;
     user_threads[num_threads_plus_idle] = main_tcb;
     num_user_threads = num_threads;
     active_thread_index = num_threads_plus_idle; // Show that the currently active thread is the main thread (i.e. idle_index +1)
+    switch_frame_limit_update();
+    trace_record(TRACE_THREAD_DEFINE, num_threads, TRACE_ID_IDLE);
+    trace_record(TRACE_THREAD_DEFINE, num_threads_plus_idle, TRACE_ID_MAIN);
 
     // Flesh out TCB for idle thread (defunct TCB allocated above)
     // Invoke function definition helper function to not influence global state
@@ -332,85 +1121,125 @@ int syscall_multitask_request(uint32_t num_threads, uint32_t stack_bytes, void*
     user_threads[num_threads].static_priority = 0xFFFFFFFF; // Assign lowest possible priority (i.e. incredibly high period) so the idle thread never takes precedence over another valid thread
     user_threads[num_threads].dynamic_priority = 0xFFFFFFFF;
     user_threads[num_threads].remaining_work = 1;
-    user_threads[num_threads].time_until_release = 0;
+    thread_stack_alloc(num_threads, default_stack_bytes); // Always fits since the areas are empty and the size was checked above
 
     if (idle_function == NULL) {
         thread_function_define(default_idle, NULL, num_threads); // Place idle at num_thread index
     } else {
         thread_function_define(idle_function, NULL, num_threads);   
     }
+    thread_stack_region_define(num_threads);
 
     // Check what kind of memory protection the user requested
-    // Create a unified block of all stack space (for user and kernel stacks) if kernel_protect
+    // Create a unified block of all user stack space if kernel_protect (threads have no kernel stacks of their own - the shared kernel stack stays privileged only)
     protection_status = mpu_protect;
     if (mpu_protect == KERNEL_PROTECT) {
         // Only protect the kernel (just lump everything else together)
-        extern uint32_t __thread_user_stacks_limit;
-        extern uint32_t __thread_kernel_stacks_limit;
-        mpu_thread_region_enable(&__thread_user_stacks_limit, MAX_TOTAL_THREAD_STACK_SIZE);
-        mpu_kernel_region_enable(&__thread_kernel_stacks_limit, MAX_TOTAL_THREAD_STACK_SIZE);
+        mpu_thread_region_enable(&__thread_user_stacks_limit, THREAD_STACK_AREA_SIZE);
     } else {
         // Need to create thread regions on the fly so just disable them for now (will be enabled/disabled by scheduler)
         mpu_thread_region_disable();
-        mpu_kernel_region_disable();
     }
 
     // Set global variable for number of user locks (indicates how many structs in user_locks are valid / "initialized")
+    // Semaphores, event groups, and condition variables are defined from scratch as well
     num_user_locks = num_locks;
+    sync_reset();
+    ring_reset();
     multitask_request_called = 1; // Flag that this function was called
     return SUCCESS;
 }
 
+/// Indices in user_threads of the active threads sorted from highest to lowest static priority (the position of a thread in this array is its static priority)
+uint8_t priority_order[MAX_NUM_THREADS];
+
+/**
+ * Moves a single priority value (static, dynamic, or ceiling) by `delta` if it is at or below `level` (numerically at least `level`).
+ * The 0xFFFFFFFF priority of the idle thread, the main thread, and an unset ceiling never moves (and neither does the background priority of a demoted thread).
+ */
+void priority_shift(uint32_t* priority, uint32_t level, int32_t delta) {
+    if ((*priority < THREAD_PRIORITY_BACKGROUND) && (*priority >= level)) {
+        *priority += delta;
+    }
+}
+
 /**
- * Assigns static priorities of tasks as the tasks are defined (i.e. create an absolute ordering from 0 to num_active_threads based on lower field / tie-breaking in favor of lower priority)
- * Every additional task defined must require the previous ordering to be re-evaluated (since it is not known how the period/ID of the new task will compare to the previous ones).
- * Performs insertion sort (basically) to determine the highest priority task. Would be more efficient to sort user_threads array based on period/ID, but with such a low number of threads this complexity seems acceptable (and requires the least amount of rewrites for creating the new priority system)
- * The next smallest prioritiy number (starting at 0 through num_threads) is assigned to the thread with the lowest period (and in the even to a tie is given to the thread with the lowest ID)
+ * Moves every priority at or below `level` by `delta` (used to open or close a gap in the ordering).
+ * Static and dynamic priorities of the active threads move together with the lock ceilings bound to them and the global ceiling, so inherited priorities and held ceilings keep pointing at the same threads.
+ * The ready bitmap is indexed by priority so it is rebuilt afterwards (only a sweep of the threads and not a reorder).
  */
-void order_absolute_priorities() {
-    uint32_t highest_priority_index;
-    uint32_t highest_priority_id;
-    uint32_t highest_priority_period;
+void priority_shift_all(uint32_t level, int32_t delta) {
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if (user_threads[index].state == ThreadDefunct) continue;
+        priority_shift(&user_threads[index].static_priority, level, delta);
+        priority_shift(&user_threads[index].dynamic_priority, level, delta);
+    }
+    for (uint8_t lock_index = 0; lock_index < num_defined_locks; lock_index++) {
+        priority_shift(&user_locks[lock_index].priority_ceiling, level, delta);
+    }
+    priority_shift(&global_priority_ceiling, level, delta);
+
+    // Under EDF the priorities are only preemption levels for the stack resource policy (the ready queue is ordered by deadline so it is unaffected)
+    if (scheduling_policy == RATE_MONOTONIC) {
+        ready_bitmap_rebuild();
+    }
+}
 
-    // First remove any old priorities that may still be attached to threads
-    for (uint8_t assignment_index = 0; assignment_index < num_user_threads; assignment_index++) {
-        user_threads[assignment_index].static_priority = 0xFFFFFFFF;
-        user_threads[assignment_index].dynamic_priority = 0xFFFFFFFF;
+/**
+ * Assigns the static priority of the (still defunct) thread at `index` by inserting it into priority_order (lower period first with ties going to the lower ID).
+ * Every thread after the insertion point moves one level down so only the priorities that actually change are touched (no full reorder of the threads).
+ * Locks naming this thread as their highest locker are bound to its new level right away, so threads can be added while the system is running.
+ */
+void priority_order_insert(uint8_t index) {
+    // Find the first active thread with a lower priority than the new one
+    uint32_t level = 0;
+    while ((level < num_active_threads) && rms_higher_priority(&user_threads[priority_order[level]], &user_threads[index])) {
+        level++;
     }
 
-    // Then assign threads the highest priority in the range 0 to num_threads (only considering threads that do not yet have a priority)
-    for (uint8_t assignment_index = 0; assignment_index < num_active_threads; assignment_index++) {
-        highest_priority_index = 0xFFFFFFFF;
-        highest_priority_id = 0xFFFFFFFF;
-        highest_priority_period = 0xFFFFFFFF;
+    // Open a gap at this level
+    priority_shift_all(level, 1);
+    for (uint32_t position = num_active_threads; position > level; position--) {
+        priority_order[position] = priority_order[position-1];
+    }
+    priority_order[level] = index;
+    user_threads[index].static_priority = level;
+    user_threads[index].dynamic_priority = level;
 
-        // Only look at threads that have not yet been assigned a priority
-        for (uint8_t thread_index = 0; thread_index < num_user_threads; thread_index++) {
-            if (user_threads[thread_index].static_priority != 0xFFFFFFFF || user_threads[thread_index].state == ThreadDefunct) continue;
-
-            // Only select as highest priority if it has the highest period or if it has the equal highest period but a lower id
-            if ((user_threads[thread_index].t < highest_priority_period) ||
-                ((user_threads[thread_index].t <= highest_priority_period) && user_threads[thread_index].id < highest_priority_id)) {
-                highest_priority_index = thread_index;
-                highest_priority_id = user_threads[thread_index].id;
-                highest_priority_period = user_threads[thread_index].t;
-            }
+    for (uint8_t lock_index = 0; lock_index < num_defined_locks; lock_index++) {
+        if (user_locks[lock_index].highest_locker_id == user_threads[index].id) {
+            user_locks[lock_index].priority_ceiling = level;
         }
+    }
+    lock_stack_relink(); // A held lock may have been bound to this level
+}
 
-        // Assign the best found index tas he lowest remaining priority
-        user_threads[highest_priority_index].static_priority = assignment_index;
-        user_threads[highest_priority_index].dynamic_priority = assignment_index;
+/**
+ * Removes the (already defunct) thread at `index` from priority_order and moves every lower priority thread up one level to close the gap.
+ * A lock whose highest locker was this thread keeps the same level (now the next lower priority thread) which still covers all of its remaining lockers.
+ */
+void priority_order_remove(uint8_t index) {
+    uint32_t level = user_threads[index].static_priority;
+    for (uint32_t position = level; position+1 < num_active_threads; position++) {
+        priority_order[position] = priority_order[position+1];
     }
+    user_threads[index].static_priority = 0xFFFFFFFF;
+    user_threads[index].dynamic_priority = 0xFFFFFFFF;
+    priority_shift_all(level+1, -1);
+    lock_stack_relink(); // Held ceilings that moved up to this level can now tie with the ones already there
 }
 
 /**
  * Performs admission control and parameter validation on the inputted arguements.
  * Overwrites the "dummy" TCB created in multitask_request with the parameter id, async function, and periodic data needed for scheduling.
+ * Allocates a user stack of `stack_bytes` (or the default size from multitask_request if zero) packed next to the stacks of the other threads.
+ * A nonzero `server` defines a deferrable server instead of a periodic thread. Servers are only supported under RMS (response time analysis bounds their back-to-back interference, while the EDF utilization test cannot).
  * Returns a negative error code if the task cannot be safely accepted, but otherwise accepts the task and places it in an empty location in the user_threads array.
  */
-int syscall_thread_define(uint32_t id, void *fn, void *arg, uint32_t c, uint32_t t) {
+int thread_admit(uint32_t id, void *fn, void *arg, uint32_t c, uint32_t t, uint32_t stack_bytes, uint8_t server) {
     // Check if arguements are invalid
-    if (fn == NULL || (c == 0) || (t == 0) || (c > t)) {
+    uint32_t stack_bytes_rounded = (stack_bytes == 0) ? default_stack_bytes : stack_size_round(stack_bytes);
+    if (fn == NULL || (c == 0) || (t == 0) || (c > t) || (stack_bytes_rounded > THREAD_STACK_AREA_SIZE) || (server && (scheduling_policy != RATE_MONOTONIC))) {
         return THREAD_DEFINE_INVALID_ARGS;
     }
 
@@ -440,44 +1269,90 @@ int syscall_thread_define(uint32_t id, void *fn, void *arg, uint32_t c, uint32_t
         return THREAD_DEFINE_NO_TCB;
     }
 
-    // Perform admission control for the provided parameters by comparing new task utilization to the upper bound for the would-be number of tasks
+    // Claim the stack before admission control so that a thread that does not fit leaves the stored response times untouched
+    if (!thread_stack_alloc(tcb_index, stack_bytes_rounded)) {
+        return THREAD_DEFINE_NO_STACK_SPACE;
+    }
+
+    // Perform admission control for the provided parameters
+    // No task set that overloads the processor can be accepted
+    // EDF is optimal for implicit deadlines so any task set that does not overload the processor is accepted (every thread finishes by the end of its period at worst)
+    // RMS runs the exact response time analysis with the new thread in place (the TCB stays defunct until the thread is accepted so filling in its parameters has no other effect)
     float new_utilization = ((float)c / (float)t) + total_utilization; // Cast to float to ensure proper number
-    if (new_utilization <= util_bound[num_active_threads+1]) {
+    user_threads[tcb_index].id = id;
+    user_threads[tcb_index].c = c;
+    user_threads[tcb_index].t = t;
+    user_threads[tcb_index].response_time = t;
+    user_threads[tcb_index].server = server;
+    user_threads[tcb_index].events = 0;
+    user_threads[tcb_index].event_mask = 0;
+    uint32_t admitted = (new_utilization <= 1.0f) && ((scheduling_policy == EARLIEST_DEADLINE_FIRST) || rms_admit(tcb_index));
+    if (admitted) {
         // Thread can be accepted
         // Update utliziation
         total_utilization = new_utilization;
 
-        // Overwrite the "dummy" TCB at index `num_active_threads` (incremented from 0)
+        // Overwrite the rest of the "dummy" TCB at index `num_active_threads` (incremented from 0)
         // Set the new thread as ready instead of defunct (able to be scheduled now that it has a definition)
-        // Set values for id, c, t, and priority (equal to t) - other parameters can be kept at default 0 (also assumes all tasks are released at time 0)
+        // Other parameters can be kept at default 0 (also assumes all tasks are released at time 0)
         // When working with thread_end, this ensures that if num_active_threads is less than the total space, it is guranteed to be defunct
-        user_threads[tcb_index].id = id;
-        user_threads[tcb_index].c = c;
-        user_threads[tcb_index].t = t;
-        user_threads[tcb_index].state = ThreadReady;
         user_threads[tcb_index].active_time = 0; 
+        user_threads[tcb_index].cycles = 0;
         user_threads[tcb_index].remaining_work = c;
-        user_threads[tcb_index].time_until_release = t-1;
-        user_threads[tcb_index].svc_status = 0;
+        user_threads[tcb_index].next_release = global_timeslot_counter + t; // Released now and again one period later
+        user_threads[tcb_index].absolute_deadline = user_threads[tcb_index].next_release;
+        user_threads[tcb_index].job_pending = 1;
+        user_threads[tcb_index].job_deadline = user_threads[tcb_index].next_release;
+        user_threads[tcb_index].deadline_misses = 0;
+        user_threads[tcb_index].overruns = 0;
+        user_threads[tcb_index].max_lateness = 0;
+        user_threads[tcb_index].miss_policy = DeadlineMissContinue;
+        user_threads[tcb_index].demoted = 0;
+        user_threads[tcb_index].job_skipped = 0;
+        user_threads[tcb_index].held_top = LOCK_STACK_END;
+        release_queue_insert(tcb_index);
+
+        // Insert the thread into the static priority ordering before it becomes ready (so it enters the ready bitmap at its own level)
+        priority_order_insert(tcb_index);
+        thread_set_state(&user_threads[tcb_index], ThreadReady);
 
         // Call function definition helper to place default values on the stack for this thread
         thread_function_define(fn, arg, tcb_index);
+        thread_stack_region_define(tcb_index);
         
         // Increment number of active threads since a new valid thread was just defined
         num_active_threads++;
         thread_define_called = 1; // Flag that this function was called
+        trace_record(TRACE_THREAD_DEFINE, tcb_index, id);
 
-        // Must recompute static priorities of tasks every time a new one is defined
-        // NOTE: If there was a gurantee that defunct tasks (from spawner for instace) are always defined such that the user application is back to the maximum number of threads, this function call could be only made once when num_active_threads == num_user_threads
-        // Without this gurantee though (i.e. where a spawner thread could not redefine all threads or the user could request more threads than they actually define) it is safest to make this call for each additional thread defined
-        order_absolute_priorities();
+        // A thread defined while the scheduler is running may have a higher priority than its creator (let the scheduler decide as if a release happened)
+        if (active_thread_index != num_user_threads+1) {
+            preemption_flag = 1;
+            set_pendsv();
+        }
         return SUCCESS;
     } else {
         // Thread cannot be accepted with conservative certainty
+        thread_stack_free(tcb_index);
         return THREAD_DEFINE_UNSAFE_ADMISSION;
     }
 }
 
+/**
+ * Defines a periodic thread (see thread_admit).
+ */
+int syscall_thread_define(uint32_t id, void *fn, void *arg, uint32_t c, uint32_t t, uint32_t stack_bytes) {
+    return thread_admit(id, fn, arg, c, t, stack_bytes, 0);
+}
+
+/**
+ * Defines a deferrable server (see thread_admit).
+ * The server starts out ready like any other thread and is expected to call server_wait once it has set itself up.
+ */
+int syscall_server_define(uint32_t id, void *fn, void *arg, uint32_t c, uint32_t t, uint32_t stack_bytes) {
+    return thread_admit(id, fn, arg, c, t, stack_bytes, 1);
+}
+
 /// Reset this value on first syscall_multitask_start invocation to make sure it is initialized correctly
 extern uint8_t timer_wrap_around;
 
@@ -513,11 +1388,12 @@ uint8_t validate_ceiling_id() {
 /**
  * Configures the SysTick timer to fire with interrupts as fast as 1 second (a frequency of zero of implies that the scheduler is not-preemptive and will only be invoked through explicit).
  * Starts the SysTick timer to begin counting down (with the scheduling decision being pended directly from the SysTick timer handler).
+ * In TICKLESS `mode`, the SysTick timer is left off and TIMER2 instead counts timeslots of the same length, only interrupting at the next release or budget exhaustion (so the idle thread can sleep through every timeslot where nothing changes).
  * This function call is not again scheduled until all other user threads have terminated (i.e. joins the threads) and stops the SysTick timer when all threads have terminated. 
  */
-int syscall_multitask_start(uint32_t freq) {
-    // Make sure that `freq` is within correct range
-    if (freq > SYSTICK_BASE_FREQUENCY) {
+int syscall_multitask_start(uint32_t freq, tick_mode mode) {
+    // Make sure that `freq` is within correct range (TIMER2 cannot count timeslots shorter than one of its own counts)
+    if ((freq > SYSTICK_BASE_FREQUENCY) || ((mode == TICKLESS) && (freq > TIMER_BASE_FREQUENCY)) || ((mode != PERIODIC_TICK) && (mode != TICKLESS))) {
         return MULTITASK_START_INVALID_FREQ;
     }
 
@@ -530,12 +1406,37 @@ int syscall_multitask_start(uint32_t freq) {
     if (!validate_ceiling_id()) {
         return LOCK_SPECIFIES_NONEXISTENT_HIGHEST_LOCKER;
     } 
+
+    // Now that the lock ceilings are known, repeat the response time analysis from thread_define with the blocking time of each thread (RMS only)
+    if (scheduling_policy == RATE_MONOTONIC) {
+        for (uint8_t index = 0; index < num_user_threads; index++) {
+            if (user_threads[index].state == ThreadDefunct) continue;
+            uint32_t response = rms_response_time(index, index, pcp_blocking_time(index, index));
+            if (response == RESPONSE_TIME_UNSCHEDULABLE) {
+                return MULTITASK_START_UNSCHEDULABLE;
+            }
+            user_threads[index].response_time = response;
+        }
+    }
+    multitask_start_called = 1;
+
     global_priority_ceiling = 0xFFFFFFFF; // Set current priority ceiling as low as possible for starting threads (any reasonable periodic task will be able to lock this)
     highest_priority_lock = 0; // Set the current locker to none
+    ceiling_stack_top = LOCK_STACK_END; // Nothing is locked
 
     // Check if this scheduler is preemptive (otherwise just call scheduler and do not configure systick timer)
     // Avoid 0 division issue in the case of nonpreemptive scheduler
-    if (freq > 0) {
+    // A nonpreemptive scheduler has no timeslots to skip so it is never tickless
+    timing_mode = (freq > 0) ? mode : PERIODIC_TICK;
+#ifdef TARGET_QEMU
+    // QEMU mps2-an386 has no nRF TIMER2 so it always ticks (the schedule is the same, the idle thread just wakes every timeslot)
+    timing_mode = PERIODIC_TICK;
+#endif
+    if (timing_mode == TICKLESS) {
+        // Timer is started below once the timeslot counter is reset (so timeslot 0 starts at the same instant as the releases)
+        tickless_timeslot_counts = TIMER_BASE_FREQUENCY / freq;
+        tickless_max_timeslots = 0x7FFFFFFF / tickless_timeslot_counts;
+    } else if (freq > 0) {
         // Calculate reset value for the inputted frequency (i.e. figure out what the value should be so that the interrupt fires at the regular freqeuncy)
         // If the reset value is higher than the maximum possible reset value, split into bins until it is small enough (i.e. increase number of invocations required)
         uint32_t reload_value = (SYSTICK_BASE_FREQUENCY / freq) -1; // Account for off-by-one in initial assignment (this means the clock could be slightly fast if needing to subdivide) 
@@ -556,12 +1457,30 @@ int syscall_multitask_start(uint32_t freq) {
     // Suspend main thread until all other threads are finished running
     // Going into schedule active_thread_index = num_user_threads so the main thread is active (immediately switched out though by the first schedule)
     // Reset global counter time (if this is not the first time that multitask_start is being invoked)
+    // All defined threads are released together at timeslot 0 so re-anchor the release queue to the reset counter
     global_timeslot_counter = 0;
+    release_heap_size = 0;
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if (user_threads[index].state != ThreadDefunct) {
+            user_threads[index].next_release = user_threads[index].t;
+            user_threads[index].job_pending = 1;
+            user_threads[index].job_deadline = user_threads[index].t;
+            user_threads[index].job_skipped = 0;
+            thread_set_deadline(&user_threads[index], user_threads[index].t);
+            release_queue_insert(index);
+        }
+    }
+    if (timing_mode == TICKLESS) {
+        timer2_init();
+        tickless_timeslot_start = timer2_now();
+    }
+    kernel_cycles = 0;
+    user_threads[num_user_threads].cycles = 0; // Idle thread
+    cycle_last_sample = cycle_count();
     set_pendsv();
 
-    // Will only return here after this thread is scheduled again (i.e. all others are terminated)
-    // Stop SysTick Timer and return to caller
-    systick_disable();
+    // PendSV only runs once this handler returns, so the timers must keep running here
+    // The main thread resumes with this return value once every other thread has terminated (PendSV stops the timers when it switches back to main)
     return SUCCESS;
 }
 
@@ -575,12 +1494,17 @@ uint32_t syscall_thread_id() {
 /**
  * Manually pends the PendSV signal to immediately invoke the scheduler.
  * Labels the current thread as waiting (i.e. not to be scheduled again until the start of the next period)
+ * Yielding completes the current job of the thread (its lateness is measured against the deadline of the oldest unfinished job after bringing the time up to date).
  * Under current scheduler schemes, the thread could be immediately rescheduled if it is the only one remaining (or is it has the highest priority)
  */
 void syscall_thread_yield() {
     // Do not allow for placing the idle thread in waiting (should always be schedulable)
     if (active_thread_index != num_user_threads) {
-        user_threads[active_thread_index].state = ThreadWaiting;
+        if (active_thread_index < num_user_threads) {
+            scheduler_sync_time();
+            deadline_job_complete();
+        }
+        thread_set_state(&user_threads[active_thread_index], ThreadWaiting);
     }
 
     // Check if thread held any locks when it yielded
@@ -591,6 +1515,62 @@ void syscall_thread_yield() {
     set_pendsv();
 }
 
+/**
+ * Returns (and clears) the event bits in `mask` that were signalled to the calling server, blocking until at least one of them is signalled.
+ * Waiting on SERVER_EVENT_STDIN also checks the RTT down buffer right away so input that arrived while the server was busy is not left until its next release.
+ * A blocked server is restarted (through svc_restart) once it is woken, so the mask stays in r0 and nothing is kept on the shared kernel stack while it waits.
+ * Returns 0 right away if the caller is not a server or `mask` is empty.
+ */
+uint32_t syscall_server_wait(uint32_t mask) {
+    tcb_t* server = &user_threads[active_thread_index];
+    if ((active_thread_index >= num_user_threads) || !server->server || (mask == 0)) {
+        return 0;
+    }
+
+    // Interrupt handlers can signal the server so the pending bits are checked and consumed with interrupts disabled
+    disable_interrupts();
+    if ((mask & SERVER_EVENT_STDIN) && (rtt_peek() > 0)) {
+        server->events |= SERVER_EVENT_STDIN;
+    }
+    uint32_t signalled = server->events & mask;
+    if (signalled) {
+        server->events &= ~signalled;
+        enable_interrupts();
+        return signalled;
+    }
+
+    // Nothing to do so give the processor away without giving up the rest of the budget (woken by server_signal)
+    server->event_mask = mask;
+    thread_set_state(server, ThreadWaiting);
+    if (active_thread_holds_locks()) {
+        printk("Server with ID %d waited for an event while holding a lock\n", server->id);
+    }
+    svc_restart = 1;
+    enable_interrupts();
+    set_pendsv();
+    return 0;
+}
+
+/**
+ * Signals the event bits `events` to the active server with the given `id` (invoking the scheduler if the woken server should run before the caller).
+ * Returns THREAD_ID_NOT_FOUND if no active server has the given `id`.
+ */
+int syscall_server_notify(uint32_t id, uint32_t events) {
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if ((user_threads[index].state != ThreadDefunct) && user_threads[index].server && (user_threads[index].id == id)) {
+            disable_interrupts();
+            uint32_t preempt = server_signal(index, events);
+            enable_interrupts();
+            if (preempt) {
+                preemption_flag = 1;
+                set_pendsv();
+            }
+            return SUCCESS;
+        }
+    }
+    return THREAD_ID_NOT_FOUND;
+}
+
 /**
  * Immediately invokes the scheduler and labels the current thread as having exited (i.e. will not be scheduled).
  * The dead TCB for this thread will still exist in the user_threads array and can be overwritten with a new definition now that this TCB is defunct.
@@ -604,17 +1584,20 @@ void syscall_thread_end() {
         return;
     }
 
-    // Sweep through the user lock fields and unlock any locks that were held by this thread (i.e. should not exit while holding a lock)
-    for (uint8_t index = 0; index < num_user_locks; index++) {
-        if (user_locks[index].current_locker == &user_threads[active_thread_index]) {
-            syscall_unlock(&user_locks[index]);
-        }
+    // Unlock every lock that is still held by this thread, newest first (i.e. should not exit while holding a lock)
+    // Locks it took or released in user space since the last kernel entry are accounted first (a thread ended by a fault handler did not come through a syscall - changes that do not check out are dropped since it is ending anyway)
+    lock_fast_sync();
+    while (user_threads[active_thread_index].held_top != LOCK_STACK_END) {
+        syscall_unlock(&user_locks[user_threads[active_thread_index].held_top]);
     }
 
     // Subtract the current thread's utilization from the global utilization
     // Mark the TCB as defunct (able to be overwritten by an ID with the same definition)
     total_utilization -= ((float)user_threads[active_thread_index].c / (float)user_threads[active_thread_index].t);
-    user_threads[active_thread_index].state = ThreadDefunct;
+    thread_set_state(&user_threads[active_thread_index], ThreadDefunct);
+    release_queue_remove(active_thread_index); // No more releases for this thread
+    priority_order_remove(active_thread_index); // Lower priority threads move up a level
+    thread_stack_free(active_thread_index); // Nothing else is allocated before the switch away from this thread (PendSV still saves its registers on the freed stack but they are never restored)
     num_active_threads--; // Decrement the value of num_active_threads to potentially alert main thread to run
     set_pendsv();
 }
@@ -623,8 +1606,10 @@ void syscall_thread_end() {
  * A call to this function represents the time that a task occupied rather than the raw number of decisions made as a result of timer preemption.
  * The counter is treated as the absolute source of truth and represents the time after multitask_start initially invokes the scheduler (so counter == 0 implies the scheduler is working on timeslot 0).
  * Timeslot is only incremented when a systick timer interrupt fires (to keep global_timeslot_counter in time with the number of scheduling decisions).
+ * In tickless mode the counter is brought up to date first since it is otherwise only advanced at scheduling events.
  */
 uint32_t syscall_get_time() {
+    scheduler_sync_time();
     return global_timeslot_counter;
 }
 
@@ -633,6 +1618,7 @@ uint32_t syscall_get_time() {
  * The active time is the number of scheduling cycles that the thread has been running (i.e. number of times the thread has been scheduled)
  */
 uint32_t syscall_thread_time() {
+    scheduler_sync_time();
     return user_threads[active_thread_index].active_time;
 }
 
@@ -644,13 +1630,281 @@ uint32_t syscall_thread_priority() {
     return user_threads[active_thread_index].dynamic_priority;
 }
 
+/**
+ * Return the worst case response time of the active thread with the given `id` (in scheduler periods).
+ * Under RMS this is the fixed point found by response time analysis (including blocking once multitask_start has validated the locks).
+ * Under EDF this is the period of the thread since admission only guarantees that every thread finishes by its deadline.
+ */
+int syscall_thread_response_time(uint32_t id) {
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if ((user_threads[index].state != ThreadDefunct) && (user_threads[index].id == id)) {
+            return (int)user_threads[index].response_time;
+        }
+    }
+    return THREAD_ID_NOT_FOUND;
+}
+
+/**
+ * Fills `counters` with the cycles consumed by the active thread with the given `id` along with the kernel and idle thread totals.
+ * Cycles are only charged to a thread on a context switch so the cycles since the last switch are added in if the requested thread is the caller.
+ * Returns THREAD_ID_NOT_FOUND if no active thread has the given `id`.
+ */
+int syscall_thread_cycles(uint32_t id, cycle_counters_t* counters) {
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if ((user_threads[index].state != ThreadDefunct) && (user_threads[index].id == id)) {
+            counters->thread = user_threads[index].cycles;
+            if (index == active_thread_index) {
+                counters->thread += cycle_count() - cycle_last_sample;
+            }
+            counters->kernel = kernel_cycles;
+            counters->idle = user_threads[num_user_threads].cycles;
+            return SUCCESS;
+        }
+    }
+    return THREAD_ID_NOT_FOUND;
+}
+
+/**
+ * Returns the current value of the cycle counter (user space cannot read the DWT directly).
+ */
+uint32_t syscall_cycle_count() {
+    return cycle_count();
+}
+
+/**
+ * Returns the cycles that PendSV_C_Handler took for the last switch between two different threads (a thread that reads it right after it is switched in gets the cost of its own switch).
+ */
+uint32_t syscall_switch_cycles() {
+    return switch_cycles_last;
+}
+
+/**
+ * Fills `stats` with the deadline counters of the active thread with the given `id`.
+ * Returns THREAD_ID_NOT_FOUND if no active thread has the given `id`.
+ */
+int syscall_thread_deadline_stats(uint32_t id, deadline_stats_t* stats) {
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if ((user_threads[index].state != ThreadDefunct) && (user_threads[index].id == id)) {
+            stats->deadline_misses = user_threads[index].deadline_misses;
+            stats->overruns = user_threads[index].overruns;
+            stats->max_lateness = user_threads[index].max_lateness;
+            return SUCCESS;
+        }
+    }
+    return THREAD_ID_NOT_FOUND;
+}
+
+/**
+ * Sets what the scheduler does at the next deadline misses of the active thread with the given `id` to `policy` (a thread that is already demoted stays demoted until its late job completes).
+ * Returns THREAD_INVALID_DEADLINE_POLICY for an unknown policy and THREAD_ID_NOT_FOUND if no active thread has the given `id`.
+ */
+int syscall_thread_deadline_policy(uint32_t id, deadline_policy policy) {
+    if ((policy != DeadlineMissContinue) && (policy != DeadlineMissSkip) && (policy != DeadlineMissDemote) && (policy != DeadlineMissEnd)) {
+        return THREAD_INVALID_DEADLINE_POLICY;
+    }
+
+    for (uint8_t index = 0; index < num_user_threads; index++) {
+        if ((user_threads[index].state != ThreadDefunct) && (user_threads[index].id == id)) {
+            user_threads[index].miss_policy = policy;
+            return SUCCESS;
+        }
+    }
+    return THREAD_ID_NOT_FOUND;
+}
+
+/**
+ * Fills `usage` with the high-water mark of the process stack of the defined thread (or the idle thread) with the given `id` and of the shared kernel stack.
+ * Returns THREAD_ID_NOT_FOUND if no defined thread has the given `id`.
+ */
+int syscall_thread_stack_usage(uint32_t id, stack_usage_t* usage) {
+    for (uint8_t index = 0; index < num_user_threads+1; index++) {
+        if ((user_threads[index].state != ThreadDefunct) && (user_threads[index].id == id)) {
+            usage->process_used = stack_high_water(user_threads[index].limit_process_stack, user_threads[index].base_process_stack);
+            usage->process_size = (uint32_t)user_threads[index].base_process_stack - (uint32_t)user_threads[index].limit_process_stack;
+            usage->kernel_used = stack_high_water(&__kernel_main_stack_limit, &__kernel_main_stack_base);
+            usage->kernel_size = (uint32_t)&__kernel_main_stack_base - (uint32_t)&__kernel_main_stack_limit;
+            return SUCCESS;
+        }
+    }
+    return THREAD_ID_NOT_FOUND;
+}
+
+/**
+ * Prints one line per defined thread (including the idle thread) with the bytes used out of its process stack, followed by the shared kernel stack.
+ */
+void thread_stack_usage_dump() {
+    if (!multitask_request_called) {
+        return;
+    }
+
+    for (uint8_t index = 0; index < num_user_threads+1; index++) {
+        if (user_threads[index].state == ThreadDefunct) continue;
+        stack_usage_t usage;
+        syscall_thread_stack_usage(user_threads[index].id, &usage);
+        printk("* Thread %d stack high-water mark: %d of %d bytes\n", user_threads[index].id, usage.process_used, usage.process_size);
+    }
+    printk("* Kernel stack high-water mark: %d of %d bytes\n", stack_high_water(&__kernel_main_stack_limit, &__kernel_main_stack_base), (uint32_t)&__kernel_main_stack_base - (uint32_t)&__kernel_main_stack_limit);
+}
+
+/**
+ * Returns the bit of the lock `m` in the lock words shared with user space.
+ */
+uint32_t lock_bit(mutex_t* m) {
+    return 1u << (m - user_locks);
+}
+
+/**
+ * Sets global_priority_ceiling and highest_priority_lock from the top of the ceiling stack (every entry already knows which lock sets the ceiling while it is on top).
+ */
+void lock_ceiling_from_stack() {
+    if (ceiling_stack_top == LOCK_STACK_END) {
+        global_priority_ceiling = 0xFFFFFFFF;
+        highest_priority_lock = 0;
+        return;
+    }
+    highest_priority_lock = &user_locks[user_locks[ceiling_stack_top].ceiling_lock];
+    global_priority_ceiling = highest_priority_lock->priority_ceiling;
+}
+
+/**
+ * Sets the ceiling lock of `m` from the entry under it on the ceiling stack (a lock only takes over the ceiling if its own is strictly higher, so the older lock keeps it on a tie).
+ */
+void lock_stack_link_ceiling(mutex_t* m) {
+    m->ceiling_lock = m - user_locks;
+    if (m->stack_below != LOCK_STACK_END) {
+        mutex_t* below = &user_locks[user_locks[m->stack_below].ceiling_lock];
+        if (below->priority_ceiling <= m->priority_ceiling) {
+            m->ceiling_lock = below - user_locks;
+        }
+    }
+}
+
+/**
+ * Works out the ceiling lock of every entry on the ceiling stack again from the bottom up (only needed when an entry is taken out from under others or a held lock is bound to a new ceiling).
+ * The stack is linked from the top down so the entries are gathered first (at most one per lock).
+ */
+void lock_stack_relink() {
+    uint8_t entries[MAX_USER_LOCKS];
+    uint32_t depth = 0;
+    for (uint8_t lock_index = ceiling_stack_top; lock_index != LOCK_STACK_END; lock_index = user_locks[lock_index].stack_below) {
+        entries[depth++] = lock_index;
+    }
+    while (depth > 0) {
+        lock_stack_link_ceiling(&user_locks[entries[--depth]]);
+    }
+    lock_ceiling_from_stack();
+}
+
+/**
+ * Pushes the lock `m` that was just granted to `holder` onto the ceiling stack and onto the stack of locks held by `holder`, and raises the global priority ceiling if the ceiling of `m` is higher.
+ * Under the priority ceiling protocol a lock is only granted above the current ceiling (or to the holder of the lock that set it), so locks are released in the reverse order in the common case and the ceiling below each entry is still valid when it is popped.
+ */
+void lock_stack_push(mutex_t* m, tcb_t* holder) {
+    m->stack_below = ceiling_stack_top;
+    lock_stack_link_ceiling(m);
+    ceiling_stack_top = m - user_locks;
+    m->held_below = holder->held_top;
+    holder->held_top = m - user_locks;
+    lock_ceiling_from_stack();
+}
+
+/**
+ * Takes the lock `m` off the ceiling stack and off the stack of locks held by its current locker, and drops the global priority ceiling to what the entry under it recorded.
+ * Releasing the newest lock is constant time (nothing needs to be looked at besides the entry under it). A lock released out of order is unlinked from further down and the entries above it are linked to their new ceilings again.
+ */
+void lock_stack_remove(mutex_t* m) {
+    uint8_t lock_index = m - user_locks;
+    uint8_t* link = &m->current_locker->held_top;
+    while (*link != lock_index) {
+        link = &user_locks[*link].held_below;
+    }
+    *link = m->held_below;
+    m->held_below = LOCK_STACK_END;
+
+    if (ceiling_stack_top == lock_index) {
+        ceiling_stack_top = m->stack_below;
+        m->stack_below = LOCK_STACK_END;
+        lock_ceiling_from_stack();
+        return;
+    }
+    link = &ceiling_stack_top;
+    while (*link != lock_index) {
+        link = &user_locks[*link].stack_below;
+    }
+    *link = m->stack_below;
+    m->stack_below = LOCK_STACK_END;
+    lock_stack_relink();
+}
+
+/**
+ * Accounts the locks that the running thread took or released in user space since the last kernel entry (only the running thread executes user code in between, so every bit that changed is its own).
+ * Called on entry to SVC_C_Handler and PendSV_C_Handler before anything looks at the locks, so the kernel keeps the same view of the locks and of the global priority ceiling as if every lock had gone through syscall_lock and syscall_unlock.
+ * A lock taken in user space never has waiters and never raised the priority of its holder, so only the lock fields and the ceiling stack change here.
+ * The lock words can be written by any user code, so each change is checked against user_locks and the ceiling stack before it is accounted: a release only counts for a lock that the kernel gave to the running thread and that nobody waits on, and a take only counts for a free lock while the ceiling stack is empty and its ceiling is at or above the priority of the thread (the checks lock() and unlock() make in user space).
+ * Any other change is undone in lock_shared and 1 is returned so that the caller ends the thread (it is never ended here since PendSV_C_Handler calls this in the middle of a switch).
+ */
+uint32_t lock_fast_sync() {
+    uint32_t defined = (num_defined_locks >= 32) ? 0xFFFFFFFF : ((1u << num_defined_locks) - 1);
+    uint32_t held = lock_shared.held & defined;
+    uint32_t changed = held ^ lock_held_seen;
+    if (changed == 0) {
+        return 0;
+    }
+
+    // Releases come off the ceiling stack first (a lock is only taken in user space while nothing else is held, so it goes on top of whatever is left)
+    tcb_t* thread = &user_threads[active_thread_index];
+    uint32_t accounted = lock_held_seen;
+    uint32_t broken = 0;
+    uint32_t released = changed & ~held;
+    while (released) {
+        uint32_t lock_index = 31 - count_leading_zeros(released);
+        released &= ~(1u << lock_index);
+        mutex_t* m = &user_locks[lock_index];
+        if ((m->current_locker != thread) || (lock_shared.contended & (1u << lock_index))) {
+            broken = 1;
+            continue;
+        }
+        lock_stack_remove(m);
+        m->s = 1;
+        m->current_locker = 0;
+        accounted &= ~(1u << lock_index);
+    }
+    uint32_t taken = changed & held;
+    while (taken) {
+        uint32_t lock_index = 31 - count_leading_zeros(taken);
+        taken &= ~(1u << lock_index);
+        mutex_t* m = &user_locks[lock_index];
+        if ((m->current_locker != 0) || (ceiling_stack_top != LOCK_STACK_END)) {
+            broken = 1;
+            continue;
+        }
+        if (thread->static_priority < m->priority_ceiling) {
+            printk("Thread%d locked a mutex that has a lower priority ceiling than Thread%d's priority\n", thread->id, thread->id);
+            broken = 1;
+            continue;
+        }
+        m->s = 0;
+        m->current_locker = thread;
+        lock_stack_push(m, thread);
+        accounted |= (1u << lock_index);
+    }
+
+    // Put back the kernel's view of the bits that were not accounted (the thread is ended by the caller and never uses them)
+    lock_held_seen = accounted;
+    if (broken) {
+        lock_shared.held = (lock_shared.held & ~defined) | accounted;
+    }
+    return broken;
+}
+
 /**
  * Checks if there is space to initialize a new mutex.
  * If it can be accomodated, a new mutex from the free batch in user_locks is initialized, and its address is returned.
  * The `prio` field is the thread ID of the user thread whose static priority should be set as highest_priority.
+ * The `critical_section` field is the longest time in timeslots that any thread holds the lock (0 if unknown), which bounds the blocking time in the RMS response time analysis.
  * There is no gurantee that this function will be called after thread define, so must validate the ID in multitask_start (i.e. before the thing is actually scheduled)
  */
-mutex_t* syscall_lock_init(uint32_t prio) {
+mutex_t* syscall_lock_init(uint32_t prio, uint32_t critical_section) {
     // Make sure that multitask request was called before any lock initialization (so the num_locks requested can be known)
     // Lock init should only be called by the main user thread
     if (num_defined_locks >= num_user_locks || active_thread_index != (num_user_threads+1)) {
@@ -658,17 +1912,81 @@ mutex_t* syscall_lock_init(uint32_t prio) {
     }
 
     // Initialize the next unitialized mutex and return its address
+    // Bind the ceiling right away if the highest locker is already defined (otherwise it is bound once that thread is defined or validated in multitask_start)
     mutex_init(&user_locks[num_defined_locks]);
+    uint32_t bit = lock_bit(&user_locks[num_defined_locks]);
+    lock_shared.held &= ~bit;
+    lock_shared.contended &= ~bit;
+    lock_held_seen &= ~bit;
     user_locks[num_defined_locks].highest_locker_id = prio;
+    user_locks[num_defined_locks].critical_section = critical_section;
+    for (uint8_t thread_index = 0; thread_index < num_user_threads; thread_index++) {
+        if ((user_threads[thread_index].state != ThreadDefunct) && (user_threads[thread_index].id == prio)) {
+            user_locks[num_defined_locks].priority_ceiling = user_threads[thread_index].static_priority;
+        }
+    }
     num_defined_locks++;
     return &user_locks[num_defined_locks-1];
 }
 
+/**
+ * Inserts the thread at `index` into the wait queue starting at `head` behind every waiter with the same or a higher dynamic priority (so the head is always the waiter that is served first and equal priorities are served in arrival order).
+ */
+void wait_queue_insert(uint8_t* head, uint8_t index) {
+    uint8_t* link = head;
+    while ((*link != WAIT_QUEUE_END) && (user_threads[*link].dynamic_priority <= user_threads[index].dynamic_priority)) {
+        link = &user_threads[*link].wait_next;
+    }
+    user_threads[index].wait_next = *link;
+    *link = index;
+}
+
+/**
+ * Applies the original priority ceiling protocol to the request of the thread at `index` for the lock `m` (interrupts must be disabled).
+ * The thread gets the lock if it is free and the priority of the thread is strictly higher than the current priority ceiling (or the thread holds the lock that set the ceiling).
+ * Otherwise the thread is blocked in the wait queue of the lock that stands in its way (`m` if it is taken, else the lock that set the ceiling) and under RMS the holder of that lock inherits its priority.
+ * Returns 1 if the thread got the lock and 0 if it was blocked.
+ */
+uint32_t lock_request(uint8_t index, mutex_t* m) {
+    tcb_t* thread = &user_threads[index];
+
+    // mutex_try returns 0 on success (only attempted once the ceiling test passed)
+    if (((thread->dynamic_priority < global_priority_ceiling) || (highest_priority_lock->current_locker == thread)) && (mutex_try(m) == 0)) {
+        m->current_locker = thread;
+        lock_shared.held |= lock_bit(m);
+        lock_held_seen |= lock_bit(m);
+
+        // Only raises the priority ceiling if this lock actually has a higher priority ceiling than the one already set
+        // Does not overwrite a higher priority lock if the second condition of holding the highest priority was true
+        lock_stack_push(m, thread);
+        return 1;
+    }
+
+    // If the current lock is locked, wait for it to unlock
+    // Otherwise, the current highest locker (with its heightened global_priority_ceiling) caused the first condition to fail (i.e. lock was open but could not lock it)
+    mutex_t* blocking_lock = mutex_is_locked(m) ? m : highest_priority_lock;
+    thread_set_state(thread, ThreadBlocked);
+    thread->wait_lock = (uint8_t)(m - user_locks);
+    wait_queue_insert(&blocking_lock->wait_head, index);
+    lock_shared.contended |= lock_bit(blocking_lock); // Its holder has to unlock it through the kernel to hand it on
+
+    // Let the current locker inherit the priority of the blocked thread if it is higher (moving it to the inherited level of the ready bitmap)
+    // The stack resource policy has no inheritance (the locker that set the ceiling is always allowed to run by schedule_edf)
+    if (scheduling_policy == RATE_MONOTONIC) {
+        tcb_t* blocking_thread = blocking_lock->current_locker;
+        thread_set_dynamic_priority(blocking_thread, MIN(blocking_thread->dynamic_priority, thread->dynamic_priority));
+    }
+    trace_record(TRACE_LOCK_BLOCK, index, m - user_locks);
+    return 0;
+}
+
 /**
  * Blocking system call for a user application to request control of a lock.
- * Locks requests are granted / denied according to the original priority ceiling protocol (see interior comments for details about what this implies).
- * Will not return until the lock has been acquired.
+ * Locks requests are granted / denied according to the original priority ceiling protocol (see lock_request).
+ * Under EDF the same ceiling test is already applied by schedule_edf before a thread starts (stack resource policy), so a running thread only blocks here if a lock holder overran its budget.
+ * Will not return to the thread until the lock has been acquired: a thread that has to wait stays blocked until an unlock hands the lock to it, so the syscall is complete by the time the thread runs again and nothing is kept on the shared kernel stack while it waits.
  * Since this syscall is blocking, it is guranteed that any thread will only be waiting on a maximum of 1 lock.
+ * Only reached when lock() in user space could not take the lock itself (some lock was already held), and lock_fast_sync has already accounted every lock taken in user space.
  */ 
 void syscall_lock(mutex_t* m) {
     // Forcibly end a thread that tries to access a lock with a lower priority ceiling than the current thread's priority (this break the initialization assumption)
@@ -677,6 +1995,7 @@ void syscall_lock(mutex_t* m) {
         // This thread should not be trying to lock this lock - end it
         printk("Thread%d tried to lock a mutex that has a lower priority ceiling than Thread%d's priority\n", user_threads[active_thread_index].id, user_threads[active_thread_index].id);
         syscall_thread_end();
+        return;
     }
 
     // Check if the active thread is the current holder of the lock (can lead to deadlock if trying to lock itself again)
@@ -686,59 +2005,22 @@ void syscall_lock(mutex_t* m) {
     }
 
     // Disable interrupts to make sure the locked mutex has its state completely updated before continuing
+    // A blocked thread invokes the scheduler (it only runs again once it holds the lock)
     disable_interrupts();
-    
-    // Check if the priority of the active thread is stricly higher than the current priority ceiling (if yes this thread can lock the lock)
-    // Can also lock the lock if this thread holds the highest priority lock (i.e. the locked lock that inflated the current priority ceiling)
-    // If either of these conditions are true, allow the thread to attempt to lock the lock (another thread still could have beaten it to this point since mutex_try uses atomic operations)
-    // mutex_try returns 0 on success
-    // If priority is not higher or thread does not hold the mutex, place the thread in the waiting queue for the lock
-    while (!(((user_threads[active_thread_index].dynamic_priority < global_priority_ceiling) || (highest_priority_lock->current_locker == &user_threads[active_thread_index])) && mutex_try(m) == 0)) {
-        // Disable interrupts so this syscall in particular is free from preemption (critical section enforcing critical sections)
-        disable_interrupts();
-        
-        user_threads[active_thread_index].state = ThreadBlocked;
-
-        // If the current lock is locked, set up as waiting for this lock to unlock
-        // Otherwise, the current highest locker (with its heightened global_priority_ceiling) caused the first condition to fail (i.e. lock was open but could not lock it)
-        if (mutex_is_locked(m)) {
-            m->blocked_threads[m->num_blocked_threads] = &user_threads[active_thread_index];
-            m->num_blocked_threads++;
-        } else {
-            highest_priority_lock->blocked_threads[highest_priority_lock->num_blocked_threads] = &user_threads[active_thread_index];
-            highest_priority_lock->num_blocked_threads++;
-        }
-
-        // Check if the priority of the current thread is higher than the priority of the thread that currently holds the lock
-        // Let the current locker inherit the priority of the active thread if it is higher
-        m->current_locker->dynamic_priority = MIN(m->current_locker->dynamic_priority, user_threads[active_thread_index].dynamic_priority);
-
-        // Reenable interrupts before calling scheduler
-        // When returning to this thread again, disable interrupts before rechecking condition
+    if (!lock_request(active_thread_index, m)) {
         enable_interrupts();
         set_pendsv();
-        disable_interrupts();
-    }
-
-    // Already acquired the lock in the above condition evaluation so if the thread makes it here, then it acquired the lock
-    m->current_locker = &user_threads[active_thread_index];
-
-    // Only update the priority ceiling if this lock was actually a higher priority ceiling than one already locked 
-    // Do not want to overwrite a higher priority lock if the second condition of holding the highest priority was true
-    if (m->priority_ceiling < global_priority_ceiling) {
-        global_priority_ceiling = m->priority_ceiling;
-        highest_priority_lock = m;
+        return;
     }
-
-    // Enable interrupts now that the lock has been acquired and global state is consistent
     enable_interrupts();
 }
 
 /** 
  * System call for unlocking the provided mutex `m` (opaque at user level).
- * Since threads are only waiting on a maximum of 1 lock (from above) and unlocks occur immediately (unconditionally), all threads waiting on this lock can immediately move to the ready state to contend for it again (those unsuccessful will go back to the blocked state).
- * Once unlocked, the current mutex has its num_blocked_threads and current_locker field reset (to keep state consistent).
- * After the mutex is unlocked, the new highest_priority_lck is determined, and the new prioriy of the running task is potentially changed to inherit a higher priority task's priority if it is blocking on a lock held by the current thread.
+ * Ownership passes straight to the waiters in priority order: each one gets the lock it asked for if the ceiling rules allow it now and is blocked again behind whichever lock stops it otherwise (usually `m` itself once the first waiter holds it).
+ * So a contended unlock makes at most one waiter ready for `m` instead of waking every waiter to contend for it again, and a waiter never runs only to block again.
+ * After the waiters are handed on, the dynamic priority of the running task is recomputed (it keeps the priority of the highest waiter on any lock that it still holds).
+ * Only reached when unlock() in user space could not release the lock itself (threads are blocked on it or it was not held).
  */ 
 void syscall_unlock(mutex_t* m) {
     // Do nothing if the lock was already unlocked
@@ -747,47 +2029,45 @@ void syscall_unlock(mutex_t* m) {
         return;
     }
 
-    // Update state of the mutex m and free all threads that are blocked by this lock (could immediately go back to sleep on another one but this was the original thing blocking them from progress)
-    for (uint8_t index = 0; index < m->num_blocked_threads; index++) {
-        m->blocked_threads[index]->state = ThreadReady;
-    }
-
     // Disable interrupts to make sure the unlocked mutex has its state completely updated before continuing
     disable_interrupts();
     
     // Unlock the mutex and reset status for mutex
+    trace_record(TRACE_UNLOCK, active_thread_index, m - user_locks);
+    // Popping the lock off the ceiling stack brings back the ceiling of the locks that are still locked (and the most important lock)
+    lock_stack_remove(m);
     mutex_unlock(m);
-    m->num_blocked_threads = 0;
     m->current_locker = 0;
+    lock_shared.held &= ~lock_bit(m);
+    lock_shared.contended &= ~lock_bit(m);
+    lock_held_seen &= ~lock_bit(m);
+
+    // Hand the lock on to the waiters from the highest priority down (each request is decided against the locks as they are after the previous one)
+    uint8_t waiter = m->wait_head;
+    m->wait_head = WAIT_QUEUE_END;
+    while (waiter != WAIT_QUEUE_END) {
+        uint8_t next = user_threads[waiter].wait_next;
+        if (lock_request(waiter, &user_locks[user_threads[waiter].wait_lock])) {
+            thread_set_state(&user_threads[waiter], ThreadReady);
+        }
+        waiter = next;
+    }
 
-    // Change the global priority ceiling to the highest priority ceiling of any locks that are still locked (and update the most important lock)
-    // Also potentially change the priority of the currently executing thread if it still holds another lock that a higher priority thread is waiting on (i.e. do not completely de-escalate the dynamic priority automatically back to static priority)
-    uint32_t new_global_ceiling = 0xFFFFFFFF;
-    mutex_t* new_highest_lock = 0;
-    user_threads[active_thread_index].dynamic_priority = user_threads[active_thread_index].static_priority; // Assume the thread goes back to its default static priority initially (which could be overwritten if another higher priority thread is still found to be waiting on it)
-
-    for (uint8_t lock_index = 0; lock_index < num_defined_locks; lock_index++) {
-        if (mutex_is_locked(&user_locks[lock_index])) {
-            if (user_locks[lock_index].priority_ceiling < new_global_ceiling) {
-                new_global_ceiling = user_locks[lock_index].priority_ceiling;
-                new_highest_lock = &user_locks[lock_index];
-            }
-
-            // The lock is locked but check if it is locked by the active thread
-            // If it is locked, potentially re-raise the priority of the thread again (i.e. increase the dynamic priority again and keep it elevated from its original priority)
-            if (user_locks[lock_index].current_locker == &user_threads[active_thread_index]) {
-                // Current thread is the locker so check to see if there are any other higher priority threads waiting on this lock
-                for (uint8_t thread_index = 0; thread_index < user_locks[lock_index].num_blocked_threads; thread_index++) {
-                    user_threads[active_thread_index].dynamic_priority = MIN(user_threads[active_thread_index].dynamic_priority, user_locks[lock_index].blocked_threads[thread_index]->dynamic_priority);
-                }
-            }
+    // Potentially change the priority of the currently executing thread if it still holds another lock that a higher priority thread is waiting on (i.e. do not completely de-escalate the dynamic priority automatically back to static priority)
+    // The head of a wait queue is its highest priority waiter so only the heads of the locks that it still holds are needed (its own stack of held locks, not every defined lock)
+    uint32_t new_dynamic_priority = user_threads[active_thread_index].static_priority; // Assume the thread goes back to its default static priority initially
+    if (user_threads[active_thread_index].demoted && (scheduling_policy == RATE_MONOTONIC)) {
+        new_dynamic_priority = THREAD_PRIORITY_BACKGROUND; // A demoted thread goes back to the background instead
+    }
+    for (uint8_t lock_index = user_threads[active_thread_index].held_top; lock_index != LOCK_STACK_END; lock_index = user_locks[lock_index].held_below) {
+        if (user_locks[lock_index].wait_head != WAIT_QUEUE_END) {
+            new_dynamic_priority = MIN(new_dynamic_priority, user_threads[user_locks[lock_index].wait_head].dynamic_priority);
         }
     }
 
-    // Update global locking fields
-    global_priority_ceiling = new_global_ceiling;
-    highest_priority_lock = new_highest_lock;
-    user_threads[active_thread_index].state = ThreadReady; // Change currently executing thread to ready (expected by scheduler since this was not a result of preemption)
+    // Update the running thread
+    thread_set_dynamic_priority(&user_threads[active_thread_index], new_dynamic_priority);
+    thread_set_state(&user_threads[active_thread_index], ThreadReady); // Change currently executing thread to ready (expected by scheduler since this was not a result of preemption)
     
     // Re-enable interrupts and invoke scheduler after mutex state has been made consistent
     enable_interrupts();
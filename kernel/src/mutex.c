@@ -12,9 +12,13 @@
 void mutex_init(volatile mutex_t *m) {
     m->s = 1;
     m->current_locker = NULL;
-    m->num_blocked_threads = 0;
     m->priority_ceiling = 0xFFFFFFFF;
     m->highest_locker_id = 0xFFFFFFFF;
+    m->critical_section = 0;
+    m->wait_head = WAIT_QUEUE_END;
+    m->stack_below = LOCK_STACK_END;
+    m->ceiling_lock = LOCK_STACK_END;
+    m->held_below = LOCK_STACK_END;
     data_mem_barrier(); // Ensure write occurs before other function calls
 }
 
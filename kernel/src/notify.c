@@ -0,0 +1,87 @@
+/** @file   notify.c
+ *  @brief  Implements notifications from interrupt handlers to threads blocked in driver syscalls.
+**/
+
+#include "notify.h"
+#include "multitask.h"
+#include "syscall.h"
+#include "error.h"
+
+/**
+ * Clears any pending signal and the waiter of `n` and records its `poll` function.
+ */
+void notify_init(notify_t* n, void (*poll)()) {
+    n->pending = 0;
+    n->waiter = NOTIFY_NO_WAITER;
+    n->poll = poll;
+}
+
+/**
+ * Every handler runs at the same priority as SVC, so a syscall cannot be interrupted by the handler it waits for.
+ * Spins on the poll function of `n` (which checks the peripheral events itself instead of running the interrupt handler) until the event happened.
+ * Only used for callers that cannot block (the main thread or code running before multitask_start). The interrupt stays pending and its handler finds the event already handled once the syscall returns.
+ */
+static void notify_poll(notify_t* n) {
+    while (!n->pending) {
+        n->poll();
+    }
+}
+
+/**
+ * Consumes the signal of `n` or blocks the running user thread until notify_signal wakes it.
+ * A blocked thread is rewound to its svc instruction (through svc_restart) so it keeps nothing on the shared kernel stack while it waits and spends none of its budget.
+ * Only a single thread can wait on a notification at a time, and it keeps the notification from when it blocks until it consumes the signal (so a thread calling in between cannot take the signal or strand it blocked).
+ */
+int notify_wait(notify_t* n) {
+    // A waiter that was ended while blocked can no longer consume the signal, so the notification is only refused while its waiter is alive
+    uint8_t waiter = n->waiter;
+    if ((waiter != NOTIFY_NO_WAITER) && (waiter != active_thread_index) && (user_threads[waiter].state != ThreadDefunct)) {
+        return DEVICE_BUSY;
+    }
+
+    // Only user threads can block (the idle and main thread are the fallback when nothing else can run)
+    if (active_thread_index >= num_user_threads) {
+        notify_poll(n);
+        n->pending = 0;
+        return 1;
+    }
+
+    // The handler could signal between the check and blocking so both happen with interrupts disabled
+    disable_interrupts();
+    if (n->pending) {
+        n->pending = 0;
+        n->waiter = NOTIFY_NO_WAITER;
+        enable_interrupts();
+        return 1;
+    }
+
+    n->waiter = active_thread_index;
+    thread_set_state(&user_threads[active_thread_index], ThreadBlocked);
+    svc_restart = 1;
+    enable_interrupts();
+    set_pendsv();
+    return 0;
+}
+
+/**
+ * Marks `n` as signalled and makes its waiter ready (the waiter consumes the signal and gives up the notification when its syscall is restarted).
+ * The decision is only pended if the woken thread should preempt the interrupted one (always the case when the idle thread was interrupted).
+ */
+void notify_signal(notify_t* n) {
+    n->pending = 1;
+    uint8_t index = n->waiter;
+    if (index == NOTIFY_NO_WAITER) {
+        return;
+    }
+
+    tcb_t* woken = &user_threads[index];
+    if (woken->state != ThreadBlocked) {
+        return;
+    }
+    thread_set_state(woken, ThreadReady);
+    trace_record(TRACE_NOTIFY_WAKE, index, active_exception());
+    if (release_preempts(woken, &user_threads[active_thread_index])) {
+        preemption_flag = 1;
+        set_pendsv();
+    }
+}
@@ -0,0 +1,151 @@
+/** @file   ring.c
+ *  @brief  Implements the kernel side of the single producer single consumer rings (allocation in the heap and blocking when a ring is empty or full).
+ *
+ *  The slots are filled and drained in place by user space (ring_reserve/ring_commit and ring_peek/ring_release in user/src/ring.c) and the kernel never copies them.
+ *  The kernel is only entered by a side that has to wait and by a commit or release that sees the waiting bit of the other side set.
+ *  The indices are checked and the bit is set in the same syscall (no thread runs in between), so a commit or release either lands before the check or sees the bit afterwards and is never missed.
+**/
+
+#include "ring.h"
+#include "sync.h"
+#include "multitask.h"
+#include "syscall.h"
+#include "error.h"
+#include "svc_num.h"
+
+/// Kernel side of the rings defined by the user application
+ring_t user_rings[MAX_USER_RINGS];
+
+/// Number of rings already defined by the user application
+uint8_t num_defined_rings = 0;
+
+/**
+ * Forgets every ring.
+ */
+void ring_reset() {
+    num_defined_rings = 0;
+}
+
+/**
+ * Returns the kernel side of the ring whose header is at `r` or NULL if `r` is not the header of a defined ring (headers come from user space so the index in them is checked against the kernel's own pointer).
+ */
+static ring_t* ring_lookup(ring_shared_t* r) {
+    extern uint32_t __heap_base;
+    extern uint32_t __heap_limit;
+    if (((uint32_t)r < (uint32_t)&__heap_base) || ((uint32_t)r + sizeof(ring_shared_t) > (uint32_t)&__heap_limit)) {
+        return NULL;
+    }
+    uint32_t index = r->index;
+    if ((index >= num_defined_rings) || (user_rings[index].shared != r)) {
+        return NULL;
+    }
+    return &user_rings[index];
+}
+
+/**
+ * Returns 1 if a wait for `what` on `ring` is satisfied (a committed slot for RING_WAIT_DATA and a free slot for RING_WAIT_SPACE).
+ */
+static uint32_t ring_ready(ring_t* ring, uint32_t what) {
+    uint32_t used = ring->shared->head - ring->shared->tail;
+    return (what == RING_WAIT_DATA) ? (used != 0) : (used < ring->num_slots);
+}
+
+/**
+ * Takes the header and the slots from the heap (word aligned so the indices can be read and written with single stores).
+ */
+ring_shared_t* syscall_ring_init(uint32_t slot_size, uint32_t num_slots) {
+    if ((num_defined_rings >= MAX_USER_RINGS) || (active_thread_index != (num_user_threads+1))) {
+        return NULL;
+    }
+    if ((slot_size == 0) || (num_slots < 2) || (num_slots & (num_slots - 1)) || (slot_size > 0x10000) || (num_slots > 0x10000)) {
+        return NULL;
+    }
+    slot_size = (slot_size + 3) & ~3u;
+
+    // Line the break up with a word before taking the ring (malloc may have left it anywhere)
+    uint32_t system_break = (uint32_t)syscall_sbrk(0);
+    uint32_t padding = (4 - (system_break & 3)) & 3;
+    if ((system_break == 0xFFFFFFFF) || (syscall_sbrk((int)padding) == (void *)-1)) {
+        return NULL;
+    }
+    // Bound the slots by the heap that is left so the size cannot wrap (0x10000 slots of 0x10000 bytes is 2^32)
+    extern uint32_t __heap_limit;
+    uint32_t available = (uint32_t)&__heap_limit - (system_break + padding);
+    if ((system_break + padding > (uint32_t)&__heap_limit) || (available < sizeof(ring_shared_t)) || (num_slots > (available - sizeof(ring_shared_t)) / slot_size)) {
+        return NULL;
+    }
+    ring_shared_t* r = syscall_sbrk((int)(sizeof(ring_shared_t) + slot_size * num_slots));
+    if (r == (void *)-1) {
+        return NULL;
+    }
+
+    r->head = 0;
+    r->tail = 0;
+    r->waiting = 0;
+    r->slot_size = slot_size;
+    r->num_slots = num_slots;
+    r->index = num_defined_rings;
+
+    ring_t* ring = &user_rings[num_defined_rings++];
+    ring->shared = r;
+    ring->num_slots = num_slots;
+    ring->data_wait_head = WAIT_QUEUE_END;
+    ring->space_wait_head = WAIT_QUEUE_END;
+    return r;
+}
+
+/**
+ * Returns right away if the wait is already satisfied and otherwise sets the waiting bit and blocks the running thread until ring_notify wakes it.
+ */
+int syscall_ring_wait(ring_shared_t* r, uint32_t what) {
+    ring_t* ring = ring_lookup(r);
+    if (ring == NULL) {
+        return SYNC_INVALID_OBJECT;
+    }
+    if ((what != RING_WAIT_DATA) && (what != RING_WAIT_SPACE)) {
+        return RING_INVALID_WAIT;
+    }
+    if (ring_ready(ring, what)) {
+        return SUCCESS;
+    }
+
+    int rv = sync_can_block();
+    if (rv < 0) {
+        return rv;
+    }
+    r->waiting |= what;
+    sync_block((what == RING_WAIT_DATA) ? &ring->data_wait_head : &ring->space_wait_head, SVC_RING_WAIT);
+    return SUCCESS;
+}
+
+/**
+ * Wakes every thread in the wait queue at `head` if the wait for `what` is satisfied (and clears the waiting bit of that side).
+ * Returns 1 if a woken thread should take the processor from the running thread.
+ */
+static uint32_t ring_wake(ring_t* ring, uint8_t* head, uint32_t what) {
+    if (!ring_ready(ring, what)) {
+        return 0;
+    }
+    uint32_t preempt = 0;
+    while (*head != WAIT_QUEUE_END) {
+        uint8_t index = *head;
+        *head = user_threads[index].wait_next;
+        preempt |= sync_wake(index);
+    }
+    ring->shared->waiting &= ~what;
+    return preempt;
+}
+
+/**
+ * Wakes the waiters of both sides whose wait is satisfied (there is normally only one thread on each side).
+ */
+int syscall_ring_notify(ring_shared_t* r) {
+    ring_t* ring = ring_lookup(r);
+    if (ring == NULL) {
+        return SYNC_INVALID_OBJECT;
+    }
+    uint32_t preempt = ring_wake(ring, &ring->data_wait_head, RING_WAIT_DATA);
+    preempt |= ring_wake(ring, &ring->space_wait_head, RING_WAIT_SPACE);
+    sync_preempt(preempt);
+    return SUCCESS;
+}
@@ -4,10 +4,13 @@
 
 #include "rtt.h"
 #include "arm.h"
+#include "trace.h"
+#include "semihost.h"
 
 extern rtt_control_block __rtt_start;
 static char up[RTT_UP_BUFFER_SIZE];
 static char down[RTT_DOWN_BUFFER_SIZE];
+static char trace[TRACE_BUFFER_SIZE];
 static rtt_control_block *cb;
 
 /**
@@ -17,7 +20,7 @@ static rtt_control_block *cb;
  */
 void rtt_init() {
     cb = &__rtt_start;
-    cb->num_up_buffers = 1;
+    cb->num_up_buffers = RTT_NUM_UP_BUFFERS;
     cb->up_buffer.name = "Terminal";
     cb->up_buffer.p = up;
     cb->up_buffer.buffer_size = RTT_UP_BUFFER_SIZE;
@@ -25,6 +28,13 @@ void rtt_init() {
     cb->up_buffer.r_idx = 0;
     cb->up_buffer.flags = 2;
 
+    cb->trace_buffer.name = "Trace";
+    cb->trace_buffer.p = trace;
+    cb->trace_buffer.buffer_size = TRACE_BUFFER_SIZE;
+    cb->trace_buffer.w_idx = 0;
+    cb->trace_buffer.r_idx = 0;
+    cb->trace_buffer.flags = 0; // Skip mode (the target drops data instead of waiting for the host)
+
     cb->num_down_buffers = 1;
     cb->down_buffer.name = "Terminal";
     cb->down_buffer.p = down;
@@ -51,6 +61,11 @@ uint32_t rtt_write(const char *src, uint32_t len) {
         return 0;
     }
 
+#ifdef TARGET_QEMU
+    // No debugger drains the up buffer on QEMU so the terminal goes straight to the console of the host
+    return semihost_write(src, len);
+#endif
+
     // Create pointer to up_buffer and get current value of write_index
     // Write index is deterministic (can just keep local copy and write to struct at end of loop)
     // r_idx is volatile and requires a fresh dereference each time
@@ -82,6 +97,35 @@ uint32_t rtt_write(const char *src, uint32_t len) {
     return src_character;
 }
 
+/**
+ * Copies `src` into the trace buffer only if all `len` bytes fit (keeping one byte free like rtt_write so that a full buffer is not mistaken for an empty one).
+ * The bytes are written before w_idx is published so the host never reads a partial record.
+ */
+uint32_t rtt_trace_write(const void *src, uint32_t len) {
+    // Interrupts can be enabled before the control block is set up in rtt_init
+    if (cb == NULL) {
+        return 0;
+    }
+
+    rtt_up_buffer* trace_buffer = &cb->trace_buffer;
+    uint32_t write_index = trace_buffer->w_idx;
+    uint32_t read_index = trace_buffer->r_idx;
+    const uint32_t buffer_size = trace_buffer->buffer_size;
+
+    uint32_t free_bytes = (read_index > write_index) ? (read_index - write_index - 1) : (buffer_size - write_index + read_index - 1);
+    if (len > free_bytes) {
+        return 0;
+    }
+
+    for (uint32_t byte = 0; byte < len; byte++) {
+        trace_buffer->p[write_index] = ((const char *)src)[byte];
+        write_index = (write_index + 1) >= buffer_size ? 0 : write_index+1;
+    }
+    data_mem_barrier(); // Record must be in the buffer before the host can see the new write index
+    trace_buffer->w_idx = write_index;
+    return len;
+}
+
 /** 
  * Populates the `dst` buffer with content from the down_buffer in the rtt_control block.
  * The debugger is responsible for writing bytes to this buffer, and any time w_idx > r_idx (wrapping), the controller can read values without fear of reading junk.
@@ -94,6 +138,14 @@ uint32_t rtt_read(char *dst, uint32_t len) {
         return 0;
     }
 
+#ifdef TARGET_QEMU
+    // Input comes from the console of the host on QEMU (blocking like the down buffer)
+    for (uint32_t read_character = 0; read_character < len; read_character++) {
+        dst[read_character] = semihost_read_char();
+    }
+    return len;
+#endif
+
     // Create pointer to down_buffer and get current value of read_index
     // Read index is deterministic (can just keep local copy and write to struct at end of loop)
     // w_idx is volatile and requires a fresh dereference each time
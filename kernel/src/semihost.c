@@ -0,0 +1,40 @@
+/** @file   semihost.c
+ *  @brief  Console and exit requests to the host through Arm semihosting (only called on the QEMU target).
+**/
+
+#include "semihost.h"
+
+/// Handle of the host console (opened by the first write)
+static uint32_t console_handle = 0xFFFFFFFF;
+
+/**
+ * Opens the console on the first call and writes all of `src` to it in a single request.
+ */
+uint32_t semihost_write(const char* src, uint32_t len) {
+    if (console_handle == 0xFFFFFFFF) {
+        uint32_t open_block[3] = {(uint32_t)":tt", SEMIHOST_OPEN_MODE_WRITE, 3};
+        console_handle = semihost_call(SEMIHOST_SYS_OPEN, open_block);
+        if (console_handle == 0xFFFFFFFF) {
+            return 0;
+        }
+    }
+
+    uint32_t write_block[3] = {console_handle, (uint32_t)src, len};
+    uint32_t not_written = semihost_call(SEMIHOST_SYS_WRITE, write_block);
+    return len - not_written;
+}
+
+/**
+ * SYS_READC takes no parameter block.
+ */
+char semihost_read_char() {
+    return (char)semihost_call(SEMIHOST_SYS_READC, NULL);
+}
+
+/**
+ * SYS_EXIT_EXTENDED passes the exit status on 32 bit targets as well (plain SYS_EXIT only takes a reason there).
+ */
+void semihost_exit(int status) {
+    uint32_t exit_block[2] = {SEMIHOST_ADP_STOPPED_APPLICATION_EXIT, (uint32_t)status};
+    semihost_call(SEMIHOST_SYS_EXIT_EXTENDED, exit_block);
+}
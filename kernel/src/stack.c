@@ -0,0 +1,106 @@
+/** @file   stack.c
+ *  @brief  First-fit allocator placing thread stacks at MPU subregion granularity within the thread stack areas.
+**/
+
+#include "stack.h"
+#include "mpu.h"
+
+/// Area holding the process (user) stacks of the threads
+stack_area_t thread_user_stack_area;
+
+/**
+ * Sets the bounds of `area` and clears the bitmap of used granules.
+ */
+void stack_area_init(stack_area_t* area, void* limit, uint32_t size) {
+    area->limit = (uint32_t)limit;
+    area->base = (uint32_t)limit + size;
+    for (uint32_t word = 0; word < STACK_AREA_GRANULES / 32; word++) {
+        area->used[word] = 0;
+    }
+}
+
+/**
+ * A region of 2^k bytes has eight subregions of 2^(k-3) bytes, so any multiple of 2^(k-3) up to 2^k can be covered by enabling only the subregions it occupies.
+ * This wastes at most one subregion (under an eighth of the region) instead of up to half of it when rounding to a power of two.
+ */
+uint32_t stack_size_round(uint32_t size) {
+    uint32_t subregion_bytes = (1 << mpu_region_log2_for(size)) / MPU_SUBREGIONS;
+    return (size + subregion_bytes - 1) & ~(subregion_bytes - 1);
+}
+
+/**
+ * Returns 1 if every granule in [`start`, `end`) of `area` is free.
+ */
+uint32_t stack_range_free(stack_area_t* area, uint32_t start, uint32_t end) {
+    for (uint32_t granule = (start - area->limit) / STACK_GRANULE_BYTES; granule < (end - area->limit) / STACK_GRANULE_BYTES; granule++) {
+        if (area->used[granule / 32] & (1u << (granule % 32))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Marks every granule in [`start`, `end`) of `area` as used (`used` = 1) or free (`used` = 0).
+ */
+void stack_range_mark(stack_area_t* area, uint32_t start, uint32_t end, uint32_t used) {
+    for (uint32_t granule = (start - area->limit) / STACK_GRANULE_BYTES; granule < (end - area->limit) / STACK_GRANULE_BYTES; granule++) {
+        if (used) {
+            area->used[granule / 32] |= (1u << (granule % 32));
+        } else {
+            area->used[granule / 32] &= ~(1u << (granule % 32));
+        }
+    }
+}
+
+/**
+ * Walks every naturally aligned block of the MPU region size for this stack (lowest address first) and every subregion offset within the block.
+ * The first free placement is taken, so the stack never crosses a block boundary and can always be covered by one region with the unused subregions disabled.
+ */
+void* stack_alloc(stack_area_t* area, uint32_t size) {
+    uint32_t block_bytes = 1 << mpu_region_log2_for(size);
+    uint32_t subregion_bytes = block_bytes / MPU_SUBREGIONS;
+    uint32_t subregions = size / subregion_bytes;
+
+    for (uint32_t block = area->limit & ~(block_bytes - 1); block < area->base; block += block_bytes) {
+        for (uint32_t first = 0; first + subregions <= MPU_SUBREGIONS; first++) {
+            uint32_t start = block + first*subregion_bytes;
+            uint32_t end = start + size;
+            if ((start < area->limit) || (end > area->base)) continue;
+
+            if (stack_range_free(area, start, end)) {
+                stack_range_mark(area, start, end, 1);
+                return (void*)start;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Clears the granules of the stack so that later allocations can reuse them.
+ */
+void stack_free(stack_area_t* area, void* limit, uint32_t size) {
+    stack_range_mark(area, (uint32_t)limit, (uint32_t)limit + size, 0);
+}
+
+/**
+ * Paints whole words only (a stack pointer is always word aligned).
+ */
+void stack_paint(void* limit, void* end) {
+    for (uint32_t* word = (uint32_t*)limit; word < (uint32_t*)end; word++) {
+        *word = STACK_PAINT_PATTERN;
+    }
+}
+
+/**
+ * Stacks grow down so the lowest word that no longer holds the pattern is the deepest point reached.
+ * A value that happens to equal the pattern right at the edge can make the mark a few words too low (the usual limitation of painting).
+ */
+uint32_t stack_high_water(void* limit, void* base) {
+    uint32_t* word = (uint32_t*)limit;
+    while ((word < (uint32_t*)base) && (*word == STACK_PAINT_PATTERN)) {
+        word++;
+    }
+    return (uint32_t)base - (uint32_t)word;
+}
@@ -12,6 +12,12 @@ stepper_t attached_stepper;
 /// Boolean flag indicated if the stepper motor has been initialized (motor must be initialized before any other actions can be done)
 uint8_t stepper_init_called = 0;
 
+/// Signalled by the TIMER0 handler once the last step of the move started by stepper_move has been applied
+notify_t stepper_move_done;
+
+/// Set while a move started by stepper_move is in progress (so the restarted syscall of a thread that blocked on it does not start the move again)
+uint8_t stepper_move_started = 0;
+
 /**
  * Initialize a stepper motor configuration in the global `attached_stepper`.
  * Start the 4-step control sequence at step zero and forward direction. 
@@ -41,6 +47,8 @@ int stepper_init(uint32_t steps_per_revolution, gpio_port control_port_1, uint32
     attached_stepper.control_port_4 = control_port_4;
     attached_stepper.control_pin_4 = control_pin_4;
 
+    stepper_move_started = 0;
+    notify_init(&stepper_move_done, timer0_compare_event);
     stepper_init_called = 1;
     return SUCCESS;
 }
@@ -63,24 +71,39 @@ int stepper_speed(uint32_t rpm) {
  * Move the stepper motor through a number of steps according to `step_to_move`.
  * Initializes a timer peripheral to begin firing interrupts at a rate equal to the `step_delay_us` of the attached stepper.
  * Interrupts are fired repeatedly until steps_to_move have been counted, after which the timer peripheral is de-activated.
- * This call is blocking so that user threads can accurately profile the time needed to turn the motor (i.e. do not have to dynamically change the task period based on how often the motor needs to be turned - can eliminate yielding by just treating the interrupt handler as work)
+ * This call is blocking so that user threads do not have to dynamically change the task period based on how often the motor needs to be turned.
+ * A calling user thread is blocked on stepper_move_done until the TIMER0 handler applied the last step (the syscall is restarted once it is woken), so the time between steps goes to other threads instead of a busy loop.
  * Both CW and CCW directions are supported (sign of steps_to_move indicates direction with positive indicating CW and negative indicating CCW).
  */
 int stepper_move(int32_t steps_to_move) {
     // Return early if the incorrect number of steps
     if (!stepper_init_called) return STEPPER_MOTOR_UNINITIALIZED;
     
-    // Set direction based on sign of arguement
-    if (steps_to_move >= 0) {
-        attached_stepper.direction = StepperCW;
-    } else {
-        attached_stepper.direction = StepperCCW;
+    if (!stepper_move_started) {
+        // Nothing to wait for
+        if (steps_to_move == 0) return SUCCESS;
+
+        // Set direction based on sign of arguement
+        if (steps_to_move >= 0) {
+            attached_stepper.direction = StepperCW;
+        } else {
+            attached_stepper.direction = StepperCCW;
+        }
+
+        // Start timer and fire the correct number of interrupts until steps are handled
+        notify_init(&stepper_move_done, timer0_compare_event);
+        stepper_move_started = 1;
+        timer0_num_interrupts_after_start = steps_to_move >= 0 ? steps_to_move : -steps_to_move;
+        timer0_start();
     }
 
-    // Start timer and fire the correct number of interrupts until steps are handled
-    timer0_num_interrupts_after_start = steps_to_move >= 0 ? steps_to_move : -steps_to_move;
-    timer0_start();
-    while (timer0_num_interrupts_already_handled < timer0_num_interrupts_after_start) continue; // Wait in a busy loop until the TIMER handler has handled the correct number of interrupts
+    // Wait until the TIMER handler has handled the correct number of interrupts (the return value is discarded if the thread was blocked instead)
+    // Another thread is refused while the move it did not start is still running
+    int rv = notify_wait(&stepper_move_done);
+    if (rv <= 0) {
+        return (rv < 0) ? rv : SUCCESS;
+    }
+    stepper_move_started = 0;
     return SUCCESS;
 }
 
@@ -0,0 +1,331 @@
+/** @file   sync.c
+ *  @brief  Implements counting semaphores, event flag groups, and condition variables on top of the blocked state of the scheduler.
+ *
+ *  A thread that has to wait is blocked in a priority ordered wait queue (linked through wait_next like the wait queues of the locks) and spends none of its budget until it is woken.
+ *  Waiters are handed what they waited for by the thread that wakes them (a unit of a semaphore, the flags of an event group, or the lock of a condition variable), so the syscall is complete once the waiter runs again and it never has to be restarted.
+ *  A thread may not block on these objects while it holds a lock, since the priority ceiling protocol only bounds blocking for threads that hold their locks until they unlock them.
+**/
+
+#include "sync.h"
+#include "multitask.h"
+#include "error.h"
+#include "printk.h"
+#include "svc_num.h"
+
+/// Semaphores for coordination between user threads
+semaphore_t user_semaphores[MAX_USER_SEMAPHORES];
+
+/// Number of semaphores already defined by the user application
+uint8_t num_defined_semaphores = 0;
+
+/// Event flag groups for coordination between user threads
+event_group_t user_event_groups[MAX_USER_EVENT_GROUPS];
+
+/// Number of event flag groups already defined by the user application
+uint8_t num_defined_event_groups = 0;
+
+/// Condition variables for coordination between user threads
+cond_t user_conds[MAX_USER_CONDS];
+
+/// Number of condition variables already defined by the user application
+uint8_t num_defined_conds = 0;
+
+/**
+ * Forgets every semaphore, event group, and condition variable.
+ */
+void sync_reset() {
+    num_defined_semaphores = 0;
+    num_defined_event_groups = 0;
+    num_defined_conds = 0;
+}
+
+/**
+ * Returns 1 if `object` is the address of one of the first `defined` elements (of `size` bytes each) of `pool` and 0 otherwise (handles come from user space so they are checked before they are used).
+ */
+static uint32_t sync_object_valid(const void* object, const void* pool, uint32_t size, uint32_t defined) {
+    uint32_t offset = (uint32_t)object - (uint32_t)pool;
+    return ((uint32_t)object >= (uint32_t)pool) && (offset < size * defined) && ((offset % size) == 0);
+}
+
+/**
+ * Returns 0 if the running thread may block and a negative error code otherwise.
+ * Only user threads can block (the idle and main thread are the fallback when nothing else can run), and a thread holding a lock would keep every thread above the ceiling of that lock waiting for as long as it is blocked.
+ */
+int sync_can_block() {
+    if (active_thread_index >= num_user_threads) {
+        return SYNC_WAIT_CANNOT_BLOCK;
+    }
+    if (active_thread_holds_locks()) {
+        printk("Thread%d tried to wait while holding a lock\n", user_threads[active_thread_index].id);
+        return SYNC_WAIT_HOLDING_LOCK;
+    }
+    return SUCCESS;
+}
+
+/**
+ * Blocks the running thread in the wait queue starting at `head` and invokes the scheduler (`svc_num` is the wait that blocked it).
+ */
+void sync_block(uint8_t* head, uint32_t svc_num) {
+    thread_set_state(&user_threads[active_thread_index], ThreadBlocked);
+    wait_queue_insert(head, active_thread_index);
+    trace_record(TRACE_SYNC_BLOCK, active_thread_index, svc_num);
+    set_pendsv();
+}
+
+/**
+ * Makes the blocked thread at `index` ready.
+ * Returns 1 if it should take the processor from the running thread.
+ */
+uint32_t sync_wake(uint8_t index) {
+    thread_set_state(&user_threads[index], ThreadReady);
+    trace_record(TRACE_SYNC_WAKE, index, active_thread_index);
+    return release_preempts(&user_threads[index], &user_threads[active_thread_index]);
+}
+
+/**
+ * Invokes the scheduler if `preempt` is set (a woken thread should run before the caller).
+ */
+void sync_preempt(uint32_t preempt) {
+    if (preempt) {
+        preemption_flag = 1;
+        set_pendsv();
+    }
+}
+
+/**
+ * Defines the next semaphore with `count` units.
+ */
+semaphore_t* syscall_sem_init(uint32_t count) {
+    if ((num_defined_semaphores >= MAX_USER_SEMAPHORES) || (active_thread_index != (num_user_threads+1))) {
+        return NULL;
+    }
+    semaphore_t* s = &user_semaphores[num_defined_semaphores++];
+    s->count = count;
+    s->wait_head = WAIT_QUEUE_END;
+    return s;
+}
+
+/**
+ * Takes a unit of `s` or blocks the running thread until sem_post hands one to it (the unit never goes through the count so a thread that runs in between cannot take it).
+ */
+int syscall_sem_wait(semaphore_t* s) {
+    if (!sync_object_valid(s, user_semaphores, sizeof(semaphore_t), num_defined_semaphores)) {
+        return SYNC_INVALID_OBJECT;
+    }
+    if (s->count > 0) {
+        s->count--;
+        return SUCCESS;
+    }
+
+    int rv = sync_can_block();
+    if (rv < 0) {
+        return rv;
+    }
+    sync_block(&s->wait_head, SVC_SEM_WAIT);
+    return SUCCESS;
+}
+
+/**
+ * Takes a unit of `s` if one is available.
+ */
+int syscall_sem_try_wait(semaphore_t* s) {
+    if (!sync_object_valid(s, user_semaphores, sizeof(semaphore_t), num_defined_semaphores)) {
+        return SYNC_INVALID_OBJECT;
+    }
+    if (s->count == 0) {
+        return 1;
+    }
+    s->count--;
+    return SUCCESS;
+}
+
+/**
+ * Hands a unit of `s` to its highest priority waiter or adds it to the count.
+ */
+int syscall_sem_post(semaphore_t* s) {
+    if (!sync_object_valid(s, user_semaphores, sizeof(semaphore_t), num_defined_semaphores)) {
+        return SYNC_INVALID_OBJECT;
+    }
+    uint8_t index = s->wait_head;
+    if (index == WAIT_QUEUE_END) {
+        s->count++;
+        return SUCCESS;
+    }
+    s->wait_head = user_threads[index].wait_next;
+    sync_preempt(sync_wake(index));
+    return SUCCESS;
+}
+
+/**
+ * Defines the next event flag group with every flag clear.
+ */
+event_group_t* syscall_event_group_init() {
+    if ((num_defined_event_groups >= MAX_USER_EVENT_GROUPS) || (active_thread_index != (num_user_threads+1))) {
+        return NULL;
+    }
+    event_group_t* g = &user_event_groups[num_defined_event_groups++];
+    g->flags = 0;
+    g->wait_head = WAIT_QUEUE_END;
+    return g;
+}
+
+/**
+ * Returns the flags of `mask` that satisfy a wait with `options` when `flags` are set (0 if the wait is not satisfied yet).
+ */
+static uint32_t event_matched(uint32_t flags, uint32_t mask, uint32_t options) {
+    if (options & EVENT_WAIT_ALL) {
+        return ((flags & mask) == mask) ? mask : 0;
+    }
+    return flags & mask;
+}
+
+/**
+ * Returns the flags that satisfy the wait right away or blocks the running thread until event_set satisfies it.
+ * The flags are then stored in the r0 of the frame of the waiter by event_set (the value returned here is overwritten).
+ */
+uint32_t syscall_event_wait(event_group_t* g, uint32_t mask, uint32_t options) {
+    if ((mask == 0) || !sync_object_valid(g, user_event_groups, sizeof(event_group_t), num_defined_event_groups)) {
+        return 0;
+    }
+    uint32_t matched = event_matched(g->flags, mask, options);
+    if (matched) {
+        if (options & EVENT_WAIT_CLEAR) {
+            g->flags &= ~matched;
+        }
+        return matched;
+    }
+
+    if (sync_can_block() < 0) {
+        return 0;
+    }
+    user_threads[active_thread_index].wait_mask = mask;
+    user_threads[active_thread_index].wait_options = (uint8_t)options;
+    sync_block(&g->wait_head, SVC_EVENT_WAIT);
+    return 0;
+}
+
+/**
+ * Sets `flags` and wakes the waiters that are satisfied from the highest priority down (a waiter that clears what it consumed can leave later waiters unsatisfied).
+ */
+int syscall_event_set(event_group_t* g, uint32_t flags) {
+    if (!sync_object_valid(g, user_event_groups, sizeof(event_group_t), num_defined_event_groups)) {
+        return SYNC_INVALID_OBJECT;
+    }
+    g->flags |= flags;
+
+    uint32_t preempt = 0;
+    uint8_t* link = &g->wait_head;
+    while (*link != WAIT_QUEUE_END) {
+        uint8_t index = *link;
+        tcb_t* waiter = &user_threads[index];
+        uint32_t matched = event_matched(g->flags, waiter->wait_mask, waiter->wait_options);
+        if (!matched) {
+            link = &waiter->wait_next;
+            continue;
+        }
+
+        // The waiter returns from its event_wait with the flags it waited for
+        *link = waiter->wait_next;
+        if (waiter->wait_options & EVENT_WAIT_CLEAR) {
+            g->flags &= ~matched;
+        }
+        thread_stack_frame(index)->r0 = matched;
+        preempt |= sync_wake(index);
+    }
+    sync_preempt(preempt);
+    return SUCCESS;
+}
+
+/**
+ * Clears `flags` (nobody can be woken by clearing a flag).
+ */
+uint32_t syscall_event_clear(event_group_t* g, uint32_t flags) {
+    if (!sync_object_valid(g, user_event_groups, sizeof(event_group_t), num_defined_event_groups)) {
+        return 0;
+    }
+    uint32_t previous = g->flags;
+    g->flags &= ~flags;
+    return previous;
+}
+
+/**
+ * Defines the next condition variable.
+ */
+cond_t* syscall_cond_init() {
+    if ((num_defined_conds >= MAX_USER_CONDS) || (active_thread_index != (num_user_threads+1))) {
+        return NULL;
+    }
+    cond_t* c = &user_conds[num_defined_conds++];
+    c->wait_head = WAIT_QUEUE_END;
+    return c;
+}
+
+/**
+ * Releases `m` through syscall_unlock (handing it to its highest priority waiter) and blocks the running thread on `c`.
+ * The lock the thread has to take back is recorded in wait_lock so that a signal can request it on behalf of the thread.
+ */
+int syscall_cond_wait(cond_t* c, mutex_t* m) {
+    if (!sync_object_valid(c, user_conds, sizeof(cond_t), num_defined_conds) || !sync_object_valid(m, user_locks, sizeof(mutex_t), num_defined_locks)) {
+        return SYNC_INVALID_OBJECT;
+    }
+    if (active_thread_index >= num_user_threads) {
+        return SYNC_WAIT_CANNOT_BLOCK;
+    }
+
+    // The lock has to be the only one held (so the thread holds no lock while it is blocked)
+    tcb_t* thread = &user_threads[active_thread_index];
+    if ((m->current_locker != thread) || (thread->held_top != (uint8_t)(m - user_locks)) || (m->held_below != LOCK_STACK_END)) {
+        printk("Thread%d waited on a condition variable without holding only its lock\n", thread->id);
+        return COND_WAIT_LOCK_NOT_HELD;
+    }
+
+    // Unlocking leaves the thread ready at its own priority and invokes the scheduler, so only the state is changed afterwards
+    syscall_unlock(m);
+    thread->wait_lock = (uint8_t)(m - user_locks);
+    thread_set_state(thread, ThreadBlocked);
+    wait_queue_insert(&c->wait_head, active_thread_index);
+    trace_record(TRACE_SYNC_BLOCK, active_thread_index, SVC_COND_WAIT);
+    return SUCCESS;
+}
+
+/**
+ * Takes the highest priority waiter off `c` and requests its lock for it (it is either made ready holding the lock or blocked in the wait queue of whatever lock stops it, with the holder inheriting its priority like any other lock request).
+ * Returns 1 if the waiter should take the processor from the running thread.
+ */
+static uint32_t cond_wake_one(cond_t* c) {
+    uint8_t index = c->wait_head;
+    c->wait_head = user_threads[index].wait_next;
+
+    disable_interrupts();
+    uint32_t granted = lock_request(index, &user_locks[user_threads[index].wait_lock]);
+    enable_interrupts();
+    return granted ? sync_wake(index) : 0;
+}
+
+/**
+ * Wakes the highest priority waiter of `c` (if any).
+ */
+int syscall_cond_signal(cond_t* c) {
+    if (!sync_object_valid(c, user_conds, sizeof(cond_t), num_defined_conds)) {
+        return SYNC_INVALID_OBJECT;
+    }
+    if (c->wait_head != WAIT_QUEUE_END) {
+        sync_preempt(cond_wake_one(c));
+    }
+    return SUCCESS;
+}
+
+/**
+ * Wakes every waiter of `c` from the highest priority down (they share one lock so usually only the first one gets it and the others queue behind it).
+ */
+int syscall_cond_broadcast(cond_t* c) {
+    if (!sync_object_valid(c, user_conds, sizeof(cond_t), num_defined_conds)) {
+        return SYNC_INVALID_OBJECT;
+    }
+    uint32_t preempt = 0;
+    while (c->wait_head != WAIT_QUEUE_END) {
+        preempt |= cond_wake_one(c);
+    }
+    sync_preempt(preempt);
+    return SUCCESS;
+}
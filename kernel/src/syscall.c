@@ -6,21 +6,49 @@
 #include "syscall.h"
 #include "peripheral_trap.h"
 #include "multitask.h"
+#include "sync.h"
+#include "ring.h"
 #include "rtt.h"
 #include "printk.h"
 #include "gpio.h"
+#include "semihost.h"
+
+/// Set by a syscall that blocked the calling thread (consumed at the end of SVC_C_Handler)
+uint8_t svc_restart = 0;
+
+/**
+ * Returns the stack pointer of the caller before hardware stacked the frame `s` (where the arguements after the 4th are).
+ * The frame is extended with FP state if bit 4 of `exc_return` is clear, and hardware skips a word above it (flagged in the stacked xPSR) if the caller's stack was not 8 byte aligned.
+ */
+static uint32_t* syscall_caller_stack(stack_frame_t* s, uint32_t exc_return) {
+    uint32_t frame_words = (exc_return & EXC_RETURN_BASIC_FRAME) ? (sizeof(stack_frame_t) / sizeof(uint32_t)) : STACK_FRAME_EXTENDED_WORDS;
+    if (s->xpsr & STACK_FRAME_XPSR_PADDED) {
+        frame_words++;
+    }
+    return (uint32_t*)s + frame_words;
+}
 
 /**
  * Takes the provided stack pointer and retrieves the value of the PC (next instruction to execute in user space).
  * Uses the PC to retreive the SVC instruction with the svc_num immediate value.
  * Calls the appropriate syscall implementation depending on the svc_num in the svc instruction.
  */
-void SVC_C_Handler(void *psp) {
+void SVC_C_Handler(void *psp, uint32_t exc_return) {
     stack_frame_t *s = (stack_frame_t *)psp;
+    uint32_t* stacked_args = syscall_caller_stack(s, exc_return);
 
     // svc_num is located in the lower byte of the previously executed svc instruction (also was a thumb instruction so only 2 bytes subtracted)
     // System is also little endian so the desired byte is the lower addressable byte (i.e. want pc-2 so just immediately derefrence this byte)
     uint8_t svc_num = *(uint8_t*)(s->pc - 2);
+    uint32_t first_arg = s->r0; // Restored if the syscall blocks (the return value of a blocked syscall would otherwise replace its first arguement)
+    trace_record(TRACE_SVC_ENTER, active_thread_index, svc_num);
+
+    // Locks taken or released in user space since the last kernel entry belong to the caller (it is ended and its syscall dropped if the lock words do not check out)
+    if (lock_fast_sync()) {
+        syscall_thread_end();
+        trace_record(TRACE_SVC_EXIT, active_thread_index, svc_num);
+        return;
+    }
 
     // Place return value in s->r0 for syscalls that return a value (casting any return value to uint32_t)
     // Also places the expected number of arguements in the correct order from r0, r1, r2, and r3 with casts to correct arguement type
@@ -40,12 +68,22 @@ void SVC_C_Handler(void *psp) {
         syscall_neopixel_set((uint8_t)s->r0, (uint8_t)s->r1, (uint8_t)s->r2, s->r3); // Returns nothing (void)
     } else if (svc_num == SVC_NEOPIXEL_LOAD) {
         syscall_neopixel_load(); // Returns nothing (void)
+    } else if (svc_num == SVC_SERVER_DEFINE) {
+        s->r0 = (uint32_t)syscall_server_define(s->r0, (void *)s->r1, (void *)s->r2, s->r3, stacked_args[0], stacked_args[1]); // 5th and 6th arguements are on the caller's stack above the hardware frame
+    } else if (svc_num == SVC_SERVER_WAIT) {
+        s->r0 = (uint32_t)syscall_server_wait(s->r0);
+    } else if (svc_num == SVC_SERVER_NOTIFY) {
+        s->r0 = (uint32_t)syscall_server_notify(s->r0, s->r1);
+    } else if (svc_num == SVC_THREAD_DEADLINE_STATS) {
+        s->r0 = (uint32_t)syscall_thread_deadline_stats(s->r0, (deadline_stats_t *)s->r1);
+    } else if (svc_num == SVC_THREAD_DEADLINE_POLICY) {
+        s->r0 = (uint32_t)syscall_thread_deadline_policy(s->r0, s->r1);
     } else if (svc_num == SVC_MULTITASK_REQUEST) {
-        s->r0 = (uint32_t)syscall_multitask_request(s->r0, s->r1, (void *)s->r2, s->r3, *((uint32_t*)psp + 8)); // 5th arguement is on stack after all 8 other registers
+        s->r0 = (uint32_t)syscall_multitask_request(s->r0, s->r1, (void *)s->r2, s->r3, stacked_args[0], stacked_args[1]); // 5th and 6th arguements are on the caller's stack above the hardware frame
     } else if (svc_num == SVC_THREAD_DEFINE) {
-        s->r0 = (uint32_t)syscall_thread_define(s->r0, (void *)s->r1, (void *)s->r2, s->r3, *((uint32_t*)psp + 8)); // 5th arguement is on stack after all 8 other registers
+        s->r0 = (uint32_t)syscall_thread_define(s->r0, (void *)s->r1, (void *)s->r2, s->r3, stacked_args[0], stacked_args[1]); // 5th and 6th arguements are on the caller's stack above the hardware frame
     } else if (svc_num == SVC_MULTITASK_START) {
-        s->r0 = (uint32_t)syscall_multitask_start(s->r0);
+        s->r0 = (uint32_t)syscall_multitask_start(s->r0, s->r1);
     } else if (svc_num == SVC_THREAD_ID) {
         s->r0 = (uint32_t)syscall_thread_id();
     } else if (svc_num == SVC_THREAD_YIELD) {
@@ -58,19 +96,68 @@ void SVC_C_Handler(void *psp) {
         s->r0 = (uint32_t)syscall_thread_time();
     } else if (svc_num == SVC_THREAD_PRIORITY) {
         s->r0 = (uint32_t)syscall_thread_priority();
+    } else if (svc_num == SVC_THREAD_RESPONSE_TIME) {
+        s->r0 = (uint32_t)syscall_thread_response_time(s->r0);
     } else if (svc_num == SVC_LOCK_INIT) {
-        s->r0 = (uint32_t)syscall_lock_init(s->r0);
+        s->r0 = (uint32_t)syscall_lock_init(s->r0, s->r1);
     } else if (svc_num == SVC_LOCK) {
         syscall_lock((mutex_t *)s->r0); // Returns nothing (void)
     } else if (svc_num == SVC_UNLOCK) {
         syscall_unlock((mutex_t *)s->r0); // Returns nothing (void)
+    } else if (svc_num == SVC_THREAD_CYCLES) {
+        s->r0 = (uint32_t)syscall_thread_cycles(s->r0, (cycle_counters_t *)s->r1);
+    } else if (svc_num == SVC_THREAD_STACK_USAGE) {
+        s->r0 = (uint32_t)syscall_thread_stack_usage(s->r0, (stack_usage_t *)s->r1);
+    } else if (svc_num == SVC_CYCLE_COUNT) {
+        s->r0 = syscall_cycle_count();
+    } else if (svc_num == SVC_SWITCH_CYCLES) {
+        s->r0 = syscall_switch_cycles();
     } else if (svc_num == SVC_STEPPER_SET_SPEED) {
         s->r0 = (uint32_t)syscall_stepper_set_speed(s->r0);
     } else if (svc_num == SVC_STEPPER_MOVE) {
         s->r0 = (uint32_t)syscall_stepper_move_steps((int32_t)s->r0);
     } else if (svc_num == SVC_ULTRASONIC_SENSOR_READ) {
         s->r0 = (uint32_t)syscall_ultrasonic_read();
+    } else if (svc_num == SVC_SEM_INIT) {
+        s->r0 = (uint32_t)syscall_sem_init(s->r0);
+    } else if (svc_num == SVC_SEM_WAIT) {
+        s->r0 = (uint32_t)syscall_sem_wait((semaphore_t *)s->r0);
+    } else if (svc_num == SVC_SEM_TRY_WAIT) {
+        s->r0 = (uint32_t)syscall_sem_try_wait((semaphore_t *)s->r0);
+    } else if (svc_num == SVC_SEM_POST) {
+        s->r0 = (uint32_t)syscall_sem_post((semaphore_t *)s->r0);
+    } else if (svc_num == SVC_EVENT_GROUP_INIT) {
+        s->r0 = (uint32_t)syscall_event_group_init();
+    } else if (svc_num == SVC_EVENT_WAIT) {
+        s->r0 = syscall_event_wait((event_group_t *)s->r0, s->r1, s->r2);
+    } else if (svc_num == SVC_EVENT_SET) {
+        s->r0 = (uint32_t)syscall_event_set((event_group_t *)s->r0, s->r1);
+    } else if (svc_num == SVC_EVENT_CLEAR) {
+        s->r0 = syscall_event_clear((event_group_t *)s->r0, s->r1);
+    } else if (svc_num == SVC_COND_INIT) {
+        s->r0 = (uint32_t)syscall_cond_init();
+    } else if (svc_num == SVC_COND_WAIT) {
+        s->r0 = (uint32_t)syscall_cond_wait((cond_t *)s->r0, (mutex_t *)s->r1);
+    } else if (svc_num == SVC_COND_SIGNAL) {
+        s->r0 = (uint32_t)syscall_cond_signal((cond_t *)s->r0);
+    } else if (svc_num == SVC_COND_BROADCAST) {
+        s->r0 = (uint32_t)syscall_cond_broadcast((cond_t *)s->r0);
+    } else if (svc_num == SVC_RING_INIT) {
+        s->r0 = (uint32_t)syscall_ring_init(s->r0, s->r1);
+    } else if (svc_num == SVC_RING_WAIT) {
+        s->r0 = (uint32_t)syscall_ring_wait((ring_shared_t *)s->r0, s->r1);
+    } else if (svc_num == SVC_RING_NOTIFY) {
+        s->r0 = (uint32_t)syscall_ring_notify((ring_shared_t *)s->r0);
+    }
+
+    // A syscall that blocked is run again when its thread is next scheduled (the arguements are still in the stacked registers)
+    // Blocking this way keeps nothing on the shared kernel stack while the thread waits
+    if (svc_restart) {
+        svc_restart = 0;
+        s->r0 = first_arg;
+        s->pc -= 2;
     }
+    trace_record(TRACE_SVC_EXIT, active_thread_index, svc_num);
 }
 
 /// External symbol for accessing heap base (linker script symbol)
@@ -152,6 +239,10 @@ void syscall_exit(int status) {
     // Print status message
     printk("User space returned with status: %d\n", status);
 
+#ifdef TARGET_QEMU
+    // End the QEMU process with the status of the application (so a headless run reports it)
+    semihost_exit(status);
+#else
     // Toggle error LED if status was nonzero (red LED is on P1.15)
     if (status) {
         gpio_port error_port = P1;
@@ -161,6 +252,7 @@ void syscall_exit(int status) {
         gpio_init(error_port, error_pin, Output, Pullnone, S0S1);
         gpio_set(error_port, error_pin);
     }
+#endif
 
     // Disable interrupts and exceptions then wait infinitely for interrupts after exiting (should never occur)
     disable_interrupts();
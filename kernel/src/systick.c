@@ -68,16 +68,22 @@ void systick_delay(uint32_t ms) {
 /**
  * Handles the SysTick exception generated by the SysTick counter when the current value reaches 0.
  * Modifies global variables relating to the number of times that the counter has reached 0. 
- * Performs scheduling (via setting PendSV to high) on every timer_wrap_comparison'th invocation of the handler (i.e. the actual scheduling does not happen until timer_wrap_around equals the timer_wrap_comparison)
+ * Advances scheduler time on every timer_wrap_comparison'th invocation of the handler (i.e. the actual tick does not happen until timer_wrap_around equals the timer_wrap_comparison)
+ * Scheduling (via setting PendSV to high) is only performed on ticks where the scheduler reports that a new decision is needed (a release or an exhausted budget)
  */
 void SysTick_Handler() {
+    uint32_t isr_start = isr_enter();
+
     // Reset to 0 if this is the timer_wrap_comparison'th wrap (starting at 1)
     // Assert the preempt flag to say that this scheduling decision was made made by this interrupt (and not voluntary yielding or ending)
     if (timer_wrap_around == timer_wrap_comparison) {
         timer_wrap_around = 1;
-        preemption_flag = 1;
-        set_pendsv(); // Set pendsv handler bit after the correct number of invocations
+        if (scheduler_tick()) {
+            preemption_flag = 1;
+            set_pendsv(); // Set pendsv handler bit only when the tick changed who should be running
+        }
     } else {
         timer_wrap_around++;
     }
+    isr_cycles_charge(isr_start);
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "timer.h"
 #include "stepper.h"
 #include "ultrasonic.h"
+#include "multitask.h"
 
 /// Specifies the number of interrupts that should be handled by the TIMER0 handler after a start task is issued
 volatile uint32_t timer0_num_interrupts_after_start = 0;
@@ -75,13 +76,16 @@ void timer0_stop() {
 }
 
 /**
- * Custom handler for the TIMER0 peripheral that moves the stepper motor at the desired frequency.
- * At each interrupt, the next control sequence of the stepper motor will be called.
+ * Handles the COMPARE[0] event of TIMER0 by moving the stepper motor to its next step.
  * The timer itself is deactivated after the number of steps specified by the call to stepper_move is satisfied.
  * Expected to manually clear the timer so that the timer will not count until wrap-around (i.e. once the single comparison value for the sampling frequency is reached then the timer is reset).
- * Assumes that the only interrupts being generated from TIMER0 originate from the CC0 register being found as equal to the timer.
+ * Does nothing if the event is not set, so it can be polled by stepper_move for a caller that cannot block and TIMER0_Handler can still be entered afterwards for the event it already handled.
  */
-void TIMER0_Handler() {
+void timer0_compare_event() {
+    if (!*(volatile uint32_t *)TIMER_EVENTS_COMPARE_ADDR(TIMER0_BASE_ADDR, CC0)) {
+        return;
+    }
+
     // Clear compare register event and clear timer
     *(volatile uint32_t *)TIMER_TASKS_CLEAR_ADDR(TIMER0_BASE_ADDR) = TRIGGER;
     *(volatile uint32_t *)TIMER_EVENTS_COMPARE_ADDR(TIMER0_BASE_ADDR, CC0) = NotGenerated;
@@ -94,8 +98,23 @@ void TIMER0_Handler() {
     }
 
     // Advance stepper motor control sequence
+    // Wake the thread waiting in stepper_move once the last step is applied
     stepper_advance_step();
     timer0_num_interrupts_already_handled++;
+    if (timer0_num_interrupts_already_handled == timer0_num_interrupts_after_start) {
+        notify_signal(&stepper_move_done);
+    }
+}
+
+/**
+ * Custom handler for the TIMER0 peripheral that moves the stepper motor at the desired frequency.
+ * At each interrupt, the next control sequence of the stepper motor will be called.
+ * Assumes that the only interrupts being generated from TIMER0 originate from the CC0 register being found as equal to the timer.
+ */
+void TIMER0_Handler() {
+    uint32_t isr_start = isr_enter();
+    timer0_compare_event();
+    isr_cycles_charge(isr_start);
 }
 
 /**
@@ -148,15 +167,88 @@ void timer1_stop() {
 }
 
 /**
- * Custom handler for the TIMER1 peripheral that simply sets the ultrasonic measurement to the maximum possible value
- * If the timeout value is reached, the timer is stopped.
- * Assumes that the timeout value is always in CC0 (so this should not be overwritten when capturing a valid timer value).
+ * Handles the COMPARE[0] event of TIMER1 (the timeout of an ultrasonic measurement) by setting the measurement to ULTRASONIC_RANGE_NONE and signalling ultrasonic_done.
+ * Does nothing if the event is not set, so it can be polled by ultrasonic_range for a caller that cannot block and TIMER1_Handler can still be entered afterwards for the event it already handled.
  */
-void TIMER1_Handler() {
+void timer1_compare_event() {
+    if (!*(volatile uint32_t *)TIMER_EVENTS_COMPARE_ADDR(TIMER1_BASE_ADDR, CC0)) {
+        return;
+    }
+
     // Clear compare register event and clear timer
-    // This interrupt should only fire if the timeout value was reached so just assume this is the case
     *(volatile uint32_t *)TIMER_TASKS_CLEAR_ADDR(TIMER1_BASE_ADDR) = TRIGGER;
     *(volatile uint32_t *)TIMER_EVENTS_COMPARE_ADDR(TIMER1_BASE_ADDR, CC0) = NotGenerated;
     timer1_stop();
-    last_ultrasonic_measurement = 0xFFFFFFFF;
+    last_ultrasonic_measurement = ULTRASONIC_RANGE_NONE;
+    notify_signal(&ultrasonic_done);
+}
+
+/**
+ * Custom handler for the TIMER1 peripheral that simply sets the ultrasonic measurement to the maximum possible value (waking the thread waiting in ultrasonic_range)
+ * If the timeout value is reached, the timer is stopped.
+ * Assumes that the timeout value is always in CC0 (so this should not be overwritten when capturing a valid timer value).
+ */
+void TIMER1_Handler() {
+    uint32_t isr_start = isr_enter();
+    timer1_compare_event();
+    isr_cycles_charge(isr_start);
+}
+
+/**
+ * Configures the TIMER2 peripheral to count at 16 MHz (no prescaling) over the full 32 bit range so that a single wrap takes over 4 minutes.
+ * The timer is never cleared while running since the scheduler measures elapsed time as the (wrap-safe) difference between two captured counts.
+ * Interrupts for the COMPARE[0] event are enabled, and the NVIC is configured to listen for interrupts originating from TIMER2.
+ */
+void timer2_init() {
+    *(volatile uint32_t *)TIMER_TASKS_STOP_ADDR(TIMER2_BASE_ADDR) = TRIGGER;
+    *(volatile uint32_t *)TIMER_PRESCALER_ADDR(TIMER2_BASE_ADDR) = 0;
+    *(volatile uint32_t *)TIMER_BITMODE_ADDR(TIMER2_BASE_ADDR) = Bit32;
+
+    // Configure TIMER2 to produce interrupts when the value in CC[0] is reached by the timer
+    timer_cc cc_reg = CC0;
+    volatile uint32_t* timer_intenset_register = (volatile uint32_t *)TIMER_INTENSET_ADDR(TIMER2_BASE_ADDR);
+    *timer_intenset_register |= (1 << (TIMER_INTENSET_INDEX_OFFSET + cc_reg)); // Enable the COMPARE[0] event to generate interrupts
+    volatile uint32_t* nvic_iser0_register = (volatile uint32_t *)NVIC_ISER0_ADDR;
+    *nvic_iser0_register |= (1 << TIMER2_IRQ);
+
+    // Start counting from 0 (with no stale compare event)
+    *(volatile uint32_t *)TIMER_EVENTS_COMPARE_ADDR(TIMER2_BASE_ADDR, cc_reg) = NotGenerated;
+    *(volatile uint32_t *)TIMER_TASKS_CLEAR_ADDR(TIMER2_BASE_ADDR) = TRIGGER;
+    *(volatile uint32_t *)TIMER_TASKS_START_ADDR(TIMER2_BASE_ADDR) = TRIGGER;
+}
+
+/**
+ * Triggers the capture task for CC[1] and returns the captured value (the counter itself cannot be read directly).
+ */
+uint32_t timer2_now() {
+    *(volatile uint32_t *)TIMER_TASKS_CAPTURE_ADDR(TIMER2_BASE_ADDR, CC1) = TRIGGER;
+    return *(volatile uint32_t *)TIMER_CC_ADDR(TIMER2_BASE_ADDR, CC1);
+}
+
+/**
+ * Replaces the pending compare value in CC[0] with `count`.
+ * The compare event is cleared first so that an event from the previous compare value cannot fire for the new one.
+ */
+void timer2_compare(uint32_t count) {
+    *(volatile uint32_t *)TIMER_EVENTS_COMPARE_ADDR(TIMER2_BASE_ADDR, CC0) = NotGenerated;
+    *(volatile uint32_t *)TIMER_CC_ADDR(TIMER2_BASE_ADDR, CC0) = count;
+}
+
+/**
+ * Trigger timer2 to stop incrementing its own internal counter.
+ */
+void timer2_stop() {
+    volatile uint32_t* timer_tasks_stop_register = (volatile uint32_t *)TIMER_TASKS_STOP_ADDR(TIMER2_BASE_ADDR);
+    *timer_tasks_stop_register = TRIGGER;
+}
+
+/**
+ * Custom handler for the TIMER2 peripheral that takes the place of the SysTick handler when the scheduler runs tickless.
+ * Only fires at the next release or budget exhaustion programmed by the scheduler (which is then responsible for programming the following one).
+ */
+void TIMER2_Handler() {
+    uint32_t isr_start = isr_enter();
+    *(volatile uint32_t *)TIMER_EVENTS_COMPARE_ADDR(TIMER2_BASE_ADDR, CC0) = NotGenerated;
+    tickless_event();
+    isr_cycles_charge(isr_start);
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+/** @file   trace.c
+ *  @brief  Recorder writing scheduler trace records into the trace RTT up buffer.
+**/
+
+#include "trace.h"
+#include "rtt.h"
+
+/// Number of records dropped since the last record that fit (reported with a TRACE_OVERFLOW record once there is room again)
+uint32_t trace_dropped = 0;
+
+/**
+ * Records are written straight into the RTT up buffer, which is already a lock-free single producer ring with the debugger as the consumer (no copy or drain step on the target).
+ * Every caller runs in a handler at the same priority so records are never interleaved with each other.
+ */
+void trace_record(trace_event event, uint8_t thread, uint16_t arg) {
+    trace_record_t record = { cycle_count(), event, thread, arg };
+
+    if (trace_dropped > 0) {
+        trace_record_t overflow = { record.timestamp, TRACE_OVERFLOW, thread, MIN(trace_dropped, 0xFFFF) };
+        if (rtt_trace_write(&overflow, sizeof(overflow)) == 0) {
+            trace_dropped++;
+            return;
+        }
+        trace_dropped = 0;
+    }
+
+    if (rtt_trace_write(&record, sizeof(record)) == 0) {
+        trace_dropped++;
+    }
+}
@@ -13,6 +13,22 @@ volatile uint32_t last_ultrasonic_measurement = 0;
 /// Flag for saying if an event has already been serviced dealing with the start of the signal (rising edge - if so the next interrupt should take a different action)
 volatile uint8_t in_measurement = 0;
 
+/// Signalled by the GPIOTE handler (echo received) or the TIMER1 handler (timeout) once last_ultrasonic_measurement holds the result
+notify_t ultrasonic_done;
+
+/// Set while a measurement started by ultrasonic_range is in flight (so the restarted syscall of a thread that blocked on it does not trigger a second one)
+uint8_t ultrasonic_measurement_started = 0;
+
+/**
+ * Handles the echo edge or the timeout of a measurement if either event is set (the poll function of ultrasonic_done for a caller that cannot block).
+ */
+static void ultrasonic_poll() {
+    gpiote_ultrasonic_event();
+    if (!ultrasonic_done.pending) {
+        timer1_compare_event();
+    }
+}
+
 /**
  * Configure the ultrasonic sensor by setting up GPIO pins.
  * Initialize GPIOTE configuration to allow reading when a measurement is complete.
@@ -53,6 +69,8 @@ void ultrasonic_init() {
     // Reset flags and events
     last_ultrasonic_measurement = 0;
     in_measurement = 0;
+    ultrasonic_measurement_started = 0;
+    notify_init(&ultrasonic_done, ultrasonic_poll);
     volatile uint32_t* gpiote_events_in_register = (volatile uint32_t *)GPIOTE_EVENTS_IN_ADDR(ULTRASONIC_GPIOTE_CHANNEL);
     *gpiote_events_in_register = NotGenerated;
     *(volatile uint32_t *)TIMER_TASKS_CLEAR_ADDR(TIMER1_BASE_ADDR) = TRIGGER;
@@ -62,22 +80,35 @@ void ultrasonic_init() {
 /**
  * Read the current range of the ultrasonic sensor.
  * Trigger a measurement to begin by writing very briefly (10 uS) to the trigger pin.
- * Reset last_ultrasonic_measurement global variable to a holding value and wait for GPIOTE interrupt to calculate and set the calculated range.
+ * Reset last_ultrasonic_measurement global variable to a holding value and wait for the GPIOTE interrupt to calculate and set the calculated range.
  * Timer interrupt may set an infinite range if the timer has already gone past when the echo pulse was expected to return.
+ * A calling user thread is blocked on ultrasonic_done for the up to 36 ms that this takes, and the syscall is restarted once the handler wakes it (the trigger is only sent on the first run).
  * Need to allow about 10 ms between calls to this function (use yield at user level if calling by threads).
  */
 uint32_t ultrasonic_range() {
-    // Reset measurements and flags
-    gpio_clr(ULTRASONIC_TRIGGER_PORT, ULTRASONIC_TRIGGER_PIN);
-    last_ultrasonic_measurement = 0;
-    in_measurement = 0;
+    if (!ultrasonic_measurement_started) {
+        // Reset measurements and flags (and drop a late signal from the previous measurement)
+        gpio_clr(ULTRASONIC_TRIGGER_PORT, ULTRASONIC_TRIGGER_PIN);
+        last_ultrasonic_measurement = 0;
+        in_measurement = 0;
+        notify_init(&ultrasonic_done, ultrasonic_poll);
+        ultrasonic_measurement_started = 1;
 
-    // Flash trigger pulse (10 uS)
-    gpio_set(ULTRASONIC_TRIGGER_PORT, ULTRASONIC_TRIGGER_PIN);
-    COUNTDOWN(640); // At 64MHz system clock, this is 64 ticks for one microsecond (need to wait 10 uS at a minimum assuming each instruction takes one tick - branching may slightly exceed this which may be better for safety)
-    gpio_clr(ULTRASONIC_TRIGGER_PORT, ULTRASONIC_TRIGGER_PIN);
+        // Flash trigger pulse (10 uS)
+        gpio_set(ULTRASONIC_TRIGGER_PORT, ULTRASONIC_TRIGGER_PIN);
+        COUNTDOWN(640); // At 64MHz system clock, this is 64 ticks for one microsecond (need to wait 10 uS at a minimum assuming each instruction takes one tick - branching may slightly exceed this which may be better for safety)
+        gpio_clr(ULTRASONIC_TRIGGER_PORT, ULTRASONIC_TRIGGER_PIN);
+    }
 
-    // Wait until a measurement has been determined (should be nonzero since 0.3m is the minimum reliable range of the sensor)
-    while (last_ultrasonic_measurement == 0) continue;
+    // Wait until a measurement has been determined (the return value is discarded if the thread was blocked instead)
+    // Another thread is refused while the measurement it did not start is still running (reported through a reserved range rather than the error code)
+    int rv = notify_wait(&ultrasonic_done);
+    if (rv < 0) {
+        return ULTRASONIC_RANGE_BUSY;
+    }
+    if (rv == 0) {
+        return 0;
+    }
+    ultrasonic_measurement_started = 0;
     return last_ultrasonic_measurement;
 }
\ No newline at end of file
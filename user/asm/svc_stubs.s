@@ -13,6 +13,78 @@
 _close:
     bx lr
     
+@ SVC with correct syscall number to invoke cond_broadcast syscall
+.thumb_func
+.global cond_broadcast
+.type cond_broadcast, %function
+cond_broadcast:
+    svc #65
+    bx lr
+
+@ SVC with correct syscall number to invoke cond_init syscall
+.thumb_func
+.global cond_init
+.type cond_init, %function
+cond_init:
+    svc #62
+    bx lr
+
+@ SVC with correct syscall number to invoke cond_signal syscall
+.thumb_func
+.global cond_signal
+.type cond_signal, %function
+cond_signal:
+    svc #64
+    bx lr
+
+@ SVC with correct syscall number to invoke cond_wait syscall (wrapped by cond_wait in lock.c)
+.thumb_func
+.global _cond_wait
+.type _cond_wait, %function
+_cond_wait:
+    svc #63
+    bx lr
+
+@ SVC with correct syscall number to invoke cycle_count syscall
+.thumb_func
+.global cycle_count
+.type cycle_count, %function
+cycle_count:
+    svc #46
+    bx lr
+
+@ SVC with correct syscall number to invoke event_clear syscall
+.thumb_func
+.global event_clear
+.type event_clear, %function
+event_clear:
+    svc #61
+    bx lr
+
+@ SVC with correct syscall number to invoke event_group_init syscall
+.thumb_func
+.global event_group_init
+.type event_group_init, %function
+event_group_init:
+    svc #58
+    bx lr
+
+@ SVC with correct syscall number to invoke event_set syscall
+.thumb_func
+.global event_set
+.type event_set, %function
+event_set:
+    svc #60
+    bx lr
+
+@ SVC with correct syscall number to invoke event_wait syscall
+.thumb_func
+.global event_wait
+.type event_wait, %function
+event_wait:
+    svc #59
+    bx lr
+
 @ SVC with correct syscall number to invoke exit syscall
 .thumb_func
 .global _exit
@@ -68,19 +140,19 @@ _isatty:
 _kill:
     bx lr
 
-@ SVC with correct syscall number to invoke lock_init syscall
+@ SVC with correct syscall number to invoke lock_init syscall (wrapped by lock_init in lock.c)
 .thumb_func
-.global lock_init
-.type lock_init, %function
-lock_init:
+.global _lock_init
+.type _lock_init, %function
+_lock_init:
     svc #41
     bx lr
 
-@ SVC with correct syscall number to invoke lock syscall
+@ SVC with correct syscall number to invoke lock syscall (wrapped by lock in lock.c)
 .thumb_func
-.global lock
-.type lock, %function
-lock:
+.global _lock
+.type _lock, %function
+_lock:
     svc #42
     bx lr
 
@@ -141,6 +213,30 @@ _read:
     svc #2
     bx lr
 
+@ SVC with correct syscall number to invoke ring_init syscall
+.thumb_func
+.global ring_init
+.type ring_init, %function
+ring_init:
+    svc #66
+    bx lr
+
+@ SVC with correct syscall number to invoke ring_notify syscall (made by ring_commit and ring_release in ring.c)
+.thumb_func
+.global _ring_notify
+.type _ring_notify, %function
+_ring_notify:
+    svc #68
+    bx lr
+
+@ SVC with correct syscall number to invoke ring_wait syscall
+.thumb_func
+.global ring_wait
+.type ring_wait, %function
+ring_wait:
+    svc #67
+    bx lr
+
 @ SVC with correct syscall number to invoke sbrk syscall
 .thumb_func
 .global _sbrk
@@ -149,6 +245,62 @@ _sbrk:
     svc #0
     bx lr
 
+@ SVC with correct syscall number to invoke sem_init syscall
+.thumb_func
+.global sem_init
+.type sem_init, %function
+sem_init:
+    svc #54
+    bx lr
+
+@ SVC with correct syscall number to invoke sem_post syscall
+.thumb_func
+.global sem_post
+.type sem_post, %function
+sem_post:
+    svc #57
+    bx lr
+
+@ SVC with correct syscall number to invoke sem_try_wait syscall
+.thumb_func
+.global sem_try_wait
+.type sem_try_wait, %function
+sem_try_wait:
+    svc #56
+    bx lr
+
+@ SVC with correct syscall number to invoke sem_wait syscall
+.thumb_func
+.global sem_wait
+.type sem_wait, %function
+sem_wait:
+    svc #55
+    bx lr
+
+@ SVC with correct syscall number to invoke server_define syscall
+.thumb_func
+.global server_define
+.type server_define, %function
+server_define:
+    svc #26
+    bx lr
+
+@ SVC with correct syscall number to invoke server_notify syscall
+.thumb_func
+.global server_notify
+.type server_notify, %function
+server_notify:
+    svc #28
+    bx lr
+
+@ SVC with correct syscall number to invoke server_wait syscall
+.thumb_func
+.global server_wait
+.type server_wait, %function
+server_wait:
+    svc #27
+    bx lr
+
 @ SVC with correct syscall number to invoke sleep_ms syscall
 .thumb_func
 .global sleep_ms
@@ -180,6 +332,30 @@ move_stepper:
     svc #52
     bx lr
 
+@ SVC with correct syscall number to invoke switch_cycles syscall
+.thumb_func
+.global switch_cycles
+.type switch_cycles, %function
+switch_cycles:
+    svc #47
+    bx lr
+
+@ SVC with correct syscall number to invoke thread_deadline_policy syscall
+.thumb_func
+.global thread_deadline_policy
+.type thread_deadline_policy, %function
+thread_deadline_policy:
+    svc #30
+    bx lr
+
+@ SVC with correct syscall number to invoke thread_deadline_stats syscall
+.thumb_func
+.global thread_deadline_stats
+.type thread_deadline_stats, %function
+thread_deadline_stats:
+    svc #29
+    bx lr
+
 @ SVC with correct syscall number to invoke thread define syscall
 .thumb_func
 .global thread_define
@@ -212,6 +388,30 @@ thread_priority:
     svc #39
     bx lr
 
+@ SVC with correct syscall number to invoke thread_cycles syscall
+.thumb_func
+.global thread_cycles
+.type thread_cycles, %function
+thread_cycles:
+    svc #44
+    bx lr
+
+@ SVC with correct syscall number to invoke thread_stack_usage syscall
+.thumb_func
+.global thread_stack_usage
+.type thread_stack_usage, %function
+thread_stack_usage:
+    svc #45
+    bx lr
+
+@ SVC with correct syscall number to invoke thread_response_time syscall
+.thumb_func
+.global thread_response_time
+.type thread_response_time, %function
+thread_response_time:
+    svc #40
+    bx lr
+
 @ SVC with correct syscall number to invoke thread_time syscall
 .thumb_func
 .global thread_time
@@ -243,11 +443,11 @@ ultrasonic_read:
     svc #53
     bx lr
 
-@ SVC with correct syscall number to invoke unlock syscall
+@ SVC with correct syscall number to invoke unlock syscall (wrapped by unlock in lock.c)
 .thumb_func
-.global unlock
-.type unlock, %function
-unlock:
+.global _unlock
+.type _unlock, %function
+_unlock:
     svc #43
     bx lr
 
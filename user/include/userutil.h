@@ -19,13 +19,40 @@
 /** @brief Give some leeway when testing */
 #define SLACK       5
 
+/** @brief largest number of locks (one bit per lock in the shared lock words) */
+#define MAX_LOCKS   32
+
 /**
  * User level abstraction for a corresponding `mutex_t` in kernel space.
  */
 typedef struct {
     uint32_t handle; ///< Address of the inaccessible `mutex_t` in kernel space
+    uint32_t bit; ///< Bit of this lock in lock_shared (locks are numbered in the order that lock_init defines them, like the kernel numbers its mutexes)
 } lock_t;
 
+/**
+ * Lock words shared with the kernel (mirrors `lock_shared_t` in kernel/include/mutex.h).
+ * lock and unlock only enter the kernel when the lock cannot be taken or released with an exclusive store on `held`.
+ */
+typedef struct {
+    volatile uint32_t held; ///< Bit per lock that is locked
+    volatile uint32_t contended; ///< Bit per lock that has threads blocked on it (set and cleared by the kernel)
+} lock_shared_t;
+
+/**
+ * Header of a single producer single consumer ring in the heap (mirrors `ring_shared_t` in kernel/include/ring.h), followed by its slots.
+ * Only the producer writes `head` and only the consumer writes `tail`, so slots are reserved, committed, peeked, and released without a syscall.
+ */
+typedef struct {
+    volatile uint32_t head; ///< Number of slots committed by the producer (free running)
+    volatile uint32_t tail; ///< Number of slots released by the consumer (free running)
+    volatile uint32_t waiting; ///< RING_WAIT_DATA and RING_WAIT_SPACE while a thread is blocked on that side (set and cleared by the kernel)
+    uint32_t slot_size; ///< Bytes per slot (a multiple of 4)
+    uint32_t num_slots; ///< Number of slots (a power of two)
+    uint32_t index; ///< Index of the kernel side of the ring
+    uint8_t slots[]; ///< The slots themselves
+} ring_t;
+
 /** @struct     u32_pair
  *  @brief      struct to hold two unsigned int values
  */
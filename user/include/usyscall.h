@@ -13,6 +13,87 @@ typedef enum {
     THREAD_PROTECT ///< Kernel and threads should be isolated in memory from each other
 } mpu_mode;
 
+/** 
+ * Indicator of how the scheduler should keep track of time (a periodic tick every timeslot or only interrupting at the next release or budget exhaustion).
+ */
+typedef enum {
+    PERIODIC_TICK, ///< The scheduler is interrupted once every timeslot
+    TICKLESS ///< The scheduler is only interrupted when a thread is released or exhausts its budget (the idle thread can sleep through every other timeslot)
+} tick_mode;
+
+/** 
+ * Indicator of the policy that the scheduler uses to choose between ready threads.
+ */
+typedef enum {
+    RATE_MONOTONIC, ///< Threads with shorter periods always run first (a thread is admitted only if response time analysis shows that every thread still meets its deadline)
+    EARLIEST_DEADLINE_FIRST ///< The thread with the closest deadline runs first (threads are admitted up to a total utilization of 1)
+} sched_policy;
+
+/// Kernel semaphore returned by sem_init (opaque at user level)
+typedef struct semaphore semaphore_t;
+
+/// Kernel group of event flags returned by event_group_init (opaque at user level)
+typedef struct event_group event_group_t;
+
+/// Kernel condition variable returned by cond_init (opaque at user level)
+typedef struct cond cond_t;
+
+/// Option of event_wait to wait until every flag in the mask is set (otherwise any one of them is enough)
+#define EVENT_WAIT_ALL (0x1)
+
+/// Option of event_wait to clear the flags that it returns (so each setting of a flag is consumed by one waiter)
+#define EVENT_WAIT_CLEAR (0x2)
+
+/// Option of ring_wait to wait until the ring has a committed slot (the consumer side)
+#define RING_WAIT_DATA (0x1)
+
+/// Option of ring_wait to wait until the ring has a free slot (the producer side)
+#define RING_WAIT_SPACE (0x2)
+
+/// Range returned by ultrasonic_read when no echo came back before the timeout (beyond any range the sensor can measure)
+#define ULTRASONIC_RANGE_NONE (0xFFFFFFFF)
+
+/// Range returned by ultrasonic_read instead of a measurement when another thread is still waiting for the measurement it started
+#define ULTRASONIC_RANGE_BUSY (0xFFFFFFFE)
+
+/**
+ * Processor cycle counters filled in by thread_cycles.
+ */
+typedef struct {
+    unsigned long long thread; ///< Cycles that the requested thread was running (including the syscalls it made)
+    unsigned long long kernel; ///< Cycles spent in the scheduler and in interrupt handlers since multitask_start
+    unsigned long long idle; ///< Cycles that the idle thread was running since multitask_start
+} cycle_counters_t;
+
+/** 
+ * What the scheduler does with a thread whose previous job is still unfinished when its next job is released (set with thread_deadline_policy).
+ */
+typedef enum {
+    DEADLINE_MISS_CONTINUE, ///< Only count the miss (default - the late job keeps running with the budget of the new job)
+    DEADLINE_MISS_SKIP, ///< Skip the new job so that the late job can catch up without taking more processor time (a job still late at the release after that gets the budget of that period)
+    DEADLINE_MISS_DEMOTE, ///< Run the thread below every other thread until the late job completes
+    DEADLINE_MISS_END ///< End the thread the next time it runs
+} deadline_policy;
+
+/**
+ * Deadline counters filled in by thread_deadline_stats.
+ */
+typedef struct {
+    unsigned int deadline_misses; ///< Releases at which the previous job of the thread had not completed yet (a job completes when the thread yields)
+    unsigned int overruns; ///< Times the thread used up its budget without completing its job
+    unsigned int max_lateness; ///< Largest number of scheduler periods that a job completed after its deadline
+} deadline_stats_t;
+
+/**
+ * Stack high-water marks (in bytes) filled in by thread_stack_usage.
+ */
+typedef struct {
+    unsigned int process_used; ///< Deepest use of the process stack of the requested thread since it was defined
+    unsigned int process_size; ///< Size of the process stack of the requested thread
+    unsigned int kernel_used; ///< Deepest use of the kernel stack (shared by every thread) since multitask_request
+    unsigned int kernel_size; ///< Size of the kernel stack
+} stack_usage_t;
+
 /// User level stub for sleep_ms syscall (this function is implemented in assembly and invoking this function will automatically place needed arguements in correct registers for SVC_C_Handler)
 void sleep_ms(unsigned int ms);
 
@@ -26,17 +107,29 @@ void neopixel_set(unsigned char red, unsigned char green, unsigned char blue, un
 void neopixel_load();
 
 /**
- * User level stub for requesting the paritioning of kernel and user stack space for multiple threads (`num_threads` pieces each with both process and main stack size of `stack_bytes`) with an optional `idle_function` task to perform when no other thread is scheduled.
+ * User level stub for requesting user stack space for multiple threads (up to `num_threads` threads with a default stack size of `stack_bytes` - every thread shares the kernel stack) with an optional `idle_function` task to perform when no other thread is scheduled.
  * Also specifies an indicator to determine if the threads should be isolated from each other in memory (or just from the kernel).
- * Additionally specifies the number of unique locks that the user-level application will user
+ * Additionally specifies the number of unique locks that the user-level application will user and the scheduling `policy` for the threads
  */
-int multitask_request(unsigned int num_threads, unsigned int stack_bytes, void* idle_function, mpu_mode mpu_protect, unsigned int num_locks);
+int multitask_request(unsigned int num_threads, unsigned int stack_bytes, void* idle_function, mpu_mode mpu_protect, unsigned int num_locks, sched_policy policy);
 
-/// User level stub for spawning a thread that asynchronously executes the given `fn` with an optional `arg` and a given `id` (id must be unique for thread to spawn). Also configures the task with worst case execution time `c` and period `t`
-int thread_define(unsigned int id, void *fn, void *arg, unsigned int c, unsigned int t);
+/// User level stub for spawning a thread that asynchronously executes the given `fn` with an optional `arg` and a given `id` (id must be unique for thread to spawn). Also configures the task with worst case execution time `c` and period `t` and its own stack size `stack_bytes` (zero for the size given to multitask_request)
+int thread_define(unsigned int id, void *fn, void *arg, unsigned int c, unsigned int t, unsigned int stack_bytes);
 
-/// User level stub for specifying the frequency of the scheduling call (with a call with zero being interpretted as a non-preemptive scheduler - i.e. the scheduler will not run unless a task explicitly yields)
-int multitask_start(unsigned int freq);
+/// Event bit that the kernel signals to a server waiting on it whenever input is waiting on stdin (all other bits are free for server_notify)
+#define SERVER_EVENT_STDIN (0x80000000)
+
+/// User level stub for spawning an aperiodic (deferrable) server with the same arguements as thread_define. The server only spends its budget `c` (replenished every period `t`) while it has work, so it should call server_wait whenever it runs out of work instead of polling (only supported under RATE_MONOTONIC)
+int server_define(unsigned int id, void *fn, void *arg, unsigned int c, unsigned int t, unsigned int stack_bytes);
+
+/// User level stub for a server to sleep until any of the event bits in `mask` is signalled (returns the signalled bits of the mask and clears them - returns 0 immediately if the caller is not a server)
+unsigned int server_wait(unsigned int mask);
+
+/// User level stub for signalling the event bits `events` to the server with the given `id` (negative if no such server exists)
+int server_notify(unsigned int id, unsigned int events);
+
+/// User level stub for specifying the frequency of the scheduling call (with a call with zero being interpretted as a non-preemptive scheduler - i.e. the scheduler will not run unless a task explicitly yields) and whether the scheduler should run tickless (`mode`)
+int multitask_start(unsigned int freq, tick_mode mode);
 
 /// User level stub for returning the thread id of the currently running thread
 unsigned long thread_id();
@@ -56,22 +149,98 @@ unsigned long thread_time();
 /// User level stub for returning the priority of the the current thread 
 unsigned long thread_priority();
 
-/// User level stub for initializing a lock (kernel must already have defined empty structs for mutexes by the time this function is called from user space) which also has a space for specifiying the `prio` or the task ID with the associated priority ceiling
-lock_t *lock_init(unsigned int prio);
+/// User level stub for filling `counters` with the processor cycles consumed by the thread with the given `id`, the kernel, and the idle thread (negative if no such thread exists)
+int thread_cycles(unsigned int id, cycle_counters_t* counters);
+
+/// User level stub for filling `usage` with the stack high-water marks of the thread with the given `id` (0xFFFFFFFF for the idle thread) and of the shared kernel stack (negative if no such thread exists)
+int thread_stack_usage(unsigned int id, stack_usage_t* usage);
+
+/// User level stub for reading the processor cycle counter (wraps at 32 bits so only differences between two readings are meaningful)
+unsigned int cycle_count();
+
+/// User level stub for returning the processor cycles that the kernel spent on the last context switch between two different threads
+unsigned int switch_cycles();
+
+/// User level stub for filling `stats` with the deadline misses, overruns, and maximum lateness of the thread with the given `id` (negative if no such thread exists)
+int thread_deadline_stats(unsigned int id, deadline_stats_t* stats);
 
-/// User level stub for locking a lock with the opaque address `m` 
+/// User level stub for choosing what the scheduler does when the thread with the given `id` misses a deadline (negative if no such thread exists or the policy is unknown)
+int thread_deadline_policy(unsigned int id, deadline_policy policy);
+
+/// User level stub for returning the worst case response time (in scheduler periods) of the thread with the given `id` as computed by admission control (negative if no such thread exists)
+int thread_response_time(unsigned int id);
+
+/// User level wrapper for initializing a lock (kernel must already have defined empty structs for mutexes by the time this function is called from user space) which also has a space for specifiying the `prio` or the task ID with the associated priority ceiling
+/// and the `critical_section` or the longest time in timeslots that any thread holds it (bounds the blocking time in RMS admission - 0 if unknown, which charges the whole budget of the lower priority thread)
+lock_t *lock_init(unsigned int prio, unsigned int critical_section);
+
+/// User level wrapper for locking the lock `m` (takes a free lock without a syscall while no other lock is held and otherwise makes the lock syscall, which applies the priority ceiling protocol)
 void lock(lock_t *m);
 
-/// User level stub for unlocking a lock with the opaque address `m` 
+/// User level wrapper for unlocking the lock `m` (releases it without a syscall unless threads are blocked on it)
 void unlock(lock_t *m);
 
+/// User level stub for defining a counting semaphore with `count` units available (only from main before multitask_start - NULL if none are left)
+semaphore_t *sem_init(unsigned int count);
+
+/// User level stub for taking a unit of the semaphore `s` (blocks without using any budget until sem_post hands one over - negative if `s` is invalid or the caller holds a lock)
+int sem_wait(semaphore_t *s);
+
+/// User level stub for taking a unit of the semaphore `s` only if one is available (1 if none was available and negative if `s` is invalid)
+int sem_try_wait(semaphore_t *s);
+
+/// User level stub for handing a unit of the semaphore `s` to its highest priority waiter (or adding it to the count if nobody waits)
+int sem_post(semaphore_t *s);
+
+/// User level stub for defining a group of 32 event flags that start out clear (only from main before multitask_start - NULL if none are left)
+event_group_t *event_group_init();
+
+/// User level stub for waiting until any flag of `mask` is set in `g` (every flag with EVENT_WAIT_ALL in `options`) - returns the flags it waited for (cleared from the group with EVENT_WAIT_CLEAR) or 0 if the wait was refused
+unsigned int event_wait(event_group_t *g, unsigned int mask, unsigned int options);
+
+/// User level stub for setting `flags` in `g` and waking every waiter that is satisfied
+int event_set(event_group_t *g, unsigned int flags);
+
+/// User level stub for clearing `flags` in `g` (returns the flags that were set before)
+unsigned int event_clear(event_group_t *g, unsigned int flags);
+
+/// User level stub for defining a condition variable (only from main before multitask_start - NULL if none are left)
+cond_t *cond_init();
+
+/// User level wrapper for releasing the lock `m` and waiting on `c` in one step (`m` must be the only lock held) - returns once signalled and holding `m` again (negative if the wait was refused)
+int cond_wait(cond_t *c, lock_t *m);
+
+/// User level stub for waking the highest priority waiter of `c` (it runs once it holds its lock again)
+int cond_signal(cond_t *c);
+
+/// User level stub for waking every waiter of `c` (each one runs once it holds its lock again)
+int cond_broadcast(cond_t *c);
+
+/// User level stub for defining a single producer single consumer ring of `num_slots` (a power of two) slots of `slot_size` bytes in the heap (only from main before multitask_start - NULL if the geometry is invalid or no rings or heap are left)
+ring_t *ring_init(unsigned int slot_size, unsigned int num_slots);
+
+/// User level wrapper for getting the next free slot of `r` to fill in place (NULL if the ring is full - only the producer may call it)
+void *ring_reserve(ring_t *r);
+
+/// User level wrapper for handing the slot returned by ring_reserve to the consumer (enters the kernel only if the consumer is blocked on the ring)
+void ring_commit(ring_t *r);
+
+/// User level wrapper for getting the oldest committed slot of `r` to read in place (NULL if the ring is empty - only the consumer may call it)
+const void *ring_peek(ring_t *r);
+
+/// User level wrapper for giving the slot returned by ring_peek back to the producer (enters the kernel only if the producer is blocked on the ring)
+void ring_release(ring_t *r);
+
+/// User level stub for blocking until `r` has a committed slot (RING_WAIT_DATA) or a free slot (RING_WAIT_SPACE) - negative if `r` is invalid or the caller holds a lock
+int ring_wait(ring_t *r, unsigned int what);
+
 /// User level stub for setting the speed of an attached stepper motor
 int set_stepper_speed(unsigned int speed_rpm);
 
-/// User level stub for moving the stepper motor through a specified number of steps (blocking) with direction based on sign of num_steps (positive is CW and negative is CCW)
+/// User level stub for moving the stepper motor through a specified number of steps (blocking) with direction based on sign of num_steps (positive is CW and negative is CCW) - negative if another thread's move is still running
 int move_stepper(int num_steps);
 
-/// Take a measurement from the ultrasonic sensor and report back range in cm (blocking)
+/// Take a measurement from the ultrasonic sensor and report back range in cm (blocking) - ULTRASONIC_RANGE_NONE if no echo came back and ULTRASONIC_RANGE_BUSY if another thread's measurement is still running
 unsigned int ultrasonic_read();
 
 #endif
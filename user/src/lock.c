@@ -0,0 +1,92 @@
+/** @file   lock.c
+ *  @brief  User-space fast path of the priority ceiling locks (the kernel is only entered when a lock has to be arbitrated).
+ *
+ *  Under the priority ceiling protocol a free lock can always be taken while no other lock is held (the global ceiling is then below every thread), so that case is a single exclusive store on lock_shared.held.
+ *  Everything else (another lock is held, the lock is taken, or threads are blocked on it) makes the syscall, and the kernel accounts the bits set and cleared here at its next entry.
+**/
+
+#include <stddef.h>
+#include "userutil.h"
+#include "usyscall.h"
+
+/// Syscall stubs in svc_stubs.s behind lock_init, lock, and unlock
+extern uint32_t _lock_init(unsigned int prio, unsigned int critical_section);
+extern void _lock(uint32_t handle);
+extern void _unlock(uint32_t handle);
+extern int _cond_wait(cond_t *c, uint32_t handle);
+
+/// Lock words shared with the kernel (the kernel refers to them by this name, so they live in user memory that every thread can write)
+lock_shared_t lock_shared;
+
+/// User side of every lock defined so far (in the order the kernel defined them)
+static lock_t locks[MAX_LOCKS];
+
+/// Number of locks defined so far
+static uint32_t num_locks = 0;
+
+/** @brief   exclusive load of `addr` */
+static inline uint32_t load_exclusive(volatile uint32_t *addr) {
+    uint32_t value;
+    asm volatile("ldrex %0, [%1]" : "=r" (value) : "r" (addr) : "memory");
+    return value;
+}
+
+/** @brief   exclusive store of `value` to `addr` (returns 1 if the store did not happen) */
+static inline uint32_t store_exclusive(volatile uint32_t *addr, uint32_t value) {
+    uint32_t status;
+    asm volatile("strex %0, %1, [%2]" : "=&r" (status) : "r" (value), "r" (addr) : "memory");
+    return status;
+}
+
+/** @brief   orders the critical section against the store that takes or releases the lock */
+static inline void data_mem_barrier() {
+    asm volatile("dmb" ::: "memory");
+}
+
+/** @brief   defines the kernel mutex and numbers the lock like the kernel does */
+lock_t *lock_init(unsigned int prio, unsigned int critical_section) {
+    if (num_locks >= MAX_LOCKS) {
+        return NULL;
+    }
+    uint32_t handle = _lock_init(prio, critical_section);
+    if (handle == 0) {
+        return NULL;
+    }
+    locks[num_locks].handle = handle;
+    locks[num_locks].bit = 1u << num_locks;
+    return &locks[num_locks++];
+}
+
+/** @brief   takes `m` with an exclusive store if no lock is held (a failed store was interrupted and retries) and makes the lock syscall otherwise */
+void lock(lock_t *m) {
+    while (1) {
+        if (load_exclusive(&lock_shared.held) != 0) {
+            _lock(m->handle);
+            return;
+        }
+        if (store_exclusive(&lock_shared.held, m->bit) == 0) {
+            data_mem_barrier();
+            return;
+        }
+    }
+}
+
+/** @brief   releases `m` with an exclusive store unless threads are blocked on it or held back by its ceiling (or it is not held) and makes the unlock syscall otherwise */
+void unlock(lock_t *m) {
+    data_mem_barrier();
+    while (1) {
+        uint32_t held = load_exclusive(&lock_shared.held);
+        if (!(held & m->bit) || (lock_shared.contended & m->bit)) {
+            _unlock(m->handle);
+            return;
+        }
+        if (store_exclusive(&lock_shared.held, held & ~m->bit) == 0) {
+            return;
+        }
+    }
+}
+
+/** @brief   releases `m` and waits on `c` through the kernel (the kernel hands `m` back before the thread runs again, so the lock words already show it as held) */
+int cond_wait(cond_t *c, lock_t *m) {
+    return _cond_wait(c, m->handle);
+}
@@ -0,0 +1,66 @@
+/** @file   ring.c
+ *  @brief  User-space side of the single producer single consumer rings (slots are filled and drained in place and the kernel is only entered to block or wake a blocked side).
+ *
+ *  The producer writes a slot and then publishes it by advancing `head`, and the consumer reads a slot and then gives it back by advancing `tail`.
+ *  Each index has a single writer, so a plain store (ordered by a barrier against the slot contents) is enough and no exclusive access is needed.
+ *  After publishing, a side checks the waiting bit of the other side: the kernel checks the indices and sets the bit in a single syscall, so either the waiter sees the new index or the publisher sees the bit.
+**/
+
+#include <stddef.h>
+#include "userutil.h"
+#include "usyscall.h"
+
+/// Syscall stub in svc_stubs.s behind ring_commit and ring_release
+extern int _ring_notify(ring_t *r);
+
+/** @brief   orders the accesses to a slot against the store of the index that hands it over */
+static inline void data_mem_barrier() {
+    asm volatile("dmb" ::: "memory");
+}
+
+/** @brief   returns the slot at the free running position `position` of `r` */
+static inline uint8_t *ring_slot(ring_t *r, uint32_t position) {
+    return &r->slots[(position & (r->num_slots - 1)) * r->slot_size];
+}
+
+/** @brief   returns the slot after the last committed one unless every slot is still waiting for the consumer */
+void *ring_reserve(ring_t *r) {
+    uint32_t head = r->head;
+    if (head - r->tail >= r->num_slots) {
+        return NULL;
+    }
+    // The tail was read before the slot is written (the consumer is done with it)
+    data_mem_barrier();
+    return ring_slot(r, head);
+}
+
+/** @brief   publishes the reserved slot and wakes the consumer through the kernel if it is blocked */
+void ring_commit(ring_t *r) {
+    data_mem_barrier();
+    r->head = r->head + 1;
+    data_mem_barrier();
+    if (r->waiting & RING_WAIT_DATA) {
+        _ring_notify(r);
+    }
+}
+
+/** @brief   returns the oldest committed slot unless the producer has not committed any */
+const void *ring_peek(ring_t *r) {
+    uint32_t tail = r->tail;
+    if (r->head == tail) {
+        return NULL;
+    }
+    // The head was read before the slot is read (the producer is done with it)
+    data_mem_barrier();
+    return ring_slot(r, tail);
+}
+
+/** @brief   gives the peeked slot back and wakes the producer through the kernel if it is blocked */
+void ring_release(ring_t *r) {
+    data_mem_barrier();
+    r->tail = r->tail + 1;
+    data_mem_barrier();
+    if (r->waiting & RING_WAIT_SPACE) {
+        _ring_notify(r);
+    }
+}
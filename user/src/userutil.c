@@ -8,7 +8,7 @@
 
 /** @brief    Default idle function used when no idle_function arguement is provided to multitask_request syscall*/
 void default_idle() {
-    // Spin while waiting for an interrupt (likely from the scheduler)
+    // Sleep while waiting for an interrupt (likely from the scheduler - which in tickless mode only arrives at the next release)
     while (1) {
         asm volatile("wfi"); 
     }
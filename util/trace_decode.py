@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+"""Decodes a capture of the kernel trace RTT channel into Chrome trace JSON.
+
+The kernel streams 8 byte records (see kernel/include/trace.h) into RTT up
+buffer 1 ("Trace"). Capture that channel to a file with any RTT capable probe
+tool (for example `rtt server start <port> 1` in OpenOCD and redirecting the
+socket to a file) and convert it with:
+
+    util/trace_decode.py capture.bin -o trace.json [--cpu-hz 64000000]
+
+The output loads in chrome://tracing or ui.perfetto.dev. Every thread gets a
+track showing when it ran, with its syscalls nested inside. Releases, lock
+blocks, unlocks, wake ups, deadline misses and overruns are instant markers on
+the thread track, and interrupt handlers are shown on a separate interrupts
+process.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+RECORD = struct.Struct("<IBBH")
+
+TRACE_SWITCH_OUT = 1
+TRACE_SWITCH_IN = 2
+TRACE_RELEASE = 3
+TRACE_LOCK_BLOCK = 4
+TRACE_UNLOCK = 5
+TRACE_SVC_ENTER = 6
+TRACE_SVC_EXIT = 7
+TRACE_IRQ_ENTER = 8
+TRACE_IRQ_EXIT = 9
+TRACE_THREAD_DEFINE = 10
+TRACE_OVERFLOW = 11
+TRACE_SERVER_WAKE = 12
+TRACE_NOTIFY_WAKE = 13
+TRACE_DEADLINE_MISS = 14
+TRACE_OVERRUN = 15
+TRACE_SYNC_BLOCK = 16
+TRACE_SYNC_WAKE = 17
+
+TRACE_ID_IDLE = 0xFFFF
+TRACE_ID_MAIN = 0xFFFE
+
+THREAD_STATES = ["running", "ready", "waiting", "blocked", "defunct"]
+
+# Names of the syscalls in kernel/include/svc_num.h (others are shown by number)
+SVC_NAMES = {
+    0: "sbrk", 1: "write", 2: "read", 3: "exit", 22: "sleep_ms", 23: "lux_read",
+    24: "neopixel_set", 25: "neopixel_load", 26: "server_define",
+    27: "server_wait", 28: "server_notify", 29: "thread_deadline_stats",
+    30: "thread_deadline_policy", 31: "multitask_request",
+    32: "thread_define", 33: "multitask_start", 34: "thread_id",
+    35: "thread_yield", 36: "thread_end", 37: "get_time", 38: "thread_time",
+    39: "thread_priority", 40: "thread_response_time", 41: "lock_init",
+    42: "lock", 43: "unlock", 44: "thread_cycles", 45: "thread_stack_usage",
+    46: "cycle_count", 47: "switch_cycles",
+    51: "stepper_set_speed", 52: "stepper_move", 53: "ultrasonic_read",
+    54: "sem_init", 55: "sem_wait", 56: "sem_try_wait", 57: "sem_post",
+    58: "event_group_init", 59: "event_wait", 60: "event_set", 61: "event_clear",
+    62: "cond_init", 63: "cond_wait", 64: "cond_signal", 65: "cond_broadcast",
+    66: "ring_init", 67: "ring_wait", 68: "ring_notify",
+}
+
+# Names of the exceptions that have handlers in the kernel (others are shown by number)
+IRQ_NAMES = {15: "SysTick", 16 + 6: "GPIOTE", 16 + 8: "TIMER0", 16 + 9: "TIMER1", 16 + 10: "TIMER2"}
+
+THREADS_PID = 1
+IRQ_PID = 2
+
+
+def read_records(data):
+    """Yields (cycles, event, thread, arg) with the 32 bit timestamps unwrapped into a monotonic count."""
+    wraps = 0
+    last = None
+    for offset in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        timestamp, event, thread, arg = RECORD.unpack_from(data, offset)
+        if last is not None and timestamp < last:
+            wraps += 1
+        last = timestamp
+        yield (wraps << 32) + timestamp, event, thread, arg
+
+
+def thread_name(index, defined):
+    ident = defined.get(index)
+    if ident == TRACE_ID_IDLE:
+        return "idle"
+    if ident == TRACE_ID_MAIN:
+        return "main"
+    if ident is None:
+        return "thread[%d]" % index
+    return "thread %d" % ident
+
+
+def decode(data, cpu_hz):
+    """Returns the list of Chrome trace events for a raw capture."""
+    to_us = 1e6 / cpu_hz
+    events = []
+    defined = {}
+    running = {}  # thread index -> cycle it was switched in
+    svc_open = {}  # thread index -> (cycle, svc number)
+    irq_open = {}  # exception number -> cycle
+    first = None
+    last = 0
+
+    def complete(pid, tid, name, start, end, args=None):
+        event = {"ph": "X", "pid": pid, "tid": tid, "name": name,
+                 "ts": (start - first) * to_us, "dur": (end - start) * to_us}
+        if args:
+            event["args"] = args
+        events.append(event)
+
+    def instant(tid, name, cycles, args=None, scope="t"):
+        event = {"ph": "i", "pid": THREADS_PID, "tid": tid, "name": name, "s": scope,
+                 "ts": (cycles - first) * to_us}
+        if args:
+            event["args"] = args
+        events.append(event)
+
+    for cycles, event, thread, arg in read_records(data):
+        if first is None:
+            first = cycles
+        last = cycles
+
+        if event == TRACE_THREAD_DEFINE:
+            defined[thread] = arg
+        elif event == TRACE_SWITCH_IN:
+            running[thread] = cycles
+        elif event == TRACE_SWITCH_OUT:
+            start = running.pop(thread, first)
+            state = THREAD_STATES[arg] if arg < len(THREAD_STATES) else str(arg)
+            complete(THREADS_PID, thread, "running", start, cycles, {"left as": state})
+        elif event == TRACE_RELEASE:
+            instant(thread, "release", cycles, {"timeslot (low 16 bits)": arg})
+        elif event == TRACE_LOCK_BLOCK:
+            instant(thread, "block on lock %d" % arg, cycles)
+        elif event == TRACE_UNLOCK:
+            instant(thread, "unlock lock %d" % arg, cycles)
+        elif event == TRACE_SVC_ENTER:
+            svc_open[thread] = (cycles, arg)
+        elif event == TRACE_SVC_EXIT:
+            start, number = svc_open.pop(thread, (cycles, arg))
+            complete(THREADS_PID, thread, "svc " + SVC_NAMES.get(number, str(number)), start, cycles)
+        elif event == TRACE_IRQ_ENTER:
+            irq_open[arg] = cycles
+        elif event == TRACE_IRQ_EXIT:
+            start = irq_open.pop(arg, cycles)
+            complete(IRQ_PID, arg, IRQ_NAMES.get(arg, "exception %d" % arg), start, cycles,
+                     {"interrupted": thread_name(thread, defined)})
+        elif event == TRACE_SERVER_WAKE:
+            instant(thread, "server woken", cycles, {"events (low 16 bits)": arg})
+        elif event == TRACE_NOTIFY_WAKE:
+            instant(thread, "woken by " + IRQ_NAMES.get(arg, "exception %d" % arg), cycles)
+        elif event == TRACE_DEADLINE_MISS:
+            instant(thread, "deadline miss", cycles, {"misses (low 16 bits)": arg})
+        elif event == TRACE_OVERRUN:
+            instant(thread, "budget overrun", cycles, {"overruns (low 16 bits)": arg})
+        elif event == TRACE_SYNC_BLOCK:
+            instant(thread, "block in " + SVC_NAMES.get(arg, "svc %d" % arg), cycles)
+        elif event == TRACE_SYNC_WAKE:
+            instant(thread, "woken by " + thread_name(arg, defined), cycles)
+        elif event == TRACE_OVERFLOW:
+            instant(thread, "dropped %d records" % arg, cycles, scope="g")
+        else:
+            sys.stderr.write("warning: unknown record type %d (capture may be misaligned)\n" % event)
+
+    # Threads still running at the end of the capture
+    for thread, start in running.items():
+        complete(THREADS_PID, thread, "running", start, last)
+
+    events.append({"ph": "M", "pid": THREADS_PID, "name": "process_name", "args": {"name": "threads"}})
+    events.append({"ph": "M", "pid": IRQ_PID, "name": "process_name", "args": {"name": "interrupts"}})
+    for index in set(defined) | {e["tid"] for e in events if e.get("pid") == THREADS_PID and "tid" in e}:
+        events.append({"ph": "M", "pid": THREADS_PID, "tid": index, "name": "thread_name",
+                       "args": {"name": thread_name(index, defined)}})
+    for number in {e["tid"] for e in events if e.get("pid") == IRQ_PID and "tid" in e}:
+        events.append({"ph": "M", "pid": IRQ_PID, "tid": number, "name": "thread_name",
+                       "args": {"name": IRQ_NAMES.get(number, "exception %d" % number)}})
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a kernel trace capture into Chrome trace JSON")
+    parser.add_argument("capture", help="raw bytes captured from RTT up buffer 1")
+    parser.add_argument("-o", "--output", default="-", help="output JSON file (default stdout)")
+    parser.add_argument("--cpu-hz", type=float, default=64e6, help="DWT cycle counter frequency (default 64 MHz)")
+    args = parser.parse_args()
+
+    with open(args.capture, "rb") as capture:
+        data = capture.read()
+    if len(data) % RECORD.size:
+        sys.stderr.write("warning: ignoring %d trailing bytes\n" % (len(data) % RECORD.size))
+
+    trace = {"traceEvents": decode(data, args.cpu_hz), "displayTimeUnit": "ns"}
+    if args.output == "-":
+        json.dump(trace, sys.stdout)
+    else:
+        with open(args.output, "w") as output:
+            json.dump(trace, output)
+
+
+if __name__ == "__main__":
+    main()